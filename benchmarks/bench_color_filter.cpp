@@ -0,0 +1,63 @@
+// bench_color_filter.cpp
+#include "bench_images.h"
+#include "color_filter.h"
+#include "color_reduction.h"
+
+namespace {
+
+const char* ColorFilterName(ColorFilterType type) {
+    switch (type) {
+        case ColorFilterType::None:
+            return "none";
+        case ColorFilterType::Negative:
+            return "negative";
+        case ColorFilterType::Grayscale:
+            return "grayscale";
+        case ColorFilterType::PerlinNoise:
+            return "perlin";
+    }
+    return "";
+}
+
+}  // namespace
+
+// One color filter over the whole image; perlin runs at 50%
+static void BM_ColorFilter(benchmark::State& state) {
+    const size_t index = state.range(0);
+    const auto type = static_cast<ColorFilterType>(state.range(1));
+    const BenchImage& image = BenchImages()[index];
+    const std::vector<uint8_t>& pixels = BenchPixels(index);
+
+    for (auto _ : state) {
+        std::vector<uint8_t> filtered =
+            ColorFilter::Apply(pixels, image.width, image.height, type, 50.0f);
+        benchmark::DoNotOptimize(filtered.data());
+    }
+
+    ReportImage(state, index, ColorFilterName(type));
+}
+BENCHMARK(BM_ColorFilter)
+    ->Apply([](auto* b) {
+        ForEachImage(b, {static_cast<int64_t>(ColorFilterType::Negative),
+                         static_cast<int64_t>(ColorFilterType::Grayscale),
+                         static_cast<int64_t>(ColorFilterType::PerlinNoise)});
+    })
+    ->Unit(benchmark::kMillisecond);
+
+// Color type analysis of the grayscale-filtered image, the worst case that reads every row
+static void BM_ColorReductionAnalyze(benchmark::State& state) {
+    const size_t index = state.range(0);
+    const BenchImage& image = BenchImages()[index];
+    const std::vector<uint8_t>& pixels = BenchPixels(index);
+
+    for (auto _ : state) {
+        PixelFormat format = ColorReducer::Analyze({pixels, image.width, image.height},
+                                                   ColorFilterType::Grayscale);
+        benchmark::DoNotOptimize(format.bit_depth);
+    }
+
+    ReportImage(state, index);
+}
+BENCHMARK(BM_ColorReductionAnalyze)
+    ->Apply([](auto* b) { ForEachImage(b); })
+    ->Unit(benchmark::kMillisecond);
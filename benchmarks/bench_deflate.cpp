@@ -0,0 +1,92 @@
+// bench_deflate.cpp
+#include "bench_images.h"
+#include "deflate.h"
+#include "deflate_backend.h"
+#include "filter.h"
+
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace {
+
+// Deflate is measured on the scanlines the encoder would actually feed it
+const std::vector<uint8_t>& Scanlines(size_t index) {
+    static std::map<size_t, std::vector<uint8_t>> cache;
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = cache.find(index);
+    if (it == cache.end()) {
+        const BenchImage& image = BenchImages()[index];
+        it = cache.emplace(index, PNGFilter::Apply(BenchPixels(index), image.width,
+                                                   image.height, PNGFilterStrategy::MinSum))
+                 .first;
+    }
+
+    return it->second;
+}
+
+}  // namespace
+
+// DeflateCompressor::Compress per zlib level, default strategy
+static void BM_DeflateCompress(benchmark::State& state) {
+    const size_t index = state.range(0);
+    const std::vector<uint8_t>& scanlines = Scanlines(index);
+
+    CompressionProfile profile;
+    profile.level = static_cast<int>(state.range(1));
+
+    size_t compressed_size = 0;
+    for (auto _ : state) {
+        std::vector<uint8_t> compressed = DeflateCompressor::Compress(scanlines, profile);
+        compressed_size = compressed.size();
+        benchmark::DoNotOptimize(compressed.data());
+    }
+
+    state.counters["ratio"] = static_cast<double>(compressed_size) / scanlines.size();
+    ReportImage(state, index, "level " + std::to_string(profile.level));
+}
+BENCHMARK(BM_DeflateCompress)
+    ->Apply([](auto* b) { ForEachImage(b, {1, 3, 6, 9}); })
+    ->Unit(benchmark::kMillisecond);
+
+// ReusableDeflater per backend and level; backends missing from the build are skipped
+static void BM_DeflateBackend(benchmark::State& state) {
+    const size_t index = state.range(0);
+    const std::vector<uint8_t>& scanlines = Scanlines(index);
+
+    CompressionProfile profile;
+    profile.backend = static_cast<DeflateBackendType>(state.range(1));
+    profile.level = static_cast<int>(state.range(2));
+
+    const std::string label = std::string(DeflateBackend::Name(profile.backend)) + " level " +
+                              std::to_string(profile.level);
+    if (!DeflateBackend::IsAvailable(profile.backend)) {
+        state.SkipWithError((label + ": backend not built in").c_str());
+        return;
+    }
+
+    ReusableDeflater deflater;
+    size_t compressed_size = 0;
+    for (auto _ : state) {
+        PixelView compressed = deflater.Compress(scanlines, profile);
+        compressed_size = compressed.size();
+        benchmark::DoNotOptimize(compressed.data());
+    }
+
+    state.counters["ratio"] = static_cast<double>(compressed_size) / scanlines.size();
+    ReportImage(state, index, label);
+}
+BENCHMARK(BM_DeflateBackend)
+    ->Apply([](auto* b) {
+        for (size_t index = 0; index < BenchImages().size(); ++index) {
+            for (DeflateBackendType backend :
+                 {DeflateBackendType::Zlib, DeflateBackendType::Libdeflate}) {
+                for (int level : {1, 6, 9}) {
+                    b->Args({static_cast<int64_t>(index), static_cast<int64_t>(backend), level});
+                }
+            }
+        }
+    })
+    ->Unit(benchmark::kMillisecond);
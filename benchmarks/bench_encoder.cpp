@@ -0,0 +1,32 @@
+// bench_encoder.cpp
+#include "bench_images.h"
+#include "encoder.h"
+#include "encoder_context.h"
+
+#include <string>
+
+// Whole single-threaded pipeline into /dev/null, with a fresh context per image (0)
+// or one context reused across iterations (1)
+static void BM_EncodeFile(benchmark::State& state) {
+    const size_t index = state.range(0);
+    const bool reuse = state.range(1) != 0;
+    const BenchImage& image = BenchImages()[index];
+
+    EncodeJob job = PNGEncoder::ParseJob({BenchRawPath(index), "/dev/null",
+                                          std::to_string(image.width),
+                                          std::to_string(image.height), "--compression=fast"});
+    EncoderContext context;
+
+    for (auto _ : state) {
+        if (reuse) {
+            PNGEncoder::EncodeFile(job, ThreadPool::Shared(), context);
+        } else {
+            PNGEncoder::EncodeFile(job);
+        }
+    }
+
+    ReportImage(state, index, reuse ? "reused context" : "fresh context");
+}
+BENCHMARK(BM_EncodeFile)
+    ->Apply([](auto* b) { ForEachImage(b, {0, 1}); })
+    ->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,139 @@
+// bench_filter.cpp
+#include "bench_images.h"
+#include "filter.h"
+#include "filter_kernels.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+const char* StrategyName(PNGFilterStrategy strategy) {
+    static const char* const kNames[] = {"none",  "sub",    "up",     "average",
+                                         "paeth", "minsum", "entropy"};
+    return kNames[static_cast<int>(strategy)];
+}
+
+const char* LevelName(SIMDLevel level) {
+    switch (level) {
+        case SIMDLevel::Scalar:
+            return "scalar";
+        case SIMDLevel::SSE41:
+            return "sse4.1";
+        case SIMDLevel::AVX2:
+            return "avx2";
+    }
+    return "";
+}
+
+}  // namespace
+
+// PNGFilter::Apply with a fixed filter type or an adaptive strategy
+static void BM_PNGFilterApply(benchmark::State& state) {
+    const size_t index = state.range(0);
+    const auto strategy = static_cast<PNGFilterStrategy>(state.range(1));
+    const BenchImage& image = BenchImages()[index];
+    const std::vector<uint8_t>& pixels = BenchPixels(index);
+
+    for (auto _ : state) {
+        std::vector<uint8_t> scanlines =
+            PNGFilter::Apply(pixels, image.width, image.height, strategy);
+        benchmark::DoNotOptimize(scanlines.data());
+    }
+
+    ReportImage(state, index, StrategyName(strategy));
+}
+BENCHMARK(BM_PNGFilterApply)
+    ->Apply([](auto* b) {
+        ForEachImage(b, {static_cast<int64_t>(PNGFilterStrategy::None),
+                         static_cast<int64_t>(PNGFilterStrategy::Sub),
+                         static_cast<int64_t>(PNGFilterStrategy::Up),
+                         static_cast<int64_t>(PNGFilterStrategy::Average),
+                         static_cast<int64_t>(PNGFilterStrategy::Paeth),
+                         static_cast<int64_t>(PNGFilterStrategy::MinSum),
+                         static_cast<int64_t>(PNGFilterStrategy::Entropy)});
+    })
+    ->Unit(benchmark::kMillisecond);
+
+// Grayscale + MinSum as two passes over a color filtered copy (0) or fused row by row (1)
+static void BM_ColorAndPNGFilter(benchmark::State& state) {
+    const size_t index = state.range(0);
+    const bool fused = state.range(1) != 0;
+    const BenchImage& image = BenchImages()[index];
+    const std::vector<uint8_t>& pixels = BenchPixels(index);
+
+    for (auto _ : state) {
+        std::vector<uint8_t> scanlines;
+        if (fused) {
+            scanlines = PNGFilter::Apply(pixels, image.width, image.height,
+                                         PNGFilterStrategy::MinSum, ColorFilterType::Grayscale);
+        } else {
+            std::vector<uint8_t> colored = ColorFilter::Apply(pixels, image.width, image.height,
+                                                              ColorFilterType::Grayscale);
+            scanlines = PNGFilter::Apply(colored, image.width, image.height,
+                                         PNGFilterStrategy::MinSum);
+        }
+        benchmark::DoNotOptimize(scanlines.data());
+    }
+
+    ReportImage(state, index, fused ? "fused" : "two passes");
+}
+BENCHMARK(BM_ColorAndPNGFilter)
+    ->Apply([](auto* b) { ForEachImage(b, {0, 1}); })
+    ->Unit(benchmark::kMillisecond);
+
+// MinSum split into row bands over a pool of the given size
+static void BM_PNGFilterParallel(benchmark::State& state) {
+    const size_t index = state.range(0);
+    const size_t threads = state.range(1);
+    const BenchImage& image = BenchImages()[index];
+    const std::vector<uint8_t>& pixels = BenchPixels(index);
+    ThreadPool pool(threads);
+
+    for (auto _ : state) {
+        std::vector<uint8_t> scanlines =
+            PNGFilter::Apply(pixels, image.width, image.height, PNGFilterStrategy::MinSum,
+                             ColorFilterType::None, -1.0f, {}, &pool);
+        benchmark::DoNotOptimize(scanlines.data());
+    }
+
+    ReportImage(state, index, std::to_string(threads) + " threads");
+}
+BENCHMARK(BM_PNGFilterParallel)
+    ->Apply([](auto* b) { ForEachImage(b, {1, 2, 4, 8, 16, 32}); })
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// Raw Paeth kernel per SIMD level, without allocation or row selection
+static void BM_PaethKernel(benchmark::State& state) {
+    const size_t index = state.range(0);
+    const auto level = static_cast<SIMDLevel>(state.range(1));
+
+    if (!PNGFilterKernels::IsSupported(level)) {
+        state.SkipWithError("SIMD level is not supported by this CPU");
+        return;
+    }
+
+    const BenchImage& image = BenchImages()[index];
+    const std::vector<uint8_t>& pixels = BenchPixels(index);
+    const size_t row_bytes = image.width * 3;
+    const PNGFilterKernels kernels = PNGFilterKernels::ForLevel(level);
+    std::vector<uint8_t> out(row_bytes);
+
+    for (auto _ : state) {
+        for (uint64_t y = 1; y < image.height; ++y) {
+            kernels.paeth(&pixels[y * row_bytes], &pixels[(y - 1) * row_bytes], row_bytes, 3,
+                          out.data());
+        }
+        benchmark::DoNotOptimize(out.data());
+    }
+
+    ReportImage(state, index, LevelName(level));
+}
+BENCHMARK(BM_PaethKernel)
+    ->Apply([](auto* b) {
+        ForEachImage(b, {static_cast<int64_t>(SIMDLevel::Scalar),
+                         static_cast<int64_t>(SIMDLevel::SSE41),
+                         static_cast<int64_t>(SIMDLevel::AVX2)});
+    })
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,39 @@
+// bench_image_loader.cpp
+#include "bench_images.h"
+#include "image_loader.h"
+
+// Reading the whole RAW file into a vector
+static void BM_LoadRawImage(benchmark::State& state) {
+    const size_t index = state.range(0);
+    const BenchImage& image = BenchImages()[index];
+    const std::string& path = BenchRawPath(index);
+
+    for (auto _ : state) {
+        RawImage raw = ImageLoader::LoadRawImage(path, image.width, image.height);
+        benchmark::DoNotOptimize(raw.data.data());
+    }
+
+    ReportImage(state, index);
+}
+BENCHMARK(BM_LoadRawImage)->Apply([](auto* b) { ForEachImage(b); })->Unit(benchmark::kMillisecond);
+
+// Mapping the file and touching every page
+static void BM_MapRawImage(benchmark::State& state) {
+    const size_t index = state.range(0);
+    const BenchImage& image = BenchImages()[index];
+    const std::string& path = BenchRawPath(index);
+
+    for (auto _ : state) {
+        MappedRawImage mapped(path, image.width, image.height);
+        PixelView view = mapped.View();
+
+        uint64_t sum = 0;
+        for (size_t i = 0; i < view.size(); i += 4096) {
+            sum += view[i];
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+
+    ReportImage(state, index);
+}
+BENCHMARK(BM_MapRawImage)->Apply([](auto* b) { ForEachImage(b); })->Unit(benchmark::kMillisecond);
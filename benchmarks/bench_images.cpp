@@ -0,0 +1,151 @@
+// bench_images.cpp
+#include "bench_images.h"
+#include "image_loader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <regex>
+#include <stdexcept>
+
+namespace {
+
+struct ImageCache {
+    ImageCache() {
+        // Same "<name>-<W>x<H>.raw" naming as BatchEncoder::ScanDirectory
+        const std::regex dimensions_pattern(R"(.*-(\d+)x(\d+))");
+
+        for (const auto& entry : std::filesystem::directory_iterator(PNG_ENCODER_EXAMPLES_DIR)) {
+            const std::string stem = entry.path().stem().string();
+            std::smatch match;
+
+            if (entry.is_regular_file() && entry.path().extension() == ".raw" &&
+                std::regex_match(stem, match, dimensions_pattern)) {
+                images.push_back({stem, std::stoull(match[1].str()), std::stoull(match[2].str()),
+                                  entry.path().string()});
+            }
+        }
+        std::sort(images.begin(), images.end(),
+                  [](const BenchImage& a, const BenchImage& b) { return a.Bytes() < b.Bytes(); });
+
+        images.push_back({"synthetic-3840x2160", 3840, 2160, ""});
+        images.push_back({"synthetic-7680x4320", 7680, 4320, ""});
+
+        pixels.resize(images.size());
+    }
+
+    // Synthetic frames written by BenchRawPath take 25-100 MB each, drop them at exit
+    ~ImageCache() {
+        for (const std::string& path : written) {
+            std::error_code error;
+            std::filesystem::remove(path, error);
+        }
+    }
+
+    std::vector<BenchImage> images;
+    std::vector<std::unique_ptr<std::vector<uint8_t>>> pixels;
+    std::vector<std::string> written;
+    std::mutex mutex;
+};
+
+ImageCache& Cache() {
+    static ImageCache cache;
+    return cache;
+}
+
+// Smooth gradients with soft-edged shapes and a little noise, so that filters and
+// deflate see something closer to a photo than to random bytes or a flat fill
+std::vector<uint8_t> MakeSynthetic(uint64_t width, uint64_t height) {
+    std::vector<uint8_t> pixels(width * height * 3);
+    uint32_t seed = 0x9E3779B9u;
+
+    for (uint64_t y = 0; y < height; ++y) {
+        for (uint64_t x = 0; x < width; ++x) {
+            seed = seed * 1664525u + 1013904223u;
+            const int noise = static_cast<int>(seed >> 29) - 4;
+
+            const double u = static_cast<double>(x) / width;
+            const double v = static_cast<double>(y) / height;
+            const double wave = std::sin(u * 12.0) * std::cos(v * 9.0);
+
+            uint8_t* pixel = &pixels[(y * width + x) * 3];
+            pixel[0] = static_cast<uint8_t>(std::clamp(u * 200.0 + wave * 40.0 + noise, 0.0, 255.0));
+            pixel[1] = static_cast<uint8_t>(std::clamp(v * 220.0 + noise, 0.0, 255.0));
+            pixel[2] = static_cast<uint8_t>(std::clamp(128.0 + wave * 100.0 + noise, 0.0, 255.0));
+        }
+    }
+
+    return pixels;
+}
+
+}  // namespace
+
+const std::vector<BenchImage>& BenchImages() {
+    return Cache().images;
+}
+
+const std::vector<uint8_t>& BenchPixels(size_t index) {
+    ImageCache& cache = Cache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+
+    auto& slot = cache.pixels.at(index);
+    if (!slot) {
+        const BenchImage& image = cache.images[index];
+
+        if (image.path.empty()) {
+            slot = std::make_unique<std::vector<uint8_t>>(MakeSynthetic(image.width, image.height));
+        } else {
+            slot = std::make_unique<std::vector<uint8_t>>(
+                ImageLoader::LoadRawImage(image.path, image.width, image.height).data);
+        }
+    }
+
+    return *slot;
+}
+
+const std::string& BenchRawPath(size_t index) {
+    const std::vector<uint8_t>& pixels = BenchPixels(index);
+
+    ImageCache& cache = Cache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+
+    BenchImage& image = cache.images.at(index);
+    if (image.path.empty()) {
+        image.path = (std::filesystem::temp_directory_path() / (image.name + ".raw")).string();
+
+        cache.written.push_back(image.path);
+
+        std::ofstream out(image.path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(pixels.data()), pixels.size());
+
+        if (!out) {
+            throw std::runtime_error("Failed to write " + image.path);
+        }
+    }
+
+    return image.path;
+}
+
+void ForEachImage(benchmark::internal::Benchmark* bench) {
+    for (size_t i = 0; i < BenchImages().size(); ++i) {
+        bench->Arg(static_cast<int64_t>(i));
+    }
+}
+
+void ForEachImage(benchmark::internal::Benchmark* bench, const std::vector<int64_t>& values) {
+    for (int64_t value : values) {
+        for (size_t i = 0; i < BenchImages().size(); ++i) {
+            bench->Args({static_cast<int64_t>(i), value});
+        }
+    }
+}
+
+void ReportImage(benchmark::State& state, size_t index, const std::string& label) {
+    const BenchImage& image = BenchImages().at(index);
+
+    state.SetLabel(label.empty() ? image.name : image.name + "/" + label);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * image.Bytes()));
+}
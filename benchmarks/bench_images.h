@@ -0,0 +1,37 @@
+// bench_images.h
+#pragma once
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Image set shared by every benchmark: the RAW files from examples/raw plus synthetic
+// 4K and 8K frames. Pixels are produced on first use and kept for the whole run.
+struct BenchImage {
+    std::string name;
+    uint64_t width;
+    uint64_t height;
+    std::string path;  // RAW file on disk, synthetic frames are written out on demand
+
+    uint64_t Bytes() const {
+        return width * height * 3;
+    }
+};
+
+const std::vector<BenchImage>& BenchImages();
+
+const std::vector<uint8_t>& BenchPixels(size_t index);
+
+// Path to a RAW file holding the image, for benchmarks that read from disk. Synthetic
+// frames go to the temp directory and are removed when the process exits.
+const std::string& BenchRawPath(size_t index);
+
+// Adds one argument set per image, optionally crossed with a second parameter
+void ForEachImage(benchmark::internal::Benchmark* bench);
+void ForEachImage(benchmark::internal::Benchmark* bench, const std::vector<int64_t>& values);
+
+// Labels the run with the image name and reports bytes/second over the raw pixel size
+void ReportImage(benchmark::State& state, size_t index, const std::string& label = "");
@@ -0,0 +1,76 @@
+// bench_png_writer.cpp
+#include "bench_images.h"
+#include "crc32.h"
+#include "png_writer.h"
+
+#include <cstdio>
+#include <filesystem>
+
+namespace {
+
+const char* EngineName(CRC32Engine engine) {
+    switch (engine) {
+        case CRC32Engine::Bytewise:
+            return "bytewise";
+        case CRC32Engine::SliceBy8:
+            return "slice-by-8";
+        case CRC32Engine::PCLMUL:
+            return "pclmul";
+    }
+    return "";
+}
+
+}  // namespace
+
+// CRC-32 of the raw pixels per engine
+static void BM_CRC32(benchmark::State& state) {
+    const size_t index = state.range(0);
+    const auto engine = static_cast<CRC32Engine>(state.range(1));
+
+    if (!CRC32::IsSupported(engine)) {
+        state.SkipWithError("CRC32 engine is not supported by this CPU");
+        return;
+    }
+
+    const std::vector<uint8_t>& pixels = BenchPixels(index);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(CRC32::Compute(engine, pixels.data(), pixels.size()));
+    }
+
+    ReportImage(state, index, EngineName(engine));
+}
+BENCHMARK(BM_CRC32)
+    ->Apply([](auto* b) {
+        ForEachImage(b, {static_cast<int64_t>(CRC32Engine::Bytewise),
+                         static_cast<int64_t>(CRC32Engine::SliceBy8),
+                         static_cast<int64_t>(CRC32Engine::PCLMUL)});
+    })
+    ->Unit(benchmark::kMillisecond);
+
+// Chunking, CRC and output of an image-sized payload, in memory (0) or to a file (1)
+static void BM_PNGWriter(benchmark::State& state) {
+    const size_t index = state.range(0);
+    const bool to_file = state.range(1) != 0;
+    const BenchImage& image = BenchImages()[index];
+    const std::vector<uint8_t>& payload = BenchPixels(index);
+    const std::string path =
+        (std::filesystem::temp_directory_path() / "png_encoder_bench.png").string();
+
+    PNGWriter writer;
+    for (auto _ : state) {
+        if (to_file) {
+            writer.WritePNG(path, image.width, image.height, payload);
+        } else {
+            MemorySink sink;
+            writer.WritePNG(sink, image.width, image.height, payload);
+            benchmark::DoNotOptimize(sink.Data().data());
+        }
+    }
+
+    if (to_file) {
+        std::remove(path.c_str());
+    }
+
+    ReportImage(state, index, to_file ? "file" : "memory");
+}
+BENCHMARK(BM_PNGWriter)->Apply([](auto* b) { ForEachImage(b, {0, 1}); })->Unit(benchmark::kMillisecond);
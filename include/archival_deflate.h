@@ -0,0 +1,30 @@
+// archival_deflate.h
+#pragma once
+
+#include "deflate.h"
+#include "thread_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Zopfli-style compressor for files written once and served many times: much slower than
+// zlib level 9, with smaller output. The input is cut into master blocks, each master block
+// is parsed greedily and split where separate Huffman codes pay off, then every block gets
+// an iterative optimal parse: shortest path over all matches under a cost model taken from
+// the previous parse (profile.iterations rounds). Blocks are parsed concurrently on the
+// pool and their bits joined into one zlib stream; the output does not depend on threads.
+class ArchivalDeflateCompressor {
+public:
+    // Blocks are never split across master blocks, which bounds the memory of one parse
+    static constexpr size_t kMasterBlockSize = 1 << 20;
+    // Most blocks one master block is split into
+    static constexpr size_t kMaxBlocks = 15;
+
+    // Uses profile.iterations and profile.window_bits; level, strategy and memLevel are ignored
+    static std::vector<uint8_t> Compress(PixelView data, const CompressionProfile& profile = {},
+                                         ThreadPool* pool = nullptr);
+
+    // Upper bound of the stream size for size input bytes (stored blocks)
+    static size_t Bound(size_t size);
+};
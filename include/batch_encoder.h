@@ -0,0 +1,65 @@
+// batch_encoder.h
+#pragma once
+
+#include "encoder.h"
+#include "thread_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct BatchResult {
+    EncodeJob job;
+    bool ok = false;
+    std::string error;
+    double seconds = 0.0;
+    uint64_t input_bytes = 0;
+    uint64_t output_bytes = 0;
+};
+
+struct BatchReport {
+    std::vector<BatchResult> results;
+    double wall_seconds = 0.0;
+    uint64_t input_bytes = 0;
+    uint64_t output_bytes = 0;
+    size_t failed = 0;
+};
+
+// Encodes many RAW files concurrently on one thread pool. Jobs are admitted only while
+// the estimated memory of the jobs in flight stays under max_in_flight_bytes.
+class BatchEncoder {
+public:
+    static constexpr uint64_t kDefaultMaxInFlightBytes = 1ull << 30;
+
+    explicit BatchEncoder(size_t threads = ThreadPool::DefaultThreadCount(),
+                          uint64_t max_in_flight_bytes = kDefaultMaxInFlightBytes);
+
+    // One job per line in the png_encoder argument syntax:
+    //   in.raw out.png W H [filter [percent]] [--option=value ...]
+    // Blank lines and lines starting with '#' are skipped. default_args are prepended
+    // to every line, so options given on the line win.
+    static std::vector<EncodeJob> ReadManifest(const std::string& manifest_path,
+                                               const std::vector<std::string>& default_args = {});
+
+    // Every "<name>-<W>x<H>.raw" file of input_dir becomes "<output_dir>/<name>-<W>x<H>.png".
+    // Files without dimensions in their name are reported in skipped.
+    static std::vector<EncodeJob> ScanDirectory(const std::string& input_dir,
+                                                const std::string& output_dir,
+                                                const std::vector<std::string>& default_args = {},
+                                                std::vector<std::string>* skipped = nullptr);
+
+    // Rough peak memory of one job: RAW image, color filtered copy, scanlines, deflate output,
+    // plus the same for every --sizes variant
+    static uint64_t EstimateJobBytes(const EncodeJob& job);
+
+    // Jobs look up and store their outputs in cache; nullptr, the default, encodes every job
+    void SetCache(EncodeCache* cache);
+
+    BatchReport Run(const std::vector<EncodeJob>& jobs);
+
+private:
+    ThreadPool pool_;
+    uint64_t max_in_flight_bytes_;
+    EncodeCache* cache_ = nullptr;
+};
@@ -0,0 +1,213 @@
+// bounded_queue.h
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+struct QueueStats {
+    uint64_t pushes = 0;
+    // Depth seen by every push, for the average, and the largest one
+    uint64_t depth_sum = 0;
+    size_t max_depth = 0;
+    // Times a producer found the queue full / a consumer found it empty and had to wait
+    uint64_t full_waits = 0;
+    uint64_t empty_waits = 0;
+
+    double AverageDepth() const {
+        return pushes != 0 ? static_cast<double>(depth_sum) / pushes : 0.0;
+    }
+};
+
+// Bounded lock-free multi-producer multi-consumer ring (Vyukov): every cell carries a
+// sequence number telling producers and consumers whose turn it is, so TryPush/TryPop
+// are a single CAS on the shared position. Push/Pop wait with yield and short sleeps.
+// The capacity is rounded up to a power of two.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity)
+        : mask_(RoundUpToPowerOfTwo(std::max<size_t>(capacity, 2)) - 1),
+          cells_(std::make_unique<Cell[]>(mask_ + 1)),
+          enqueue_pos_(0),
+          dequeue_pos_(0),
+          closed_(false) {
+        for (size_t i = 0; i <= mask_; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    bool TryPush(T& value) {
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        Cell* cell = nullptr;
+
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+                                                       std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        RecordPush(pos + 1);
+        return true;
+    }
+
+    bool TryPop(T& value) {
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        Cell* cell = nullptr;
+
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff =
+                static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+
+            if (diff == 0) {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1,
+                                                       std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        value = std::move(cell->value);
+        cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Waits for a free cell; returns false without pushing once the queue is closed
+    bool Push(T value) {
+        if (TryPush(value)) {
+            return true;
+        }
+
+        full_waits_.fetch_add(1, std::memory_order_relaxed);
+        for (size_t attempt = 0; !closed_.load(std::memory_order_acquire); ++attempt) {
+            if (TryPush(value)) {
+                return true;
+            }
+            Backoff(attempt);
+        }
+
+        return false;
+    }
+
+    // Waits for an item; returns false once the queue is closed and drained
+    bool Pop(T& value) {
+        if (TryPop(value)) {
+            return true;
+        }
+
+        empty_waits_.fetch_add(1, std::memory_order_relaxed);
+        for (size_t attempt = 0;; ++attempt) {
+            // Items pushed before Close() are still handed out
+            const bool closed = closed_.load(std::memory_order_acquire);
+            if (TryPop(value)) {
+                return true;
+            }
+            if (closed) {
+                return false;
+            }
+            Backoff(attempt);
+        }
+    }
+
+    void Close() {
+        closed_.store(true, std::memory_order_release);
+    }
+
+    size_t Capacity() const {
+        return mask_ + 1;
+    }
+
+    // Exact only while no other thread touches the queue
+    size_t ApproximateSize() const {
+        const size_t enqueued = enqueue_pos_.load(std::memory_order_relaxed);
+        const size_t dequeued = dequeue_pos_.load(std::memory_order_relaxed);
+        return enqueued > dequeued ? enqueued - dequeued : 0;
+    }
+
+    QueueStats Stats() const {
+        QueueStats stats;
+        stats.pushes = pushes_.load(std::memory_order_relaxed);
+        stats.depth_sum = depth_sum_.load(std::memory_order_relaxed);
+        stats.max_depth = max_depth_.load(std::memory_order_relaxed);
+        stats.full_waits = full_waits_.load(std::memory_order_relaxed);
+        stats.empty_waits = empty_waits_.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    static size_t RoundUpToPowerOfTwo(size_t value) {
+        size_t power = 1;
+        while (power < value) {
+            power <<= 1;
+        }
+        return power;
+    }
+
+    // Stages hand over whole frames, so waits are long compared to a spin: yield first,
+    // then sleep so idle stages leave the cores to the busy ones
+    static void Backoff(size_t attempt) {
+        if (attempt < 64) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+    void RecordPush(size_t enqueued) {
+        const size_t dequeued = dequeue_pos_.load(std::memory_order_relaxed);
+        const size_t depth = enqueued > dequeued ? enqueued - dequeued : 0;
+
+        pushes_.fetch_add(1, std::memory_order_relaxed);
+        depth_sum_.fetch_add(depth, std::memory_order_relaxed);
+
+        size_t max_depth = max_depth_.load(std::memory_order_relaxed);
+        while (depth > max_depth &&
+               !max_depth_.compare_exchange_weak(max_depth, depth, std::memory_order_relaxed)) {
+        }
+    }
+
+    const size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+
+    // Producers and consumers update different cache lines
+    alignas(64) std::atomic<size_t> enqueue_pos_;
+    alignas(64) std::atomic<size_t> dequeue_pos_;
+    alignas(64) std::atomic<bool> closed_;
+
+    std::atomic<uint64_t> pushes_{0};
+    std::atomic<uint64_t> depth_sum_{0};
+    std::atomic<size_t> max_depth_{0};
+    std::atomic<uint64_t> full_waits_{0};
+    std::atomic<uint64_t> empty_waits_{0};
+};
@@ -1,6 +1,9 @@
 // color_filter.h
 #pragma once
 
+#include "pixel_view.h"
+#include "thread_pool.h"
+
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -9,9 +12,21 @@ enum class ColorFilterType { None, Negative, Grayscale, PerlinNoise };
 
 class ColorFilter {
 public:
-    static std::vector<uint8_t> Apply(const std::vector<uint8_t>& rgb_data, uint64_t width,
-                                      uint64_t height, ColorFilterType filter_type,
-                                      float perlin_noise_scale = -1.0f);
+    // Filtered copy of the image. With a pool the rows are split into bands filtered
+    // concurrently; the filters work per pixel, so the output matches the serial one.
+    static std::vector<uint8_t> Apply(PixelView rgb_data, uint64_t width, uint64_t height,
+                                      ColorFilterType filter_type,
+                                      float perlin_noise_scale = -1.0f,
+                                      ThreadPool* pool = nullptr);
+
+    // In-place variant for row_count rows starting at image row first_row, using the SIMD
+    // kernels for the best instruction set of the CPU
+    static void ApplyRows(uint8_t* rgb_rows, uint64_t width, uint64_t first_row,
+                          uint64_t row_count, ColorFilterType filter_type,
+                          float perlin_noise_scale = -1.0f);
+
+    // Smallest band handed to one worker by the parallel Apply
+    static constexpr uint64_t kMinBandRows = 16;
 
     static ColorFilterType Parse(const std::string& filter_name);
 };
\ No newline at end of file
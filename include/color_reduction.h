@@ -0,0 +1,84 @@
+// color_reduction.h
+#pragma once
+
+#include "color_filter.h"
+#include "pixel_format.h"
+#include "pixel_view.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Collects what is needed to pick the smallest lossless PixelFormat for RGB pixels:
+// whether every pixel is gray, which gray levels occur and up to 256 distinct colors.
+class ColorAnalyzer {
+public:
+    ColorAnalyzer();
+
+    void AddPixels(const uint8_t* rgb, size_t pixel_count);
+
+    // True once neither grayscale nor a palette is possible; more pixels change nothing
+    bool IsTruecolor() const;
+
+    // Grayscale wins ties with a palette of the same depth since it needs no PLTE
+    PixelFormat Result() const;
+
+private:
+    static constexpr size_t kMaxPaletteSize = 256;
+    static constexpr size_t kTableSize = 1024;
+    static constexpr uint32_t kEmpty = 0xFFFFFFFF;
+
+    void AddColor(uint32_t color);
+
+    bool gray_;
+    std::array<bool, 256> gray_levels_;
+
+    bool palette_overflow_;
+    size_t color_count_;
+    uint32_t last_color_;
+    std::array<uint32_t, kTableSize> colors_;
+};
+
+// Packs RGB rows into a PixelFormat: gray samples or palette indices, MSB first
+// for bit depths below 8. The format must outlive the packer.
+class PixelPacker {
+public:
+    explicit PixelPacker(const PixelFormat& format);
+
+    // Writes format.RowBytes(width) bytes; every pixel must be representable in the format
+    void PackRow(const uint8_t* rgb_row, uint64_t width, uint8_t* out) const;
+
+    // Whether every pixel of the row is representable in the format
+    bool CanPack(const uint8_t* rgb_row, uint64_t width) const;
+
+private:
+    static constexpr size_t kTableSize = 1024;
+    static constexpr uint32_t kEmpty = 0xFFFFFFFF;
+
+    size_t PaletteSlot(uint32_t color) const;
+    uint8_t PaletteIndex(uint32_t color) const;
+
+    const PixelFormat& format_;
+    std::array<uint32_t, kTableSize> keys_;
+    std::array<uint8_t, kTableSize> indices_;
+};
+
+class ColorReducer {
+public:
+    // Smallest lossless format for the image after the color filter, which is applied
+    // row by row in a scratch buffer. Stops reading as soon as only RGB remains possible.
+    static PixelFormat Analyze(const ImageView& image,
+                               ColorFilterType color_filter = ColorFilterType::None,
+                               float perlin_noise_scale = -1.0f);
+
+    // Whether the rows flagged in rows, after the color filter, fit in format; lets a frame
+    // that changed only in a few rows keep the format of the frame before it
+    static bool Fits(const ImageView& image, const std::vector<uint8_t>& rows,
+                     const PixelFormat& format,
+                     ColorFilterType color_filter = ColorFilterType::None,
+                     float perlin_noise_scale = -1.0f);
+
+    static std::vector<uint8_t> Pack(PixelView rgb_data, uint64_t width, uint64_t height,
+                                     const PixelFormat& format);
+};
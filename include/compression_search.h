@@ -0,0 +1,60 @@
+// compression_search.h
+#pragma once
+
+#include "color_filter.h"
+#include "deflate.h"
+#include "filter.h"
+#include "pixel_format.h"
+#include "pixel_view.h"
+#include "thread_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One combination tried by CompressionSearch
+struct SearchTrial {
+    PNGFilterStrategy png_filter = PNGFilterStrategy::MinSum;
+    CompressionProfile compression;
+
+    bool operator==(const SearchTrial&) const = default;
+};
+
+struct SearchResult {
+    // Smallest zlib stream and the trial that wrote it; of equal sizes the earlier trial wins
+    SearchTrial best;
+    std::vector<uint8_t> compressed;
+    size_t trials = 0;
+    // Trials abandoned once their output grew past the best finished one
+    size_t stopped = 0;
+};
+
+// Brute-force search for the smallest IDAT over PNG filter strategies and zlib parameters.
+// The image is filtered once per filter strategy; the zlib trials of that strategy then
+// share the scanlines and run concurrently on the pool. Every worker slot keeps one
+// z_stream and output buffer for all its trials, so memory grows with the thread count,
+// not with the number of trials. A trial stops as soon as its output passes the best
+// size finished so far. The result does not depend on the pool.
+class CompressionSearch {
+public:
+    // Input bytes deflated between two checks against the best size
+    static constexpr size_t kCheckInterval = 64 * 1024;
+
+    // Every filter strategy x level 9 x {default, filtered, rle} x memLevel {8, 9};
+    // window bits come from base
+    static std::vector<SearchTrial> DefaultTrials(const CompressionProfile& base = {});
+
+    // Cross product in the order filters, levels, strategies, memLevels (the last varies
+    // fastest); other parameters come from base
+    static std::vector<SearchTrial> Matrix(const std::vector<PNGFilterStrategy>& filters,
+                                           const std::vector<int>& levels,
+                                           const std::vector<DeflateStrategy>& strategies,
+                                           const std::vector<int>& mem_levels,
+                                           const CompressionProfile& base = {});
+
+    // Trials must use the zlib backend. Throws std::runtime_error on an empty trial list.
+    static SearchResult Run(const ImageView& image, ColorFilterType color_filter,
+                            float perlin_noise_scale, const PixelFormat& format,
+                            const std::vector<SearchTrial>& trials, ThreadPool* pool,
+                            PNGFilterBuffers& buffers);
+};
@@ -0,0 +1,32 @@
+// crc32.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+enum class CRC32Engine { Bytewise, SliceBy8, PCLMUL };
+
+// CRC-32 as used by PNG chunks (ISO-HDLC, reflected polynomial 0xEDB88320).
+// Data can be fed in any number of pieces, so a chunk's type and payload
+// are hashed without concatenating them.
+class CRC32 {
+public:
+    CRC32();
+
+    void Update(const uint8_t* data, size_t size);
+    uint32_t Value() const;
+    void Reset();
+
+    static uint32_t Compute(const uint8_t* data, size_t size);
+
+    // CRC of A + B from CRC(A), CRC(B) and the length of B, so pieces can be hashed in parallel
+    static uint32_t Combine(uint32_t crc1, uint32_t crc2, uint64_t size2);
+
+    // Fastest engine of the running CPU, detected once
+    static CRC32Engine ActiveEngine();
+    static bool IsSupported(CRC32Engine engine);
+    static uint32_t Compute(CRC32Engine engine, const uint8_t* data, size_t size);
+
+private:
+    uint32_t state_;
+};
@@ -1,10 +1,78 @@
 // deflate.h
 #pragma once
 
+#include "pixel_view.h"
+
+#include <memory>
 #include <vector>
 #include <cstdint>
+#include <string>
+
+// Mirrors zlib's Z_DEFAULT_STRATEGY, Z_FILTERED, Z_HUFFMAN_ONLY, Z_RLE and Z_FIXED
+enum class DeflateStrategy { Default, Filtered, HuffmanOnly, RLE, Fixed };
+
+// Library producing the zlib stream. libdeflate exists only when the build enables it
+// (PNG_ENCODER_WITH_LIBDEFLATE); archival is the
+// built-in optimal parser (ArchivalDeflateCompressor).
+enum class DeflateBackendType { Zlib, Libdeflate, Archival };
+
+class DeflateBackend;
+
+struct CompressionProfile {
+    int level = 9;
+    DeflateStrategy strategy = DeflateStrategy::Default;
+    int window_bits = 15;
+    int mem_level = 8;
+
+    // libdeflate takes levels up to 12 and ignores strategy, window bits and memLevel
+    DeflateBackendType backend = DeflateBackendType::Zlib;
+
+    // Optimal parse rounds of the archival backend, which ignores level and strategy
+    int iterations = 15;
+
+    // fast: level 1 + Z_RLE, balanced: level 6 + Z_FILTERED, max: level 9 (the default)
+    static CompressionProfile Fast();
+    static CompressionProfile Balanced();
+    static CompressionProfile Max();
+
+    static CompressionProfile Parse(const std::string& preset_name);
+    static DeflateStrategy ParseStrategy(const std::string& strategy_name);
+    static DeflateBackendType ParseBackend(const std::string& backend_name);
+
+    // Throws std::runtime_error if a parameter is outside the range the backend accepts
+    // or the backend is not built in
+    void Validate() const;
+
+    // zlib's own constant for the strategy
+    int ZlibStrategy() const;
+
+    bool operator==(const CompressionProfile&) const = default;
+};
 
 class DeflateCompressor {
 public:
-    static std::vector<uint8_t> Compress(const std::vector<uint8_t>& data);
-};
\ No newline at end of file
+    static std::vector<uint8_t> Compress(PixelView data, const CompressionProfile& profile = {});
+};
+
+// Backend state and output buffer kept between calls: with zlib a repeated profile costs a
+// deflateReset instead of deflateInit2/deflateEnd, and the output buffer only grows.
+// Produces the same bytes as DeflateCompressor::Compress.
+class ReusableDeflater {
+public:
+    ReusableDeflater();
+    ~ReusableDeflater();
+
+    ReusableDeflater(const ReusableDeflater&) = delete;
+    ReusableDeflater& operator=(const ReusableDeflater&) = delete;
+
+    // The result stays valid until the next call
+    PixelView Compress(PixelView data, const CompressionProfile& profile);
+
+    size_t Capacity() const;
+    void Release();
+
+private:
+    std::unique_ptr<DeflateBackend> backend_;
+    DeflateBackendType backend_type_;
+    std::vector<uint8_t> output_;
+};
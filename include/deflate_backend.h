@@ -0,0 +1,34 @@
+// deflate_backend.h
+#pragma once
+
+#include "deflate.h"
+#include "pixel_view.h"
+
+#include <cstdint>
+#include <memory>
+
+// Whole-buffer zlib stream compressor of one library. A backend keeps its library state
+// (z_stream, libdeflate compressor) between calls and must not be shared between threads.
+class DeflateBackend {
+public:
+    virtual ~DeflateBackend() = default;
+
+    // Upper bound of the zlib stream size for size input bytes
+    virtual size_t Bound(size_t size, const CompressionProfile& profile) = 0;
+
+    // Writes the zlib stream of data into out, which holds at least Bound(data.size()) bytes.
+    // Returns the stream size.
+    virtual size_t Compress(PixelView data, const CompressionProfile& profile, uint8_t* out,
+                            size_t capacity) = 0;
+
+    // Throws std::runtime_error if the backend is not built in
+    static std::unique_ptr<DeflateBackend> Create(DeflateBackendType type);
+
+    static bool IsAvailable(DeflateBackendType type);
+    static const char* Name(DeflateBackendType type);
+
+private:
+    static std::unique_ptr<DeflateBackend> CreateZlib();
+    static std::unique_ptr<DeflateBackend> CreateLibdeflate();
+    static std::unique_ptr<DeflateBackend> CreateArchival();
+};
@@ -0,0 +1,68 @@
+// encode_cache.h
+#pragma once
+
+#include "encoder.h"
+#include "pixel_view.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+struct CacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t stores = 0;
+    uint64_t evictions = 0;
+    // Size of the cache directory's entries after the last store or eviction
+    uint64_t bytes = 0;
+};
+
+// On-disk cache of encoded PNGs named by content: the XXH64 of the RAW bytes and of every
+// option that changes the output. A hit hard-links the cached file to the output path
+// (copying where links fail, e.g. across file systems) instead of encoding. Entries are
+// read-only, and FileSink replaces an output linked to one instead of writing through it.
+// The least recently used entries, by modification time, are evicted once the entries
+// exceed max_bytes. Several threads and processes may share one directory.
+class EncodeCache {
+public:
+    static constexpr uint64_t kDefaultMaxBytes = 1ull << 30;
+
+    // Creates directory if needed
+    explicit EncodeCache(const std::string& directory, uint64_t max_bytes = kDefaultMaxBytes);
+
+    EncodeCache(const EncodeCache&) = delete;
+    EncodeCache& operator=(const EncodeCache&) = delete;
+
+    // 32 hex digits: hash of raw, then hash of the job's size and output options
+    static std::string Key(const EncodeJob& job, PixelView raw);
+
+    // Jobs whose output is one regular file: not streamed, no --sizes, not stdout
+    static bool IsCacheable(const EncodeJob& job);
+
+    // Puts the entry of key at output_path; false on a miss
+    bool Fetch(const std::string& key, const std::string& output_path);
+
+    // Copies output_path into the cache under key, then evicts over the limit
+    void Store(const std::string& key, const std::string& output_path);
+
+    CacheStats Stats() const;
+
+    const std::string& Directory() const;
+
+private:
+    std::string EntryPath(const std::string& key) const;
+    void Evict();
+
+    std::string directory_;
+    uint64_t max_bytes_;
+
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> stores_{0};
+    std::atomic<uint64_t> evictions_{0};
+    std::atomic<uint64_t> bytes_{0};
+    std::atomic<uint64_t> next_temporary_{0};
+    std::mutex evict_mutex_;
+};
@@ -0,0 +1,197 @@
+// encode_stats.h
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+enum class EncodeStage : uint8_t {
+    Load,
+    Resize,
+    ColorAnalysis,
+    ColorFilter,
+    PNGFilter,
+    Deflate,
+    CRC,
+    Write,
+};
+
+inline constexpr size_t kEncodeStageCount = 8;
+
+struct EncodeStageStats {
+    uint64_t calls = 0;
+    // Time of the stage itself, without the stages timed inside it, summed over threads
+    uint64_t nanoseconds = 0;
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = 0;
+
+    double Seconds() const {
+        return static_cast<double>(nanoseconds) / 1e9;
+    }
+};
+
+struct EncodeStats {
+    std::array<EncodeStageStats, kEncodeStageCount> stages{};
+    // operator new calls while collecting; counted only by programs that route their
+    // allocations to StatsCollector::RecordAllocation (png_encoder does)
+    uint64_t allocations = 0;
+    uint64_t allocated_bytes = 0;
+    double wall_seconds = 0.0;
+
+    const EncodeStageStats& Stage(EncodeStage stage) const {
+        return stages[static_cast<size_t>(stage)];
+    }
+
+    static const char* StageName(EncodeStage stage);
+
+    std::string ToText() const;
+    std::string ToJSON() const;
+};
+
+// Counters shared by every thread working for one encode. Stages report to the collector
+// installed on their thread (ScopedStatsCollector); ThreadPool::ParallelFor carries it
+// over to the workers. Without a collector a timer costs one thread-local load and a
+// predicted branch. Building with PNG_ENCODER_ENABLE_STATS=OFF removes the timers.
+class StatsCollector {
+public:
+#ifdef PNG_ENCODER_STATS
+    static constexpr bool kEnabled = true;
+#else
+    static constexpr bool kEnabled = false;
+#endif
+
+    StatsCollector();
+
+    StatsCollector(const StatsCollector&) = delete;
+    StatsCollector& operator=(const StatsCollector&) = delete;
+
+    void AddStage(EncodeStage stage, uint64_t nanoseconds, uint64_t bytes_in, uint64_t bytes_out);
+    void AddAllocation(size_t bytes);
+
+    // Counters so far; wall_seconds counts from the construction of the collector
+    EncodeStats Snapshot() const;
+
+    static StatsCollector* Current() {
+#ifdef PNG_ENCODER_STATS
+        return current_;
+#else
+        return nullptr;
+#endif
+    }
+
+    // Called from operator new replacements; must not allocate
+    static void RecordAllocation(size_t bytes) {
+#ifdef PNG_ENCODER_STATS
+        if (current_ != nullptr) [[unlikely]] {
+            current_->AddAllocation(bytes);
+        }
+#else
+        (void)bytes;
+#endif
+    }
+
+private:
+    friend class ScopedStatsCollector;
+
+    struct AtomicStage {
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> nanoseconds{0};
+        std::atomic<uint64_t> bytes_in{0};
+        std::atomic<uint64_t> bytes_out{0};
+    };
+
+    std::array<AtomicStage, kEncodeStageCount> stages_;
+    std::atomic<uint64_t> allocations_{0};
+    std::atomic<uint64_t> allocated_bytes_{0};
+    std::chrono::steady_clock::time_point start_;
+
+#ifdef PNG_ENCODER_STATS
+    static inline thread_local StatsCollector* current_ = nullptr;
+#endif
+};
+
+// Makes collector the current one of this thread for the scope; nullptr pauses collection
+class ScopedStatsCollector {
+public:
+    explicit ScopedStatsCollector(StatsCollector* collector) {
+#ifdef PNG_ENCODER_STATS
+        previous_ = StatsCollector::current_;
+        StatsCollector::current_ = collector;
+#else
+        (void)collector;
+#endif
+    }
+
+    ~ScopedStatsCollector() {
+#ifdef PNG_ENCODER_STATS
+        StatsCollector::current_ = previous_;
+#endif
+    }
+
+    ScopedStatsCollector(const ScopedStatsCollector&) = delete;
+    ScopedStatsCollector& operator=(const ScopedStatsCollector&) = delete;
+
+private:
+#ifdef PNG_ENCODER_STATS
+    StatsCollector* previous_;
+#endif
+};
+
+// Times the enclosing scope as one call of stage. A timer nested in another one on the
+// same thread takes its time out of the outer stage, so stages never count time twice.
+class StageTimer {
+public:
+#ifdef PNG_ENCODER_STATS
+    explicit StageTimer(EncodeStage stage, uint64_t bytes_in = 0)
+        : collector_(StatsCollector::Current()) {
+        if (collector_ != nullptr) [[unlikely]] {
+            Start(stage, bytes_in);
+        }
+    }
+
+    ~StageTimer() {
+        if (collector_ != nullptr) [[unlikely]] {
+            Stop();
+        }
+    }
+
+    void AddBytesIn(uint64_t bytes) {
+        bytes_in_ += bytes;
+    }
+
+    void AddBytesOut(uint64_t bytes) {
+        bytes_out_ += bytes;
+    }
+#else
+    explicit StageTimer(EncodeStage, uint64_t = 0) {
+    }
+
+    void AddBytesIn(uint64_t) {
+    }
+
+    void AddBytesOut(uint64_t) {
+    }
+#endif
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+#ifdef PNG_ENCODER_STATS
+private:
+    void Start(EncodeStage stage, uint64_t bytes_in);
+    void Stop();
+
+    StatsCollector* collector_;
+    EncodeStage stage_ = EncodeStage::Load;
+    uint64_t bytes_in_ = 0;
+    uint64_t bytes_out_ = 0;
+    std::chrono::steady_clock::time_point start_;
+    uint64_t nested_nanoseconds_ = 0;
+    StageTimer* parent_ = nullptr;
+
+    static inline thread_local StageTimer* innermost_ = nullptr;
+#endif
+};
@@ -0,0 +1,86 @@
+// encoder.h
+#pragma once
+
+#include "color_filter.h"
+#include "deflate.h"
+#include "filter.h"
+#include "image_resizer.h"
+#include "output_sink.h"
+#include "pixel_view.h"
+#include "png_writer.h"
+#include "thread_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class EncodeCache;
+class EncoderContext;
+
+struct EncodeOptions {
+    ColorFilterType color_filter = ColorFilterType::None;
+    float perlin_strength = 0.f;
+    PNGFilterStrategy png_filter = PNGFilterStrategy::MinSum;
+    CompressionProfile compression = CompressionProfile::Max();
+    size_t threads = 1;
+    bool streaming = false;
+    size_t idat_size = PNGWriter::kDefaultIDATSize;
+    bool reduce_colors = true;
+    // Downscaled copies written next to the output as <name>-<W>x<H>.png; the source is
+    // loaded once and all sizes are encoded together
+    std::vector<OutputSize> sizes;
+    ResizeFilter resize_filter = ResizeFilter::Box;
+    // Try CompressionSearch::DefaultTrials and keep the smallest; png_filter, level,
+    // strategy and memLevel are then chosen per image
+    bool search = false;
+    // Adam7 writes the seven passes filtered concurrently; not available with streaming
+    PNGInterlace interlace = PNGInterlace::None;
+};
+
+struct EncodeJob {
+    std::string input_path;
+    std::string output_path;
+    uint64_t width = 0;
+    uint64_t height = 0;
+    EncodeOptions options;
+};
+
+class PNGEncoder {
+public:
+    // Parses "in.raw out.png W H [filter [percent]] [--option=value ...]", the same syntax
+    // the png_encoder command line and batch manifests use. Throws std::runtime_error.
+    static EncodeJob ParseJob(const std::vector<std::string>& args);
+
+    // Parses only the "--option=value" arguments; leftover arguments are returned in positional
+    static EncodeOptions ParseOptions(const std::vector<std::string>& args,
+                                      std::vector<std::string>& positional);
+
+    static const char* OptionsHelp();
+
+    // "out/a.png", 320, 180 -> "out/a-320x180.png"
+    static std::string SizedOutputPath(const std::string& path, uint64_t width, uint64_t height);
+
+    // Runs the whole pipeline for one RAW file. When options.threads > 1 the compression
+    // is split across the pool, as are the extra output sizes. An output path of "-"
+    // writes the PNG to stdout.
+    static void EncodeFile(const EncodeJob& job, ThreadPool& pool = ThreadPool::Shared());
+
+    // Same, with buffers and the deflate stream taken from a context reused between calls.
+    // With a cache a job whose input and options were encoded before is served from it,
+    // and a newly encoded output is added to it.
+    static void EncodeFile(const EncodeJob& job, ThreadPool& pool, EncoderContext& context,
+                           EncodeCache* cache = nullptr);
+
+    // Encodes pixels already in memory into sink (MemorySink, BufferSink for a caller
+    // buffer, FileDescriptorSink for a socket). The sink is not closed.
+    static void Encode(const ImageView& image, const EncodeOptions& options, OutputSink& sink,
+                       ThreadPool& pool = ThreadPool::Shared());
+    static void Encode(const ImageView& image, const EncodeOptions& options, OutputSink& sink,
+                       ThreadPool& pool, EncoderContext& context);
+
+    // Returns the PNG file bytes
+    static std::vector<uint8_t> EncodeToMemory(const ImageView& image,
+                                               const EncodeOptions& options = {},
+                                               ThreadPool& pool = ThreadPool::Shared());
+};
@@ -0,0 +1,48 @@
+// encoder_context.h
+#pragma once
+
+#include "deflate.h"
+#include "filter.h"
+#include "png_writer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Everything one encoding thread allocates per image: scanline and row buffers, the deflate
+// stream with its output buffer and the PNG chunk tables. Reusing a context for images of
+// similar size leaves the allocator and deflateInit2 out of the steady state.
+// A context must not be used by two threads at once.
+class EncoderContext {
+public:
+    EncoderContext() = default;
+
+    EncoderContext(const EncoderContext&) = delete;
+    EncoderContext& operator=(const EncoderContext&) = delete;
+
+    PNGFilterBuffers& FilterBuffers();
+    ReusableDeflater& Deflater();
+    PNGWriter& Writer();
+
+    // Pixels of a downscaled variant
+    std::vector<uint8_t>& ResizedPixels();
+
+    // Context of the i-th extra output size, created on first use, so variants encoded
+    // in parallel keep their own buffers from one image to the next
+    EncoderContext& Variant(size_t index);
+
+    // Bytes held between images, variants included
+    size_t RetainedBytes() const;
+
+    // Frees the buffers when they hold more than max_retained_bytes, e.g. after an
+    // unusually large image
+    void Trim(size_t max_retained_bytes);
+
+private:
+    PNGFilterBuffers filter_buffers_;
+    ReusableDeflater deflater_;
+    PNGWriter writer_;
+    std::vector<uint8_t> resized_pixels_;
+    std::vector<std::unique_ptr<EncoderContext>> variants_;
+};
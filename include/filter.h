@@ -1,16 +1,104 @@
 // filter.h
 #pragma once
 
+#include "color_filter.h"
+#include "pixel_format.h"
+#include "pixel_view.h"
+#include "thread_pool.h"
+
+#include <cstddef>
 #include <cstdint>
+#include <string>
 #include <vector>
 
 enum class PNGFilterType { None = 0, Sub = 1, Up = 2, Average = 3, Paeth = 4 };
 
+// Fixed strategies apply the same filter to every row, MinSum and Entropy try all five
+// filters per scanline and keep the one with the lowest estimated cost.
+enum class PNGFilterStrategy { None, Sub, Up, Average, Paeth, MinSum, Entropy };
+
+// Rows [begin, end) of an image
+struct RowRange {
+    uint64_t begin = 0;
+    uint64_t end = 0;
+};
+
+// Output and per-band row buffers of PNGFilter::Apply. Passing the same object to
+// consecutive calls reuses the memory instead of reallocating it.
+struct PNGFilterBuffers {
+    struct Band {
+        std::vector<uint8_t> scratch;
+        std::vector<uint8_t> colored_row;
+        std::vector<uint8_t> current_row;
+        std::vector<uint8_t> previous_row;
+    };
+
+    std::vector<uint8_t> scanlines;
+    std::vector<Band> bands;
+
+    size_t Capacity() const;
+};
+
 class PNGFilter {
 public:
-    static std::vector<uint8_t> Apply(const std::vector<uint8_t>& rgb_data, uint64_t width,
-                                      uint64_t height);
+    static constexpr size_t kFilterTypeCount = 5;
+
+    // Smallest band handed to one worker by the parallel Apply
+    static constexpr uint64_t kMinBandRows = 16;
+
+    static std::vector<uint8_t> Apply(PixelView rgb_data, uint64_t width, uint64_t height,
+                                      PNGFilterStrategy strategy = PNGFilterStrategy::Paeth);
+
+    // Color filter and PNG filter in one pass: each row is color filtered into a small
+    // buffer while it is still in cache and filtered against the previous transformed row
+    // straight into the scanlines. The result equals Apply over ColorFilter::Apply.
+    // Rows are packed into format (see ColorReducer) before filtering; an Adam7 format
+    // yields the scanlines of the seven passes one after another.
+    // With a pool the image is split into row bands filtered concurrently; the output
+    // is identical to the serial one.
+    static std::vector<uint8_t> Apply(PixelView rgb_data, uint64_t width, uint64_t height,
+                                      PNGFilterStrategy strategy, ColorFilterType color_filter,
+                                      float perlin_noise_scale = -1.0f,
+                                      const PixelFormat& format = {}, ThreadPool* pool = nullptr);
+
+    // Same for rows at any stride, filling buffers.scanlines
+    static void Apply(const ImageView& image, PNGFilterStrategy strategy,
+                      ColorFilterType color_filter, float perlin_noise_scale,
+                      const PixelFormat& format, ThreadPool* pool, PNGFilterBuffers& buffers);
+
+    // Filters only the rows of ranges into buffers.scanlines, which already holds the
+    // scanlines of an image of the same size and format; other rows are left as they are.
+    // Ranges are filtered concurrently on the pool. Interlaced formats are not supported.
+    static void ApplyRows(const ImageView& image, PNGFilterStrategy strategy,
+                          ColorFilterType color_filter, float perlin_noise_scale,
+                          const PixelFormat& format, const std::vector<RowRange>& ranges,
+                          ThreadPool* pool, PNGFilterBuffers& buffers);
+
+    // Writes the filter type byte followed by row_bytes filtered bytes into out.
+    // prev_row == nullptr means the row is the first one of the image.
+    static void FilterRow(const uint8_t* row, const uint8_t* prev_row, size_t row_bytes,
+                          size_t bpp, PNGFilterType type, uint8_t* out);
+
+    // Same as FilterRow, but picks the filter type according to the strategy.
+    // scratch is resized on demand and may be reused between calls.
+    static PNGFilterType FilterRow(const uint8_t* row, const uint8_t* prev_row, size_t row_bytes,
+                                   size_t bpp, PNGFilterStrategy strategy, uint8_t* out,
+                                   std::vector<uint8_t>& scratch);
+
+    static PNGFilterStrategy Parse(const std::string& strategy_name);
 
 private:
+    static void FilterRanges(const ImageView& image, PNGFilterStrategy strategy,
+                             ColorFilterType color_filter, float perlin_noise_scale,
+                             const PixelFormat& format, const std::vector<RowRange>& ranges,
+                             ThreadPool* pool, PNGFilterBuffers& buffers);
+    static void FilterInterlaced(const ImageView& image, PNGFilterStrategy strategy,
+                                 ColorFilterType color_filter, float perlin_noise_scale,
+                                 const PixelFormat& format, ThreadPool* pool,
+                                 PNGFilterBuffers& buffers);
+
     static uint8_t PaethPredictor(uint8_t a, uint8_t b, uint8_t c);
-};
\ No newline at end of file
+
+    static uint64_t SumOfAbsoluteDifferences(const uint8_t* filtered, size_t size);
+    static double EstimateEntropy(const uint8_t* filtered, size_t size);
+};
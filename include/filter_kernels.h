@@ -0,0 +1,26 @@
+// filter_kernels.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+enum class SIMDLevel { Scalar, SSE41, AVX2 };
+
+// Filters row_bytes bytes of row against prev_row into out (without the filter type byte).
+// prev_row must point to a full row; bpp is the distance to the left neighbour in bytes.
+using FilterRowKernel = void (*)(const uint8_t* row, const uint8_t* prev_row, size_t row_bytes,
+                                 size_t bpp, uint8_t* out);
+
+struct PNGFilterKernels {
+    FilterRowKernel sub;
+    FilterRowKernel up;
+    FilterRowKernel average;
+    FilterRowKernel paeth;
+
+    // Kernels for the best instruction set of the running CPU, detected once
+    static const PNGFilterKernels& Get();
+
+    static const PNGFilterKernels& ForLevel(SIMDLevel level);
+    static bool IsSupported(SIMDLevel level);
+    static SIMDLevel DetectLevel();
+};
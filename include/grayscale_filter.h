@@ -1,8 +1,17 @@
 // grayscale_filter.h
 #pragma once
+#include "filter_kernels.h"
+
 #include <vector>
+#include <cstddef>
 #include <cstdint>
 
+// Y = 0.299 R + 0.587 G + 0.114 B in 16-bit fixed point, rounded down. The weights sum to
+// exactly 1, so gray pixels stay unchanged; against the same formula in float the result
+// differs by at most 1 for about 0.05% of colors.
 struct GrayscaleFilter {
     static void Apply(std::vector<uint8_t>& rgb_data);
-};
\ No newline at end of file
+    static void Apply(uint8_t* rgb_data, size_t size);
+    // Same bytes for every level; throws if the CPU lacks the instruction set
+    static void Apply(uint8_t* rgb_data, size_t size, SIMDLevel level);
+};
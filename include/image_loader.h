@@ -1,7 +1,11 @@
 // image_loader.h
 #pragma once
 
+#include "pixel_view.h"
+
+#include <cstddef>
 #include <cstdint>
+#include <fstream>
 #include <string>
 #include <vector>
 
@@ -12,7 +16,59 @@ struct RawImage {
     std::vector<uint8_t> data;
 };
 
+// RAW file mapped read-only into memory. Pages are read on first access,
+// so loading costs neither a zero fill nor a copy.
+class MappedRawImage {
+public:
+    MappedRawImage(const std::string& path, uint64_t width, uint64_t height);
+    ~MappedRawImage();
+
+    MappedRawImage(const MappedRawImage&) = delete;
+    MappedRawImage& operator=(const MappedRawImage&) = delete;
+
+    PixelView View() const;
+    uint64_t Width() const;
+    uint64_t Height() const;
+
+private:
+    uint64_t width_;
+    uint64_t height_;
+    const uint8_t* data_;
+    size_t size_;
+
+    void* mapping_;
+    size_t mapping_size_;
+
+    // Used where mmap is not available
+    std::vector<uint8_t> fallback_;
+};
+
 class ImageLoader {
 public:
     static RawImage LoadRawImage(const std::string &path, uint64_t width, uint64_t height);
-};
\ No newline at end of file
+
+    // Wraps RGB pixels already in memory, rows stride bytes apart (0 means width * 3).
+    // Nothing is copied; the pixels must outlive the view.
+    static ImageView FromMemory(const uint8_t* pixels, uint64_t width, uint64_t height,
+                                size_t stride = 0);
+};
+
+// Sequential reader that hands out a RAW file a few rows at a time
+class RawImageReader {
+public:
+    RawImageReader(const std::string& path, uint64_t width, uint64_t height);
+
+    // Reads the next row_count rows (at most the remaining ones) into dst,
+    // returns the number of rows read
+    uint64_t ReadRows(uint8_t* dst, uint64_t row_count);
+
+    uint64_t Width() const;
+    uint64_t Height() const;
+    uint64_t RowsRead() const;
+
+private:
+    std::ifstream file_;
+    uint64_t width_;
+    uint64_t height_;
+    uint64_t rows_read_;
+};
@@ -0,0 +1,46 @@
+// image_resizer.h
+#pragma once
+
+#include "filter_kernels.h"
+#include "pixel_view.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Box averages every source pixel an output pixel covers (exact for 1/2, 1/4, ...),
+// bilinear interpolates the four nearest source pixels
+enum class ResizeFilter { Box, Bilinear };
+
+// One extra output size: either 1/divisor of each side or a fixed width with the
+// height following the aspect ratio
+struct OutputSize {
+    uint64_t divisor = 0;
+    uint64_t width = 0;
+
+    // "1/2", "1/4" or "320w"; throws std::runtime_error
+    static OutputSize Parse(const std::string& size_name);
+    // Comma separated list of sizes, e.g. "1/2,1/4,320w"
+    static std::vector<OutputSize> ParseList(const std::string& size_list);
+
+    // Size of the variant of a source_width x source_height image, never below 1 x 1
+    void Dimensions(uint64_t source_width, uint64_t source_height, uint64_t& out_width,
+                    uint64_t& out_height) const;
+};
+
+class ImageResizer {
+public:
+    static ResizeFilter ParseFilter(const std::string& filter_name);
+
+    // Resamples the RGB image to width x height into out (resized to width * height * 3).
+    // Rows are combined vertically with SIMD kernels for the best instruction set of the
+    // CPU; every level gives the same bytes.
+    static void Resize(const ImageView& image, uint64_t width, uint64_t height,
+                       ResizeFilter filter, std::vector<uint8_t>& out);
+    static void Resize(const ImageView& image, uint64_t width, uint64_t height,
+                       ResizeFilter filter, std::vector<uint8_t>& out, SIMDLevel level);
+
+    static std::vector<uint8_t> Resize(const ImageView& image, uint64_t width, uint64_t height,
+                                       ResizeFilter filter = ResizeFilter::Box);
+};
@@ -0,0 +1,81 @@
+// incremental_encoder.h
+#pragma once
+
+#include "encoder.h"
+#include "filter.h"
+#include "output_sink.h"
+#include "parallel_deflate.h"
+#include "pixel_format.h"
+#include "pixel_view.h"
+#include "png_writer.h"
+#include "thread_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Work done for one frame, or summed over frames
+struct IncrementalStats {
+    uint64_t frames = 0;
+    uint64_t rows = 0;
+    // Rows whose pixels differ from the previous frame
+    uint64_t rows_changed = 0;
+    // Changed rows and the rows below them, whose prediction reads the changed row
+    uint64_t rows_filtered = 0;
+    uint64_t blocks = 0;
+    uint64_t blocks_compressed = 0;
+
+    IncrementalStats& operator+=(const IncrementalStats& other);
+};
+
+// Encodes a sequence of frames of one size, redoing only what changed since the previous
+// frame. Every row is hashed: a filtered row is kept while neither it nor the row above
+// changed. The zlib stream is cut into row-aligned blocks as ParallelDeflateCompressor
+// does, and a block is kept while none of its filtered rows nor the window before it
+// changed. Output is byte for byte the PNG of a full encode with the same block layout
+// and pixel format. The format of the previous frame is kept while the changed rows fit
+// in it, so colors that disappear stay in the palette; a color outside it analyzes the
+// whole frame again. A new size or pixel format starts over with a full encode.
+class IncrementalEncoder {
+public:
+    // options.compression must use the zlib backend and the frames must not be interlaced;
+    // streaming, sizes and search are ignored
+    explicit IncrementalEncoder(const EncodeOptions& options,
+                                size_t block_size = ParallelDeflateCompressor::kDefaultBlockSize);
+
+    // Writes the PNG of frame into sink; rows, bands and blocks are spread over pool
+    // when it is not nullptr
+    void Encode(const ImageView& frame, OutputSink& sink, ThreadPool* pool = nullptr);
+
+    // Work of the last Encode
+    const IncrementalStats& LastStats() const;
+
+    // The zlib stream of the last frame
+    PixelView Compressed() const;
+
+    // Forgets the previous frame, the next one is encoded in full
+    void Reset();
+
+private:
+    void HashRows(const ImageView& frame, ThreadPool* pool);
+    void FilterRows(const ImageView& frame, bool full, ThreadPool* pool);
+    void CompressBlocks(bool full, ThreadPool* pool);
+
+    EncodeOptions options_;
+    size_t block_size_;
+
+    bool has_previous_ = false;
+    uint64_t width_ = 0;
+    uint64_t height_ = 0;
+    PixelFormat format_;
+
+    std::vector<uint64_t> row_hashes_;
+    std::vector<uint64_t> new_hashes_;
+    std::vector<uint8_t> changed_;
+    std::vector<uint8_t> refiltered_;
+    PNGFilterBuffers filter_buffers_;
+    std::vector<ParallelDeflateCompressor::Block> blocks_;
+    std::vector<uint8_t> compressed_;
+    PNGWriter writer_;
+    IncrementalStats stats_;
+};
@@ -0,0 +1,42 @@
+// interlace.h
+#pragma once
+
+#include "pixel_format.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Adam7 stores an image as seven reduced images. Pass p holds the pixels
+// (x0 + i * dx, y0 + j * dy); its scanlines are filtered as an image of their own,
+// the first row of a pass with no row above it. Passes without pixels are omitted.
+class Adam7 {
+public:
+    struct Pass {
+        uint8_t x0;
+        uint8_t y0;
+        uint8_t dx;
+        uint8_t dy;
+    };
+
+    static constexpr size_t kPassCount = 7;
+    static constexpr std::array<Pass, kPassCount> kPasses = {{{0, 0, 8, 8},
+                                                             {4, 0, 8, 8},
+                                                             {0, 4, 4, 8},
+                                                             {2, 0, 4, 4},
+                                                             {0, 2, 2, 4},
+                                                             {1, 0, 2, 2},
+                                                             {0, 1, 1, 2}}};
+
+    static uint64_t PassWidth(size_t pass, uint64_t width);
+    static uint64_t PassHeight(size_t pass, uint64_t height);
+
+    // Offset of the first scanline of every pass in the interlaced stream, followed by
+    // the total size; filter type bytes included
+    static std::array<size_t, kPassCount + 1> PassOffsets(uint64_t width, uint64_t height,
+                                                          const PixelFormat& format);
+
+    // Copies the RGB pixels of pass from a full image row into out, PassWidth(pass, width)
+    // pixels. out may be row itself: pixels only move towards the start.
+    static void ExtractRow(const uint8_t* row, uint64_t width, size_t pass, uint8_t* out);
+};
@@ -1,8 +1,14 @@
 // negative_filter.h
 #pragma once
+#include "filter_kernels.h"
+
 #include <vector>
+#include <cstddef>
 #include <cstdint>
 
 struct NegativeFilter {
     static void Apply(std::vector<uint8_t>& rgb_data);
-};
\ No newline at end of file
+    static void Apply(uint8_t* rgb_data, size_t size);
+    // Same bytes for every level; throws if the CPU lacks the instruction set
+    static void Apply(uint8_t* rgb_data, size_t size, SIMDLevel level);
+};
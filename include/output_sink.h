@@ -0,0 +1,81 @@
+// output_sink.h
+#pragma once
+
+#include "pixel_view.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Destination of encoded bytes. Write receives a list of pieces so that chunk headers,
+// payloads and CRCs reach the destination without being copied into one buffer.
+class OutputSink {
+public:
+    virtual ~OutputSink() = default;
+
+    virtual void Write(const PixelView* pieces, size_t count) = 0;
+
+    void Write(PixelView data) {
+        Write(&data, 1);
+    }
+
+    // Releases the destination; errors reported late by the system surface here
+    virtual void Close() {
+    }
+};
+
+// Writes to a descriptor opened by the caller (file, pipe, socket) with writev,
+// as few system calls as the pieces allow. The descriptor is not closed.
+class FileDescriptorSink : public OutputSink {
+public:
+    explicit FileDescriptorSink(int fd);
+
+    void Write(const PixelView* pieces, size_t count) override;
+    using OutputSink::Write;
+
+protected:
+    int fd_;
+};
+
+// Creates or truncates a file and owns its descriptor. An existing file with other hard
+// links is replaced instead of truncated, so the links keep their contents.
+class FileSink : public FileDescriptorSink {
+public:
+    explicit FileSink(const std::string& path);
+    ~FileSink() override;
+
+    FileSink(const FileSink&) = delete;
+    FileSink& operator=(const FileSink&) = delete;
+
+    void Close() override;
+};
+
+// Writes into a fixed buffer owned by the caller; throws when the PNG does not fit
+class BufferSink : public OutputSink {
+public:
+    BufferSink(uint8_t* buffer, size_t capacity);
+
+    void Write(const PixelView* pieces, size_t count) override;
+    using OutputSink::Write;
+
+    size_t Size() const;
+
+private:
+    uint8_t* buffer_;
+    size_t capacity_;
+    size_t size_;
+};
+
+// Appends everything to a growable in-memory buffer
+class MemorySink : public OutputSink {
+public:
+    void Write(const PixelView* pieces, size_t count) override;
+    using OutputSink::Write;
+
+    const std::vector<uint8_t>& Data() const;
+    std::vector<uint8_t> TakeData();
+
+private:
+    std::vector<uint8_t> data_;
+};
@@ -0,0 +1,41 @@
+// parallel_deflate.h
+#pragma once
+
+#include "deflate.h"
+#include "thread_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// pigz-style compressor: the input is cut into row-aligned blocks that are deflated
+// concurrently, each primed with the preceding window of input as a dictionary.
+// Blocks end with a sync flush, so their raw deflate output can be concatenated
+// into one zlib stream whose Adler-32 is combined from the per-block checksums.
+class ParallelDeflateCompressor {
+public:
+    static constexpr size_t kDefaultBlockSize = 128 * 1024;
+
+    // Raw deflate data of input bytes [begin, end) and their Adler-32. The output depends
+    // only on those bytes, the window before begin, last and the profile, so a block whose
+    // bytes and window did not change can be kept (IncrementalEncoder does).
+    struct Block {
+        std::vector<uint8_t> deflated;
+        uint32_t adler = 1;
+        size_t input_size = 0;
+    };
+
+    static std::vector<uint8_t> Compress(PixelView data, size_t row_size,
+                                         ThreadPool& pool = ThreadPool::Shared(),
+                                         const CompressionProfile& profile = {},
+                                         size_t block_size = kDefaultBlockSize);
+
+    // Compresses one block into block, reusing its buffer; the last block ends the stream,
+    // the others end with a sync flush
+    static void CompressBlock(const uint8_t* data, size_t begin, size_t end, bool last,
+                              const CompressionProfile& profile, Block& block);
+
+    // zlib header, the blocks in order and the combined Adler-32, written into out
+    static void Join(const std::vector<Block>& blocks, const CompressionProfile& profile,
+                     std::vector<uint8_t>& out);
+};
@@ -1,9 +1,21 @@
 // perlin_noise_filter.h
 #pragma once
+#include "filter_kernels.h"
+
 #include <vector>
 #include <cstdint>
 
 struct PerlinNoiseFilter {
     static void Apply(std::vector<uint8_t>& rgb_data, uint64_t width, uint64_t height,
                       float percent = 0.f);
-};
\ No newline at end of file
+
+    // Applies the noise to row_count rows starting at image row first_row
+    static void ApplyRows(uint8_t* rgb_rows, uint64_t width, uint64_t first_row,
+                          uint64_t row_count, float percent = 0.f);
+
+    // AVX2 evaluates the noise of 8 pixels at once with the same float operations in the
+    // same order as the scalar code (no FMA), so every level gives the same bytes. SSE4.1
+    // has no gathers for the permutation table and runs the scalar code.
+    static void ApplyRows(uint8_t* rgb_rows, uint64_t width, uint64_t first_row,
+                          uint64_t row_count, float percent, SIMDLevel level);
+};
@@ -0,0 +1,43 @@
+// pixel_format.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// PNG color types the encoder can emit (IHDR color type field)
+enum class PNGColorType : uint8_t { Grayscale = 0, Truecolor = 2, Indexed = 3 };
+
+// IHDR interlace method: rows in order, or the seven Adam7 passes (see interlace.h)
+enum class PNGInterlace : uint8_t { None = 0, Adam7 = 1 };
+
+// Layout of the pixels as stored in the PNG: color type, bits per sample, for indexed
+// images the RGB palette, and the order of the scanlines. The default is 8-bit RGB rows.
+struct PixelFormat {
+    PNGColorType color_type = PNGColorType::Truecolor;
+    uint8_t bit_depth = 8;
+    std::vector<uint8_t> palette;  // RGB triples, indexed images only
+    PNGInterlace interlace = PNGInterlace::None;
+
+    size_t Channels() const {
+        return color_type == PNGColorType::Truecolor ? 3 : 1;
+    }
+
+    // Packed bytes per row, without the filter type byte; for Adam7 the row of the full
+    // image, pass rows are narrower
+    size_t RowBytes(uint64_t width) const {
+        return (width * Channels() * bit_depth + 7) / 8;
+    }
+
+    // Distance to the corresponding byte of the previous pixel, at least 1 for packed samples
+    size_t FilterBpp() const {
+        size_t bits = Channels() * bit_depth;
+        return bits < 8 ? 1 : bits / 8;
+    }
+
+    bool IsRGB8() const {
+        return color_type == PNGColorType::Truecolor && bit_depth == 8;
+    }
+
+    bool operator==(const PixelFormat&) const = default;
+};
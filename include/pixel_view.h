@@ -0,0 +1,41 @@
+// pixel_view.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+
+// Read-only view of interleaved pixel bytes; std::vector<uint8_t> converts to it implicitly
+using PixelView = std::span<const uint8_t>;
+
+// Read-only RGB image in memory whose rows start stride bytes apart (stride >= width * 3),
+// e.g. a crop of a larger frame or a buffer with padded rows
+struct ImageView {
+    const uint8_t* data = nullptr;
+    uint64_t width = 0;
+    uint64_t height = 0;
+    size_t stride = 0;
+
+    ImageView() = default;
+
+    ImageView(const uint8_t* pixels, uint64_t image_width, uint64_t image_height,
+              size_t row_stride = 0)
+        : data(pixels),
+          width(image_width),
+          height(image_height),
+          stride(row_stride != 0 ? row_stride : image_width * 3) {
+    }
+
+    // Tightly packed rows, the layout of a RAW file; pixels must hold all of them
+    ImageView(PixelView pixels, uint64_t image_width, uint64_t image_height)
+        : ImageView(pixels.data(), image_width, image_height) {
+        if (image_width != 0 && pixels.size() / 3 / image_width < image_height) {
+            throw std::runtime_error("Pixel buffer is shorter than HxWx3 bytes!");
+        }
+    }
+
+    const uint8_t* Row(uint64_t y) const {
+        return data + y * stride;
+    }
+};
@@ -0,0 +1,79 @@
+// png_stream_encoder.h
+#pragma once
+
+#include "color_filter.h"
+#include "deflate.h"
+#include "filter.h"
+#include "output_sink.h"
+#include "png_writer.h"
+
+#include <zlib.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Encodes an image row by row: every batch of rows is color filtered, PNG filtered against
+// the previous row and fed to deflate, and IDAT chunks are written as soon as they fill up.
+// Memory use depends on the image width only.
+class PNGStreamEncoder {
+public:
+    static constexpr size_t kDefaultIDATSize = 64 * 1024;
+
+    explicit PNGStreamEncoder(PNGFilterStrategy png_filter = PNGFilterStrategy::MinSum,
+                              const CompressionProfile& compression = {},
+                              size_t idat_size = kDefaultIDATSize);
+    ~PNGStreamEncoder();
+
+    PNGStreamEncoder(const PNGStreamEncoder&) = delete;
+    PNGStreamEncoder& operator=(const PNGStreamEncoder&) = delete;
+
+    void BeginImage(const std::string& filename, uint64_t width, uint64_t height,
+                    ColorFilterType color_filter = ColorFilterType::None,
+                    float perlin_noise_scale = -1.0f);
+
+    // Writes to a sink owned by the caller, which must outlive Finish
+    void BeginImage(OutputSink& sink, uint64_t width, uint64_t height,
+                    ColorFilterType color_filter = ColorFilterType::None,
+                    float perlin_noise_scale = -1.0f);
+
+    // rgb_rows holds row_count rows of width * 3 bytes each
+    void WriteRows(const uint8_t* rgb_rows, uint64_t row_count);
+
+    void Finish();
+
+    // Reads a RAW file and encodes it without ever holding the whole image in memory
+    static void EncodeFile(const std::string& input_path, OutputSink& sink, uint64_t width,
+                           uint64_t height, ColorFilterType color_filter,
+                           float perlin_noise_scale, PNGFilterStrategy png_filter,
+                           const CompressionProfile& compression = {},
+                           size_t idat_size = kDefaultIDATSize);
+
+private:
+    void Deflate(const uint8_t* data, size_t size, int flush);
+    void WriteIDAT(size_t size);
+    void Reset();
+
+    PNGFilterStrategy png_filter_;
+    CompressionProfile compression_;
+    size_t idat_size_;
+
+    PNGWriter writer_;
+    std::unique_ptr<FileSink> file_;
+    OutputSink* sink_;
+    z_stream stream_;
+    bool stream_initialized_;
+
+    uint64_t width_;
+    uint64_t height_;
+    uint64_t rows_written_;
+    ColorFilterType color_filter_;
+    float perlin_noise_scale_;
+
+    std::vector<uint8_t> current_row_;
+    std::vector<uint8_t> previous_row_;
+    std::vector<uint8_t> filtered_line_;
+    std::vector<uint8_t> filter_scratch_;
+    std::vector<uint8_t> idat_buffer_;
+};
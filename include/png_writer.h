@@ -1,30 +1,70 @@
 // png_writer.h
 #pragma once
 
+#include "output_sink.h"
+#include "pixel_format.h"
+#include "pixel_view.h"
+
+#include <array>
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 #include <string>
 
 class PNGWriter {
 public:
-    PNGWriter();
+    static constexpr size_t kDefaultIDATSize = 1 << 20;
+    // PNG limits chunk lengths to 2^31 - 1 bytes
+    static constexpr size_t kMaxChunkSize = 0x7FFFFFFF;
+
+    // The compressed stream is split into IDAT chunks of at most max_idat_size bytes
+    explicit PNGWriter(size_t max_idat_size = kDefaultIDATSize);
+
     void WritePNG(const std::string& filename, uint64_t width, uint64_t height,
-                  const std::vector<uint8_t>& compressed_data);
+                  PixelView compressed_data, const PixelFormat& format = {});
+
+    // Hands the whole file to the sink in one Write call: signature, IHDR, PLTE for
+    // indexed formats, every IDAT header/payload/CRC and IEND as separate pieces
+    void WritePNG(OutputSink& sink, uint64_t width, uint64_t height, PixelView compressed_data,
+                  const PixelFormat& format = {});
+
+    // Building blocks for writers that produce the file piece by piece:
+    // signature + IHDR (+ PLTE), any number of IDAT chunks, then IEND
+    void WriteHeader(OutputSink& sink, uint64_t width, uint64_t height,
+                     const PixelFormat& format = {}) const;
+    void WriteIDAT(OutputSink& sink, PixelView data) const;
+    void WriteEnd(OutputSink& sink) const;
+
+    size_t MaxIDATSize() const;
+    void SetMaxIDATSize(size_t max_idat_size);
 
 private:
     static constexpr char kIHDRChunkType[5] = "IHDR";
+    static constexpr char kPLTEChunkType[5] = "PLTE";
     static constexpr char kIDATChunkType[5] = "IDAT";
     static constexpr char kIENDChunkType[5] = "IEND";
 
     static constexpr uint8_t kPNGSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
 
+    // Length + type and CRC of one chunk; the payload stays where it is
+    struct ChunkFrame {
+        uint8_t header[8];
+        uint8_t crc[4];
+    };
+
 private:
-    void InitializeCRCTable();
-    uint32_t CalculateCRC(const uint8_t* buffer, size_t length) const;
-    void WriteUInt32(std::ofstream& out, uint32_t value) const;
-    void WriteChunk(std::ofstream& out, const std::string& type,
-                    const std::vector<uint8_t>& data) const;
-
-    uint32_t crc_table_[256];
-    bool crc_table_computed_;
-};
\ No newline at end of file
+    static void PutUInt32(uint8_t* out, uint32_t value);
+    static std::array<uint8_t, 13> MakeIHDR(uint64_t width, uint64_t height,
+                                            const PixelFormat& format);
+    static void FrameChunk(const char* type, PixelView data, ChunkFrame& frame);
+    static void AppendChunk(const ChunkFrame& frame, PixelView data,
+                            std::vector<PixelView>& pieces);
+
+    size_t CountIDATChunks(size_t size) const;
+
+    size_t max_idat_size_;
+
+    // Reused by WritePNG so that writing many files does not reallocate them
+    std::vector<ChunkFrame> frames_;
+    std::vector<PixelView> pieces_;
+};
@@ -0,0 +1,70 @@
+// sequence_encoder.h
+#pragma once
+
+#include "bounded_queue.h"
+#include "encoder.h"
+#include "incremental_encoder.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct SequenceOptions {
+    // Frames each queue between two stages holds
+    size_t queue_depth = 4;
+    // Worker threads of the filter and compress stages, 0 splits job.options.threads
+    // between them (one third filtering, the rest compressing)
+    size_t filter_threads = 0;
+    size_t compress_threads = 0;
+    // Encodes the input this many times, output frame numbers keep counting
+    uint64_t repeat = 1;
+    // Encodes every frame against the previous one with IncrementalEncoder, redoing only
+    // changed rows and blocks; frames then go through one encode stage in order, each
+    // spread over job.options.threads
+    bool incremental = false;
+};
+
+struct StageStats {
+    std::string name;
+    size_t threads = 0;
+    uint64_t frames = 0;
+    // Time spent on frames, summed over the stage threads
+    double busy_seconds = 0.0;
+};
+
+struct SequenceQueueStats {
+    // Stage on the consuming side
+    std::string name;
+    size_t capacity = 0;
+    QueueStats stats;
+};
+
+struct SequenceReport {
+    uint64_t frames = 0;
+    double wall_seconds = 0.0;
+    uint64_t input_bytes = 0;
+    uint64_t output_bytes = 0;
+    std::vector<StageStats> stages;
+    std::vector<SequenceQueueStats> queues;
+    // Summed over frames, incremental runs only
+    IncrementalStats incremental;
+
+    double FramesPerSecond() const;
+};
+
+// Encodes a RAW frame sequence with load, filter, compress and write running as separate
+// stages connected by bounded lock-free queues: while frame N is compressed, frame N+1 is
+// filtered and frame N-1 written. Frame buffers, filter buffers and deflate streams are
+// recycled through a free list, so the steady state does not allocate.
+class SequenceEncoder {
+public:
+    // job.input_path holds the frames back to back, width * height * 3 bytes each.
+    // job.output_path is a pattern with one %d or %0<N>d replaced by the frame number.
+    // The first error of any stage stops the pipeline and is rethrown.
+    static SequenceReport EncodeFile(const EncodeJob& job, const SequenceOptions& options = {});
+
+    // "out/frame-%05d.png", 7 -> "out/frame-00007.png"; throws std::runtime_error if the
+    // pattern has no frame number conversion
+    static std::string FramePath(const std::string& pattern, uint64_t index);
+};
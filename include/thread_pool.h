@@ -0,0 +1,69 @@
+// thread_pool.h
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed set of worker threads, created once and reused for every task.
+// Every worker owns a deque: tasks submitted from a worker go to its own deque (LIFO),
+// idle workers steal the oldest tasks from the others.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t thread_count = DefaultThreadCount());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    template <typename Task>
+    auto Submit(Task&& task) -> std::future<std::invoke_result_t<std::decay_t<Task>>> {
+        using Result = std::invoke_result_t<std::decay_t<Task>>;
+
+        auto packaged =
+            std::make_shared<std::packaged_task<Result()>>(std::forward<Task>(task));
+        std::future<Result> result = packaged->get_future();
+
+        Enqueue([packaged]() { (*packaged)(); });
+        return result;
+    }
+
+    // Calls body(i) for every i in [0, count) and returns when all calls are done.
+    // The calling thread takes part in the work, so nested calls from a worker cannot deadlock.
+    // The first exception thrown by body is rethrown in the caller.
+    void ParallelFor(size_t count, const std::function<void(size_t)>& body);
+
+    size_t Size() const;
+
+    static size_t DefaultThreadCount();
+
+    // Process-wide pool with DefaultThreadCount() workers, created on first use
+    static ThreadPool& Shared();
+
+private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void Enqueue(std::function<void()> task);
+    bool TryPop(size_t worker_index, std::function<void()>& task);
+    void WorkerLoop(size_t worker_index);
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<size_t> pending_;
+    std::atomic<size_t> next_queue_;
+
+    std::mutex sleep_mutex_;
+    std::condition_variable task_available_;
+    bool stopping_;
+};
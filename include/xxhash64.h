@@ -0,0 +1,26 @@
+// xxhash64.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// XXH64 (xxHash, 64-bit): four independent accumulators over 32-byte stripes, so the
+// multiplies of consecutive words overlap in the pipeline. Not cryptographic; used to
+// name cache entries. Data can be fed in any number of pieces.
+class XXHash64 {
+public:
+    explicit XXHash64(uint64_t seed = 0);
+
+    void Update(const uint8_t* data, size_t size);
+    uint64_t Digest() const;
+    void Reset(uint64_t seed = 0);
+
+    static uint64_t Compute(const uint8_t* data, size_t size, uint64_t seed = 0);
+
+private:
+    uint64_t accumulators_[4];
+    uint64_t seed_;
+    uint64_t total_size_;
+    uint8_t buffer_[32];
+    size_t buffered_;
+};
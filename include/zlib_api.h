@@ -0,0 +1,42 @@
+// zlib_api.h
+#pragma once
+
+#include "zlib_stream.h"
+
+#include <zlib.h>
+#include <cstddef>
+
+// The system zlib for ZlibStream
+struct ZlibApi {
+    using Stream = z_stream;
+
+    static constexpr const char* kName = "zlib";
+    static constexpr int kOk = Z_OK;
+    static constexpr int kStreamEnd = Z_STREAM_END;
+    static constexpr int kNoFlush = Z_NO_FLUSH;
+    static constexpr int kFinish = Z_FINISH;
+
+    static int Init(Stream* stream, int level, int window_bits, int mem_level, int strategy) {
+        return deflateInit2(stream, level, Z_DEFLATED, window_bits, mem_level, strategy);
+    }
+
+    static int Reset(Stream* stream) {
+        return deflateReset(stream);
+    }
+
+    static int Params(Stream* stream, int level, int strategy) {
+        return deflateParams(stream, level, strategy);
+    }
+
+    static size_t Bound(Stream* stream, size_t size) {
+        return deflateBound(stream, size);
+    }
+
+    static int Deflate(Stream* stream, int flush) {
+        return deflate(stream, flush);
+    }
+
+    static void End(Stream* stream) {
+        deflateEnd(stream);
+    }
+};
@@ -0,0 +1,162 @@
+// zlib_stream.h
+#pragma once
+
+#include "deflate_backend.h"
+#include "pixel_view.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+// One deflate stream of a zlib-style library, the library given by Api: a struct with
+// its stream type, name, return and flush constants and the deflate calls (see ZlibApi
+// in zlib_api.h).
+template <typename Api>
+class ZlibStream {
+public:
+    using Stream = typename Api::Stream;
+
+    ZlibStream() : stream_{}, initialized_(false) {
+    }
+
+    ~ZlibStream() {
+        End();
+    }
+
+    ZlibStream(const ZlibStream&) = delete;
+    ZlibStream& operator=(const ZlibStream&) = delete;
+
+    // Starts a new zlib stream. The same window and memLevel cost a deflateReset, plus a
+    // deflateParams when level or strategy changed, instead of deflateEnd/deflateInit2.
+    void Reset(const CompressionProfile& profile) {
+        if (initialized_ && profile.window_bits == profile_.window_bits &&
+            profile.mem_level == profile_.mem_level) {
+            const bool same_params =
+                profile.level == profile_.level && profile.strategy == profile_.strategy;
+
+            const bool reset = !needs_reset_ || Api::Reset(&stream_) == Api::kOk;
+
+            // Level and strategy change on a reset stream before any input. zlib before
+            // 1.2.12 flushes from deflateParams when the previous stream set high_water,
+            // which deflateReset keeps; with no output buffer that flush fails, and the
+            // stream is rebuilt, instead of writing into the previous caller's buffer.
+            stream_.next_out = nullptr;
+            stream_.avail_out = 0;
+
+            if (reset && (same_params || Api::Params(&stream_, profile.level,
+                                                     profile.ZlibStrategy()) == Api::kOk)) {
+                needs_reset_ = false;
+                profile_ = profile;
+                return;
+            }
+        }
+
+        End();
+
+        stream_ = Stream{};
+        if (Api::Init(&stream_, profile.level, profile.window_bits, profile.mem_level,
+                      profile.ZlibStrategy()) != Api::kOk) {
+            throw std::runtime_error(std::string("Failed to initialize ") + Api::kName +
+                                     " stream");
+        }
+        initialized_ = true;
+        needs_reset_ = false;
+        profile_ = profile;
+    }
+
+    // Upper bound of the stream size for size input bytes; Reset must come first
+    size_t Bound(size_t size) {
+        return Api::Bound(&stream_, size);
+    }
+
+    // Deflates data into out, feeding at most chunk_size input bytes per deflate call.
+    // After each call stop(bytes written so far) may abandon the stream: returns false,
+    // otherwise the whole stream, Written() bytes, is in out.
+    template <typename Stop>
+    bool Deflate(PixelView data, uint8_t* out, size_t capacity, size_t chunk_size, Stop stop) {
+        // avail_in / avail_out are 32-bit, so huge buffers are fed in pieces like compress2 does
+        const size_t max_chunk = std::numeric_limits<decltype(stream_.avail_in)>::max();
+        const size_t in_chunk = std::min(std::max<size_t>(chunk_size, 1), max_chunk);
+        size_t in_left = data.size();
+        size_t out_left = capacity;
+
+        stream_.next_in = const_cast<decltype(stream_.next_in)>(data.data());
+        stream_.next_out = out;
+        stream_.avail_in = 0;
+        stream_.avail_out = 0;
+        written_ = 0;
+
+        // The next Reset of the same profile costs a deflateReset
+        needs_reset_ = true;
+
+        int ret = Api::kOk;
+        do {
+            if (stream_.avail_out == 0) {
+                stream_.avail_out = static_cast<decltype(stream_.avail_out)>(
+                    std::min(out_left, max_chunk));
+                out_left -= stream_.avail_out;
+            }
+
+            if (stream_.avail_in == 0) {
+                stream_.avail_in =
+                    static_cast<decltype(stream_.avail_in)>(std::min(in_left, in_chunk));
+                in_left -= stream_.avail_in;
+            }
+
+            ret = Api::Deflate(&stream_, in_left != 0 ? Api::kNoFlush : Api::kFinish);
+
+            if (stop(static_cast<size_t>(stream_.next_out - out))) {
+                return false;
+            }
+        } while (ret == Api::kOk);
+
+        if (ret != Api::kStreamEnd) {
+            End();
+            throw std::runtime_error(std::string("Failed to compress data with ") + Api::kName);
+        }
+
+        written_ = static_cast<size_t>(stream_.next_out - out);
+        return true;
+    }
+
+    size_t Written() const {
+        return written_;
+    }
+
+private:
+    void End() {
+        if (initialized_) {
+            Api::End(&stream_);
+            initialized_ = false;
+        }
+    }
+
+    Stream stream_;
+    bool initialized_;
+    bool needs_reset_ = false;
+    CompressionProfile profile_;
+    size_t written_ = 0;
+};
+
+// DeflateBackend over a ZlibStream, one whole-buffer stream per Compress
+template <typename Api>
+class ZlibStreamBackend : public DeflateBackend {
+public:
+    size_t Bound(size_t size, const CompressionProfile& profile) override {
+        stream_.Reset(profile);
+        return stream_.Bound(size);
+    }
+
+    size_t Compress(PixelView data, const CompressionProfile& profile, uint8_t* out,
+                    size_t capacity) override {
+        stream_.Reset(profile);
+        stream_.Deflate(data, out, capacity, data.size(), [](size_t) { return false; });
+        return stream_.Written();
+    }
+
+private:
+    ZlibStream<Api> stream_;
+};
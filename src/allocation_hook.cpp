@@ -0,0 +1,40 @@
+// allocation_hook.cpp
+// Global operator new of png_encoder: counts allocations for --stats, then defers to malloc
+#include "../include/encode_stats.h"
+
+#include <cstdlib>
+#include <new>
+
+#ifdef PNG_ENCODER_STATS
+
+void* operator new(std::size_t size) {
+    StatsCollector::RecordAllocation(size);
+
+    if (void* pointer = std::malloc(size != 0 ? size : 1)) {
+        return pointer;
+    }
+
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return ::operator new(size);
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+#endif
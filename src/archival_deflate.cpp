@@ -0,0 +1,1255 @@
+// archival_deflate.cpp
+#include "../include/archival_deflate.h"
+#include "../include/encode_stats.h"
+
+#include <zlib.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <stdexcept>
+
+namespace {
+
+constexpr size_t kMinMatch = 3;
+constexpr size_t kMaxMatch = 258;
+constexpr size_t kMaxWindow = 32768;
+// Candidates visited per position, as in Zopfli
+constexpr size_t kMaxChainHits = 8192;
+
+// 286 length/literal symbols are used, the fixed code also covers 286 and 287
+constexpr size_t kLitLenSymbols = 288;
+constexpr size_t kDistSymbols = 32;
+constexpr size_t kCodeLengthSymbols = 19;
+constexpr size_t kEndOfBlock = 256;
+constexpr int kMaxCodeBits = 15;
+constexpr int kMaxCodeLengthBits = 7;
+constexpr size_t kMaxStoredChunk = 65535;
+
+constexpr size_t kHashBits = 16;
+constexpr uint32_t kNoPosition = std::numeric_limits<uint32_t>::max();
+
+constexpr uint16_t kLengthBase[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,
+                                      15, 17, 19, 23, 27, 31, 35, 43, 51,  59,
+                                      67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr uint8_t kLengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                      2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr uint16_t kDistBase[30] = {1,    2,    3,    4,    5,    7,     9,     13,
+                                    17,   25,   33,   49,   65,   97,    129,   193,
+                                    257,  385,  513,  769,  1025, 1537,  2049,  3073,
+                                    4097, 6145, 8193, 12289, 16385, 24577};
+constexpr uint8_t kDistExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                    6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+constexpr uint8_t kCodeLengthOrder[kCodeLengthSymbols] = {16, 17, 18, 0, 8,  7, 9,  6, 10, 5,
+                                                          11, 4,  12, 3, 13, 2, 14, 1, 15};
+
+// Length code (0..28, symbol 257 + code) of every match length
+constexpr std::array<uint8_t, kMaxMatch + 1> kLengthCode = [] {
+    std::array<uint8_t, kMaxMatch + 1> codes{};
+    for (size_t code = 0; code < 29; ++code) {
+        const size_t next = code + 1 < 29 ? kLengthBase[code + 1] : kMaxMatch + 1;
+        for (size_t length = kLengthBase[code]; length < next; ++length) {
+            codes[length] = static_cast<uint8_t>(code);
+        }
+    }
+    return codes;
+}();
+
+size_t DistCode(size_t distance) {
+    if (distance < 5) {
+        return distance - 1;
+    }
+
+    const size_t log2 =
+        31 - static_cast<size_t>(__builtin_clz(static_cast<uint32_t>(distance - 1)));
+    return 2 * log2 + (((distance - 1) >> (log2 - 1)) & 1);
+}
+
+size_t LengthSymbol(size_t length) {
+    return 257 + kLengthCode[length];
+}
+
+// One LZ77 item: a literal (distance 0, the byte in length) or a match
+struct Symbol {
+    uint16_t length;
+    uint16_t distance;
+
+    size_t Size() const {
+        return distance == 0 ? 1 : length;
+    }
+};
+
+struct Histogram {
+    std::array<size_t, kLitLenSymbols> litlen{};
+    std::array<size_t, kDistSymbols> dist{};
+
+    void Add(const Symbol& symbol) {
+        if (symbol.distance == 0) {
+            ++litlen[symbol.length];
+        } else {
+            ++litlen[LengthSymbol(symbol.length)];
+            ++dist[DistCode(symbol.distance)];
+        }
+    }
+
+    void Subtract(const Histogram& other) {
+        for (size_t i = 0; i < kLitLenSymbols; ++i) {
+            litlen[i] -= other.litlen[i];
+        }
+        for (size_t i = 0; i < kDistSymbols; ++i) {
+            dist[i] -= other.dist[i];
+        }
+    }
+};
+
+// Bits written LSB first, as deflate packs them
+class BitWriter {
+public:
+    void Write(uint32_t bits, int count) {
+        buffer_ |= static_cast<uint64_t>(bits) << used_;
+        used_ += count;
+        while (used_ >= 8) {
+            bytes_.push_back(static_cast<uint8_t>(buffer_));
+            buffer_ >>= 8;
+            used_ -= 8;
+        }
+    }
+
+    void AlignToByte() {
+        if (used_ > 0) {
+            bytes_.push_back(static_cast<uint8_t>(buffer_));
+            buffer_ = 0;
+            used_ = 0;
+        }
+    }
+
+    void Append(const BitWriter& other) {
+        if (used_ == 0) {
+            bytes_.insert(bytes_.end(), other.bytes_.begin(), other.bytes_.end());
+        } else {
+            for (uint8_t byte : other.bytes_) {
+                Write(byte, 8);
+            }
+        }
+        Write(static_cast<uint32_t>(other.buffer_), other.used_);
+    }
+
+    void AppendBytes(const uint8_t* data, size_t size) {
+        bytes_.insert(bytes_.end(), data, data + size);
+    }
+
+    std::vector<uint8_t>& Bytes() {
+        return bytes_;
+    }
+
+private:
+    std::vector<uint8_t> bytes_;
+    uint64_t buffer_ = 0;
+    int used_ = 0;
+};
+
+// Optimal prefix code lengths for freqs, at most max_bits long (Huffman, then the
+// overlong codes are folded back as miniz does). Unused symbols get length 0.
+void CodeLengths(const size_t* freqs, size_t count, int max_bits, uint8_t* lengths) {
+    struct Node {
+        size_t weight;
+        uint16_t symbol;
+        uint16_t parent;
+    };
+
+    std::array<Node, 2 * kLitLenSymbols> nodes;
+    size_t leaves = 0;
+    for (size_t i = 0; i < count; ++i) {
+        lengths[i] = 0;
+        if (freqs[i] != 0) {
+            nodes[leaves++] = {freqs[i], static_cast<uint16_t>(i), 0};
+        }
+    }
+
+    if (leaves == 0) {
+        return;
+    }
+    if (leaves == 1) {
+        lengths[nodes[0].symbol] = 1;
+        return;
+    }
+
+    std::sort(nodes.begin(), nodes.begin() + leaves, [](const Node& a, const Node& b) {
+        return a.weight != b.weight ? a.weight < b.weight : a.symbol < b.symbol;
+    });
+
+    // Two-queue Huffman: internal nodes are created in order of weight
+    size_t next_leaf = 0;
+    size_t next_internal = leaves;
+    size_t created = leaves;
+    auto take = [&]() {
+        if (next_leaf < leaves &&
+            (next_internal == created || nodes[next_leaf].weight <= nodes[next_internal].weight)) {
+            return next_leaf++;
+        }
+        return next_internal++;
+    };
+
+    for (size_t i = 0; i + 1 < leaves; ++i) {
+        const size_t first = take();
+        const size_t second = take();
+        nodes[created] = {nodes[first].weight + nodes[second].weight, 0, 0};
+        nodes[first].parent = static_cast<uint16_t>(created);
+        nodes[second].parent = static_cast<uint16_t>(created);
+        ++created;
+    }
+
+    // Parents come after their children, so depths resolve from the root down
+    std::array<uint8_t, 2 * kLitLenSymbols> depth{};
+    std::array<size_t, 64> depth_count{};
+    for (size_t i = created - 1; i-- > 0;) {
+        depth[i] = static_cast<uint8_t>(depth[nodes[i].parent] + 1);
+    }
+    int longest = 0;
+    for (size_t i = 0; i < leaves; ++i) {
+        ++depth_count[depth[i]];
+        longest = std::max<int>(longest, depth[i]);
+    }
+
+    if (longest > max_bits) {
+        for (int bits = max_bits + 1; bits <= longest; ++bits) {
+            depth_count[max_bits] += depth_count[bits];
+            depth_count[bits] = 0;
+        }
+
+        size_t total = 0;
+        for (int bits = 1; bits <= max_bits; ++bits) {
+            total += depth_count[bits] << (max_bits - bits);
+        }
+        while (total != size_t{1} << max_bits) {
+            --depth_count[max_bits];
+            for (int bits = max_bits - 1; bits > 0; --bits) {
+                if (depth_count[bits] != 0) {
+                    --depth_count[bits];
+                    depth_count[bits + 1] += 2;
+                    break;
+                }
+            }
+            --total;
+        }
+        longest = max_bits;
+    }
+
+    // The rarest symbols get the longest codes
+    size_t leaf = 0;
+    for (int bits = longest; bits > 0; --bits) {
+        for (size_t i = 0; i < depth_count[bits]; ++i) {
+            lengths[nodes[leaf++].symbol] = static_cast<uint8_t>(bits);
+        }
+    }
+}
+
+// Canonical codes for lengths, bit-reversed for the LSB-first writer
+void CanonicalCodes(const uint8_t* lengths, size_t count, uint16_t* codes) {
+    std::array<uint16_t, kMaxCodeBits + 2> length_count{};
+    for (size_t i = 0; i < count; ++i) {
+        ++length_count[lengths[i]];
+    }
+    length_count[0] = 0;
+
+    std::array<uint16_t, kMaxCodeBits + 2> next_code{};
+    uint32_t code = 0;
+    for (int bits = 1; bits <= kMaxCodeBits; ++bits) {
+        code = (code + length_count[bits - 1]) << 1;
+        next_code[bits] = static_cast<uint16_t>(code);
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        const int bits = lengths[i];
+        codes[i] = 0;
+        if (bits == 0) {
+            continue;
+        }
+
+        uint32_t value = next_code[bits]++;
+        uint32_t reversed = 0;
+        for (int b = 0; b < bits; ++b) {
+            reversed = (reversed << 1) | (value & 1);
+            value >>= 1;
+        }
+        codes[i] = static_cast<uint16_t>(reversed);
+    }
+}
+
+// Code lengths of one block: a dynamic pair of trees or the fixed code
+struct BlockCode {
+    std::array<uint8_t, kLitLenSymbols> litlen{};
+    std::array<uint8_t, kDistSymbols> dist{};
+
+    static BlockCode Fixed() {
+        BlockCode code;
+        for (size_t i = 0; i < kLitLenSymbols; ++i) {
+            code.litlen[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+        }
+        code.dist.fill(5);
+        return code;
+    }
+
+    static BlockCode Dynamic(const Histogram& histogram) {
+        Histogram counts = histogram;
+        counts.litlen[kEndOfBlock] = 1;
+
+        BlockCode code;
+        CodeLengths(counts.litlen.data(), 286, kMaxCodeBits, code.litlen.data());
+        CodeLengths(counts.dist.data(), 30, kMaxCodeBits, code.dist.data());
+
+        // Some decoders want at least two distance codes even when no match is used
+        size_t used = 0;
+        for (size_t i = 0; i < 30; ++i) {
+            used += code.dist[i] != 0;
+        }
+        if (used < 2) {
+            code.dist[code.dist[0] == 0 ? 0 : 1] = 1;
+            if (used == 0) {
+                code.dist[1] = 1;
+            }
+        }
+        return code;
+    }
+
+    // Bits of the symbols and their extra bits, without the block header
+    size_t DataBits(const Histogram& histogram) const {
+        size_t bits = litlen[kEndOfBlock];
+        for (size_t i = 0; i < 286; ++i) {
+            if (i != kEndOfBlock) {
+                size_t extra = i > kEndOfBlock ? kLengthExtra[i - 257] : 0;
+                bits += histogram.litlen[i] * (litlen[i] + extra);
+            }
+        }
+        for (size_t i = 0; i < 30; ++i) {
+            bits += histogram.dist[i] * (dist[i] + kDistExtra[i]);
+        }
+        return bits;
+    }
+};
+
+// Run-length coded tree description of a dynamic block (RFC 1951 3.2.7)
+class TreeHeader {
+public:
+    explicit TreeHeader(const BlockCode& code) {
+        litlen_count_ = 286;
+        while (litlen_count_ > 257 && code.litlen[litlen_count_ - 1] == 0) {
+            --litlen_count_;
+        }
+        dist_count_ = 30;
+        while (dist_count_ > 1 && code.dist[dist_count_ - 1] == 0) {
+            --dist_count_;
+        }
+
+        std::array<uint8_t, 286 + 30> lengths;
+        std::copy(code.litlen.begin(), code.litlen.begin() + litlen_count_, lengths.begin());
+        std::copy(code.dist.begin(), code.dist.begin() + dist_count_,
+                  lengths.begin() + litlen_count_);
+        const size_t total = litlen_count_ + dist_count_;
+
+        // Every combination of the three repeat codes; the cheapest one is kept
+        size_t best_bits = std::numeric_limits<size_t>::max();
+        for (int flags = 0; flags < 8; ++flags) {
+            Encode(lengths.data(), total, flags & 1, flags & 2, flags & 4);
+            if (bits_ < best_bits) {
+                best_bits = bits_;
+                best_flags_ = flags;
+            }
+        }
+        Encode(lengths.data(), total, best_flags_ & 1, best_flags_ & 2, best_flags_ & 4);
+    }
+
+    size_t Bits() const {
+        return bits_;
+    }
+
+    void Write(BitWriter& writer) const {
+        writer.Write(static_cast<uint32_t>(litlen_count_ - 257), 5);
+        writer.Write(static_cast<uint32_t>(dist_count_ - 1), 5);
+        writer.Write(static_cast<uint32_t>(order_count_ - 4), 4);
+        for (size_t i = 0; i < order_count_; ++i) {
+            writer.Write(code_lengths_[kCodeLengthOrder[i]], 3);
+        }
+
+        std::array<uint16_t, kCodeLengthSymbols> codes;
+        CanonicalCodes(code_lengths_.data(), kCodeLengthSymbols, codes.data());
+        for (size_t i = 0; i < token_count_; ++i) {
+            const uint8_t symbol = tokens_[i].symbol;
+            writer.Write(codes[symbol], code_lengths_[symbol]);
+            if (symbol >= 16) {
+                writer.Write(tokens_[i].extra, ExtraBits(symbol));
+            }
+        }
+    }
+
+private:
+    struct Token {
+        uint8_t symbol;
+        uint8_t extra;
+    };
+
+    static int ExtraBits(uint8_t symbol) {
+        return symbol == 16 ? 2 : symbol == 17 ? 3 : 7;
+    }
+
+    void Encode(const uint8_t* lengths, size_t total, bool use16, bool use17, bool use18) {
+        token_count_ = 0;
+
+        for (size_t i = 0; i < total;) {
+            const uint8_t value = lengths[i];
+            size_t run = 1;
+            while (i + run < total && lengths[i + run] == value) {
+                ++run;
+            }
+            i += run;
+
+            if (value == 0) {
+                while (use18 && run >= 11) {
+                    const size_t count = std::min<size_t>(run, 138);
+                    tokens_[token_count_++] = {18, static_cast<uint8_t>(count - 11)};
+                    run -= count;
+                }
+                while (use17 && run >= 3) {
+                    const size_t count = std::min<size_t>(run, 10);
+                    tokens_[token_count_++] = {17, static_cast<uint8_t>(count - 3)};
+                    run -= count;
+                }
+            }
+
+            if (use16 && run >= 4) {
+                tokens_[token_count_++] = {value, 0};
+                --run;
+                while (run >= 3) {
+                    const size_t count = std::min<size_t>(run, 6);
+                    tokens_[token_count_++] = {16, static_cast<uint8_t>(count - 3)};
+                    run -= count;
+                }
+            }
+
+            while (run > 0) {
+                tokens_[token_count_++] = {value, 0};
+                --run;
+            }
+        }
+
+        std::array<size_t, kCodeLengthSymbols> counts{};
+        for (size_t i = 0; i < token_count_; ++i) {
+            ++counts[tokens_[i].symbol];
+        }
+        CodeLengths(counts.data(), kCodeLengthSymbols, kMaxCodeLengthBits, code_lengths_.data());
+
+        // zlib rejects an incomplete code length code, so a lone symbol gets a partner
+        size_t used = 0;
+        for (uint8_t length : code_lengths_) {
+            used += length != 0;
+        }
+        if (used == 1) {
+            code_lengths_[code_lengths_[0] == 0 ? 0 : 1] = 1;
+        }
+
+        order_count_ = kCodeLengthSymbols;
+        while (order_count_ > 4 && code_lengths_[kCodeLengthOrder[order_count_ - 1]] == 0) {
+            --order_count_;
+        }
+
+        bits_ = 5 + 5 + 4 + 3 * order_count_;
+        for (size_t i = 0; i < token_count_; ++i) {
+            const uint8_t symbol = tokens_[i].symbol;
+            bits_ += code_lengths_[symbol] + (symbol >= 16 ? ExtraBits(symbol) : 0);
+        }
+    }
+
+    size_t litlen_count_ = 0;
+    size_t dist_count_ = 0;
+    int best_flags_ = 0;
+    std::array<Token, 286 + 30> tokens_;
+    size_t token_count_ = 0;
+    std::array<uint8_t, kCodeLengthSymbols> code_lengths_{};
+    size_t order_count_ = 0;
+    size_t bits_ = 0;
+};
+
+size_t StoredBits(size_t size) {
+    const size_t chunks = std::max<size_t>((size + kMaxStoredChunk - 1) / kMaxStoredChunk, 1);
+    return (chunks * 5 + size) * 8;
+}
+
+// Size in bits of a dynamic block for histogram
+size_t DynamicBits(const Histogram& histogram) {
+    const BlockCode code = BlockCode::Dynamic(histogram);
+    return 3 + TreeHeader(code).Bits() + code.DataBits(histogram);
+}
+
+// Size in bits of the cheapest block type for histogram over size input bytes
+size_t BlockBits(const Histogram& histogram, size_t size) {
+    static const BlockCode fixed = BlockCode::Fixed();
+    return std::min({DynamicBits(histogram), 3 + fixed.DataBits(histogram), StoredBits(size)});
+}
+
+Histogram HistogramOf(const Symbol* symbols, size_t count) {
+    Histogram histogram;
+    for (size_t i = 0; i < count; ++i) {
+        histogram.Add(symbols[i]);
+    }
+    return histogram;
+}
+
+size_t MatchLength(const uint8_t* a, const uint8_t* b, size_t limit) {
+    size_t length = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    while (length + 8 <= limit) {
+        uint64_t x;
+        uint64_t y;
+        std::memcpy(&x, a + length, 8);
+        std::memcpy(&y, b + length, 8);
+        if (x != y) {
+            return length + static_cast<size_t>(__builtin_ctzll(x ^ y)) / 8;
+        }
+        length += 8;
+    }
+#endif
+    while (length < limit && a[length] == b[length]) {
+        ++length;
+    }
+    return length;
+}
+
+// Hash chains over data[window_begin, end); positions are inserted in order and a search
+// only sees positions inserted before it. As in Zopfli, a second chain links positions
+// by hash and length of the byte run they start: once the best match covers the run at
+// the searched position, only candidates starting an equally long run can beat it.
+class MatchFinder {
+public:
+    MatchFinder(const uint8_t* data, size_t window_begin, size_t end, size_t max_distance)
+        : data_(data),
+          window_begin_(window_begin),
+          end_(end),
+          max_distance_(max_distance),
+          head_(size_t{1} << kHashBits, kNoPosition),
+          prev_(end - window_begin, kNoPosition),
+          head2_(size_t{1} << kHashBits, kNoPosition),
+          prev2_(end - window_begin, kNoPosition),
+          same_(end - window_begin, 0) {
+        for (size_t i = end - window_begin; i-- > 1;) {
+            const size_t pos = window_begin + i - 1;
+            if (data[pos] == data[pos + 1] && same_[i] < 0xFFFF) {
+                same_[i - 1] = static_cast<uint16_t>(same_[i] + 1);
+            }
+        }
+    }
+
+    void Insert(size_t pos) {
+        if (pos + kMinMatch > end_) {
+            return;
+        }
+
+        const uint32_t index = static_cast<uint32_t>(pos - window_begin_);
+        const uint32_t hash = Hash(pos);
+        prev_[index] = head_[hash];
+        head_[hash] = index;
+
+        const uint32_t hash2 = RunHash(hash, index);
+        prev2_[index] = head2_[hash2];
+        head2_[hash2] = index;
+    }
+
+    // Longest match at pos, no longer than limit. With sublen, sublen[k] receives the
+    // smallest distance of a match of length k for every k in [kMinMatch, result].
+    size_t Find(size_t pos, size_t limit, uint16_t* sublen, size_t& distance) const {
+        distance = 0;
+        if (limit < kMinMatch || pos + kMinMatch > end_) {
+            return 0;
+        }
+
+        const uint8_t* current = data_ + pos;
+        const uint32_t hash = Hash(pos);
+        const size_t same = same_[pos - window_begin_];
+        const uint32_t hash2 = RunHash(hash, static_cast<uint32_t>(pos - window_begin_));
+        const std::vector<uint32_t>* chain = &prev_;
+        size_t best = kMinMatch - 1;
+        size_t hits = 0;
+
+        for (uint32_t candidate = head_[hash]; candidate != kNoPosition && hits < kMaxChainHits;
+             candidate = (*chain)[candidate], ++hits) {
+            const size_t candidate_pos = window_begin_ + candidate;
+            const size_t candidate_distance = pos - candidate_pos;
+            if (candidate_distance > max_distance_) {
+                break;
+            }
+
+            const uint8_t* previous = data_ + candidate_pos;
+            // A candidate that differs at the current best length cannot beat it
+            if (previous[best] == current[best]) {
+                // Both runs of the first byte match without comparing them
+                size_t length = 0;
+                if (previous[0] == current[0]) {
+                    length = std::min<size_t>(std::min<size_t>(same, same_[candidate]) + 1,
+                                              limit);
+                }
+                length += MatchLength(previous + length, current + length, limit - length);
+
+                if (length > best) {
+                    if (sublen != nullptr) {
+                        for (size_t k = best + 1; k <= length; ++k) {
+                            sublen[k] = static_cast<uint16_t>(candidate_distance);
+                        }
+                    }
+                    best = length;
+                    distance = candidate_distance;
+
+                    if (best == limit) {
+                        break;
+                    }
+                }
+            }
+
+            if (chain == &prev_ && best > same && RunHash(hash, candidate) == hash2) {
+                chain = &prev2_;
+            }
+        }
+
+        return best >= kMinMatch ? best : 0;
+    }
+
+private:
+    uint32_t Hash(size_t pos) const {
+        const uint32_t value = static_cast<uint32_t>(data_[pos]) |
+                               static_cast<uint32_t>(data_[pos + 1]) << 8 |
+                               static_cast<uint32_t>(data_[pos + 2]) << 16;
+        return (value * 2654435761u) >> (32 - kHashBits);
+    }
+
+    uint32_t RunHash(uint32_t hash, uint32_t index) const {
+        return (hash ^ (same_[index] * 0x9E3779B1u >> (32 - kHashBits))) &
+               ((uint32_t{1} << kHashBits) - 1);
+    }
+
+    const uint8_t* data_;
+    size_t window_begin_;
+    size_t end_;
+    size_t max_distance_;
+    std::vector<uint32_t> head_;
+    std::vector<uint32_t> prev_;
+    std::vector<uint32_t> head2_;
+    std::vector<uint32_t> prev2_;
+    // Following bytes equal to the byte at each position, capped
+    std::vector<uint16_t> same_;
+};
+
+// Lazy greedy parse of [begin, end) as zlib does at level 9; matches reach back before begin
+std::vector<Symbol> GreedyParse(const uint8_t* data, size_t begin, size_t end,
+                                size_t max_distance) {
+    const size_t window_begin = begin - std::min(begin, max_distance);
+    MatchFinder finder(data, window_begin, end, max_distance);
+    for (size_t pos = window_begin; pos < begin; ++pos) {
+        finder.Insert(pos);
+    }
+
+    std::vector<Symbol> symbols;
+    symbols.reserve((end - begin) / 4);
+
+    size_t pos = begin;
+    size_t distance = 0;
+    size_t length = finder.Find(pos, std::min(kMaxMatch, end - pos), nullptr, distance);
+
+    while (pos < end) {
+        finder.Insert(pos);
+
+        size_t next_distance = 0;
+        size_t next_length = 0;
+        if (length != 0 && length < kMaxMatch && pos + 1 < end) {
+            next_length =
+                finder.Find(pos + 1, std::min(kMaxMatch, end - pos - 1), nullptr, next_distance);
+        }
+
+        if (length == 0 || next_length > length) {
+            symbols.push_back({data[pos], 0});
+            ++pos;
+            if (length != 0) {
+                length = next_length;
+                distance = next_distance;
+            } else if (pos < end) {
+                length = finder.Find(pos, std::min(kMaxMatch, end - pos), nullptr, distance);
+            }
+            continue;
+        }
+
+        symbols.push_back({static_cast<uint16_t>(length), static_cast<uint16_t>(distance)});
+        for (size_t i = 1; i < length; ++i) {
+            finder.Insert(pos + i);
+        }
+        pos += length;
+        if (pos < end) {
+            length = finder.Find(pos, std::min(kMaxMatch, end - pos), nullptr, distance);
+        }
+    }
+
+    return symbols;
+}
+
+// Histograms of symbol ranges from prefix sums taken every kStep symbols
+class RangeHistograms {
+public:
+    explicit RangeHistograms(const std::vector<Symbol>& symbols) : symbols_(symbols) {
+        Histogram running;
+        checkpoints_.push_back(running);
+        for (size_t i = 0; i < symbols.size(); ++i) {
+            running.Add(symbols[i]);
+            if ((i + 1) % kStep == 0) {
+                checkpoints_.push_back(running);
+            }
+        }
+    }
+
+    Histogram Of(size_t begin, size_t end) const {
+        Histogram histogram = Prefix(end);
+        histogram.Subtract(Prefix(begin));
+        return histogram;
+    }
+
+private:
+    static constexpr size_t kStep = 2048;
+
+    Histogram Prefix(size_t end) const {
+        Histogram histogram = checkpoints_[end / kStep];
+        for (size_t i = end / kStep * kStep; i < end; ++i) {
+            histogram.Add(symbols_[i]);
+        }
+        return histogram;
+    }
+
+    const std::vector<Symbol>& symbols_;
+    std::vector<Histogram> checkpoints_;
+};
+
+// Split points (symbol indices) of symbols into at most max_blocks blocks, each split
+// lowering the estimated total size (Zopfli's block splitter)
+std::vector<size_t> SplitSymbols(const std::vector<Symbol>& symbols, size_t max_blocks) {
+    if (symbols.size() < 10 || max_blocks < 2) {
+        return {};
+    }
+
+    std::vector<size_t> byte_offsets(symbols.size() + 1, 0);
+    for (size_t i = 0; i < symbols.size(); ++i) {
+        byte_offsets[i + 1] = byte_offsets[i] + symbols[i].Size();
+    }
+
+    const RangeHistograms histograms(symbols);
+    auto cost = [&](size_t begin, size_t end) {
+        return BlockBits(histograms.Of(begin, end), byte_offsets[end] - byte_offsets[begin]);
+    };
+
+    // Smallest cost of splitting [begin, end) at a point in (begin, end): a scan for
+    // short ranges, otherwise nine samples narrowed around the best one
+    auto find_split = [&](size_t begin, size_t end, size_t& best_cost) {
+        auto split_cost = [&](size_t point) { return cost(begin, point) + cost(point, end); };
+        size_t low = begin + 1;
+        size_t high = end;
+
+        if (high - low < 1024) {
+            size_t best = low;
+            best_cost = std::numeric_limits<size_t>::max();
+            for (size_t point = low; point < high; ++point) {
+                const size_t value = split_cost(point);
+                if (value < best_cost) {
+                    best_cost = value;
+                    best = point;
+                }
+            }
+            return best;
+        }
+
+        constexpr size_t kSamples = 9;
+        size_t best = low;
+        best_cost = std::numeric_limits<size_t>::max();
+        while (high - low > kSamples) {
+            size_t points[kSamples];
+            size_t best_index = 0;
+            size_t round_cost = std::numeric_limits<size_t>::max();
+            for (size_t i = 0; i < kSamples; ++i) {
+                points[i] = low + (i + 1) * ((high - low) / (kSamples + 1));
+                const size_t value = split_cost(points[i]);
+                if (value < round_cost) {
+                    round_cost = value;
+                    best_index = i;
+                }
+            }
+
+            if (round_cost > best_cost) {
+                break;
+            }
+
+            low = best_index == 0 ? low : points[best_index - 1];
+            high = best_index == kSamples - 1 ? high : points[best_index + 1];
+            best = points[best_index];
+            best_cost = round_cost;
+        }
+        return best;
+    };
+
+    std::vector<size_t> splits;
+    std::vector<bool> done(symbols.size(), false);
+    size_t begin = 0;
+    size_t end = symbols.size();
+
+    while (splits.size() + 1 < max_blocks) {
+        size_t split_cost = 0;
+        const size_t point = find_split(begin, end, split_cost);
+
+        if (split_cost >= cost(begin, end) || point == begin + 1 || point == end) {
+            done[begin] = true;
+        } else {
+            splits.insert(std::upper_bound(splits.begin(), splits.end(), point), point);
+        }
+
+        // Continue with the largest block that may still split
+        size_t largest = 0;
+        bool found = false;
+        for (size_t i = 0; i <= splits.size(); ++i) {
+            const size_t block_begin = i == 0 ? 0 : splits[i - 1];
+            const size_t block_end = i == splits.size() ? symbols.size() : splits[i];
+            if (!done[block_begin] && block_end - block_begin > largest) {
+                largest = block_end - block_begin;
+                begin = block_begin;
+                end = block_end;
+                found = true;
+            }
+        }
+
+        if (!found || end - begin < 10) {
+            break;
+        }
+    }
+
+    return splits;
+}
+
+// Bits per symbol under a statistical model: -log2 of the symbol frequency
+struct CostModel {
+    std::array<double, 256> literal;
+    std::array<double, kMaxMatch + 1> length;
+    std::array<double, 30> dist;
+
+    explicit CostModel(const std::array<double, kLitLenSymbols>& litlen_freqs,
+                       const std::array<double, kDistSymbols>& dist_freqs) {
+        std::array<double, kLitLenSymbols> litlen_bits;
+        std::array<double, kDistSymbols> dist_bits;
+        SymbolBits(litlen_freqs.data(), kLitLenSymbols, litlen_bits.data());
+        SymbolBits(dist_freqs.data(), kDistSymbols, dist_bits.data());
+
+        for (size_t i = 0; i < 256; ++i) {
+            literal[i] = litlen_bits[i];
+        }
+        for (size_t k = kMinMatch; k <= kMaxMatch; ++k) {
+            const size_t code = kLengthCode[k];
+            length[k] = litlen_bits[257 + code] + kLengthExtra[code];
+        }
+        for (size_t i = 0; i < 30; ++i) {
+            dist[i] = dist_bits[i] + kDistExtra[i];
+        }
+    }
+
+private:
+    static void SymbolBits(const double* freqs, size_t count, double* bits) {
+        double total = 0.0;
+        for (size_t i = 0; i < count; ++i) {
+            total += freqs[i];
+        }
+
+        const double log_total = total > 0.0 ? std::log2(total) : 0.0;
+        for (size_t i = 0; i < count; ++i) {
+            // An unseen symbol costs as much as one seen once
+            bits[i] = freqs[i] > 0.0 ? log_total - std::log2(freqs[i]) : log_total;
+        }
+    }
+};
+
+struct SymbolStats {
+    std::array<double, kLitLenSymbols> litlen{};
+    std::array<double, kDistSymbols> dist{};
+
+    static SymbolStats Of(const std::vector<Symbol>& symbols) {
+        const Histogram histogram = HistogramOf(symbols.data(), symbols.size());
+        SymbolStats stats;
+        for (size_t i = 0; i < kLitLenSymbols; ++i) {
+            stats.litlen[i] = static_cast<double>(histogram.litlen[i]);
+        }
+        for (size_t i = 0; i < kDistSymbols; ++i) {
+            stats.dist[i] = static_cast<double>(histogram.dist[i]);
+        }
+        stats.litlen[kEndOfBlock] = 1.0;
+        return stats;
+    }
+
+    void AddWeighted(const SymbolStats& other, double weight) {
+        for (size_t i = 0; i < kLitLenSymbols; ++i) {
+            litlen[i] += other.litlen[i] * weight;
+        }
+        for (size_t i = 0; i < kDistSymbols; ++i) {
+            dist[i] += other.dist[i] * weight;
+        }
+        litlen[kEndOfBlock] = 1.0;
+    }
+
+    // Replaces about a third of the frequencies by random others, to leave a local minimum
+    void Randomize(std::mt19937& random) {
+        auto shuffle = [&](double* freqs, size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                if ((random() >> 4) % 3 == 0) {
+                    freqs[i] = freqs[random() % count];
+                }
+            }
+        };
+        shuffle(litlen.data(), kLitLenSymbols);
+        shuffle(dist.data(), kDistSymbols);
+        litlen[kEndOfBlock] = 1.0;
+    }
+};
+
+// Matches of every position of a block, computed once for all iterations. For position i
+// the entries [offsets[i], offsets[i + 1]) are (longest length, distance) pairs in
+// increasing length: every length up to an entry's length uses that entry's distance.
+struct MatchCache {
+    std::vector<uint32_t> offsets;
+    std::vector<Symbol> entries;
+    // Equal bytes starting at each position, capped
+    std::vector<uint16_t> runs;
+
+    MatchCache(const uint8_t* data, size_t begin, size_t end, size_t max_distance) {
+        const size_t size = end - begin;
+        runs.assign(size, 1);
+        for (size_t i = size; i-- > 1;) {
+            if (data[begin + i - 1] == data[begin + i] && runs[i] < 0xFFFF) {
+                runs[i - 1] = static_cast<uint16_t>(runs[i] + 1);
+            }
+        }
+
+        const size_t window_begin = begin - std::min(begin, max_distance);
+        MatchFinder finder(data, window_begin, end, max_distance);
+        for (size_t pos = window_begin; pos < begin; ++pos) {
+            finder.Insert(pos);
+        }
+
+        offsets.reserve(size + 1);
+        entries.reserve(size * 2);
+        std::array<uint16_t, kMaxMatch + 1> sublen{};
+
+        for (size_t i = 0; i < size; ++i) {
+            offsets.push_back(static_cast<uint32_t>(entries.size()));
+            const size_t pos = begin + i;
+
+            // ParseOptimal steps over the inside of long runs and never reads these
+            if (!InsideLongRun(data + begin, i)) {
+                size_t distance = 0;
+                const size_t longest =
+                    finder.Find(pos, std::min(kMaxMatch, end - pos), sublen.data(), distance);
+                for (size_t k = kMinMatch; k <= longest; ++k) {
+                    if (k == longest || sublen[k + 1] != sublen[k]) {
+                        entries.push_back({static_cast<uint16_t>(k), sublen[k]});
+                    }
+                }
+            }
+
+            finder.Insert(pos);
+        }
+        offsets.push_back(static_cast<uint32_t>(entries.size()));
+    }
+
+    // Position i of the block continues a run of one byte that goes on for more than two
+    // whole matches
+    bool InsideLongRun(const uint8_t* block, size_t i) const {
+        return i > 0 && runs[i] > 2 * kMaxMatch && block[i - 1] == block[i];
+    }
+};
+
+// Cheapest parse of [begin, end) under model: a shortest path where position i links to
+// i + 1 by a literal and to i + k by every cached match length k
+void ParseOptimal(const uint8_t* data, size_t begin, size_t end, const MatchCache& cache,
+                  const CostModel& model, std::vector<double>& costs,
+                  std::vector<Symbol>& steps, std::vector<Symbol>& symbols) {
+    const size_t size = end - begin;
+    constexpr double kInfinity = std::numeric_limits<double>::infinity();
+    costs.assign(size + 1, kInfinity);
+    steps.assign(size + 1, Symbol{0, 0});
+    costs[0] = 0.0;
+
+    for (size_t i = 0; i < size; ++i) {
+        const double cost = costs[i];
+        if (cost == kInfinity) {
+            continue;
+        }
+
+        // Inside a long run of one byte take whole 258-byte matches at distance 1, as
+        // Zopfli does, instead of trying every length at every position
+        if (cache.InsideLongRun(data + begin, i)) {
+            const double step_cost = model.length[kMaxMatch] + model.dist[0];
+            size_t pos = i;
+            while (cache.runs[pos] > 2 * kMaxMatch) {
+                costs[pos + kMaxMatch] = costs[pos] + step_cost;
+                steps[pos + kMaxMatch] = {static_cast<uint16_t>(kMaxMatch), 1};
+                pos += kMaxMatch;
+            }
+            i = pos - 1;
+            continue;
+        }
+
+        const double literal_cost = cost + model.literal[data[begin + i]];
+        if (literal_cost < costs[i + 1]) {
+            costs[i + 1] = literal_cost;
+            steps[i + 1] = {data[begin + i], 0};
+        }
+
+        size_t length = kMinMatch;
+        for (uint32_t e = cache.offsets[i]; e < cache.offsets[i + 1]; ++e) {
+            const Symbol entry = cache.entries[e];
+            const double base = cost + model.dist[DistCode(entry.distance)];
+            for (; length <= entry.length; ++length) {
+                const double match_cost = base + model.length[length];
+                if (match_cost < costs[i + length]) {
+                    costs[i + length] = match_cost;
+                    steps[i + length] = {static_cast<uint16_t>(length), entry.distance};
+                }
+            }
+        }
+    }
+
+    symbols.clear();
+    for (size_t i = size; i > 0;) {
+        const Symbol step = steps[i];
+        symbols.push_back(step);
+        i -= step.Size();
+    }
+    std::reverse(symbols.begin(), symbols.end());
+}
+
+// The block [begin, end) and how it is written
+struct Block {
+    size_t begin = 0;
+    size_t end = 0;
+    std::vector<Symbol> symbols;
+    bool last = false;
+
+    bool stored = false;
+    BitWriter bits;
+};
+
+// Iterative optimal parse of the block, starting from the statistics of its greedy parse;
+// keeps the cheapest parse seen (Zopfli's squeeze)
+void Squeeze(const uint8_t* data, Block& block, int iterations, size_t max_distance) {
+    const MatchCache cache(data, block.begin, block.end, max_distance);
+
+    std::vector<Symbol> best = block.symbols;
+    size_t best_bits = DynamicBits(HistogramOf(best.data(), best.size()));
+
+    SymbolStats stats = SymbolStats::Of(best);
+    SymbolStats best_stats = stats;
+    std::mt19937 random(0x5EED);
+    std::vector<double> costs;
+    std::vector<Symbol> steps;
+    std::vector<Symbol> current;
+    size_t last_bits = 0;
+    int last_random_step = -1;
+
+    for (int i = 0; i < iterations; ++i) {
+        ParseOptimal(data, block.begin, block.end, cache, CostModel(stats.litlen, stats.dist),
+                     costs, steps, current);
+        const size_t bits = DynamicBits(HistogramOf(current.data(), current.size()));
+
+        if (bits < best_bits) {
+            best = current;
+            best_bits = bits;
+            best_stats = stats;
+        }
+
+        const SymbolStats last_stats = stats;
+        stats = SymbolStats::Of(current);
+        if (last_random_step != -1) {
+            // Converges slower but better once the random steps begin
+            stats.AddWeighted(last_stats, 0.5);
+        }
+        if (i > 5 && bits == last_bits) {
+            stats = best_stats;
+            stats.Randomize(random);
+            last_random_step = i;
+        }
+        last_bits = bits;
+    }
+
+    block.symbols = std::move(best);
+}
+
+void WriteSymbols(const std::vector<Symbol>& symbols, const BlockCode& code, BitWriter& writer) {
+    std::array<uint16_t, kLitLenSymbols> litlen_codes;
+    std::array<uint16_t, kDistSymbols> dist_codes;
+    CanonicalCodes(code.litlen.data(), kLitLenSymbols, litlen_codes.data());
+    CanonicalCodes(code.dist.data(), kDistSymbols, dist_codes.data());
+
+    for (const Symbol& symbol : symbols) {
+        if (symbol.distance == 0) {
+            writer.Write(litlen_codes[symbol.length], code.litlen[symbol.length]);
+            continue;
+        }
+
+        const size_t length_code = kLengthCode[symbol.length];
+        writer.Write(litlen_codes[257 + length_code], code.litlen[257 + length_code]);
+        writer.Write(symbol.length - kLengthBase[length_code], kLengthExtra[length_code]);
+
+        const size_t dist_code = DistCode(symbol.distance);
+        writer.Write(dist_codes[dist_code], code.dist[dist_code]);
+        writer.Write(symbol.distance - kDistBase[dist_code], kDistExtra[dist_code]);
+    }
+
+    writer.Write(litlen_codes[kEndOfBlock], code.litlen[kEndOfBlock]);
+}
+
+// Writes the block with the cheapest type into block.bits; stored blocks depend on the
+// byte alignment of the final stream and are written when the blocks are joined
+void EncodeBlock(Block& block) {
+    const Histogram histogram = HistogramOf(block.symbols.data(), block.symbols.size());
+    const BlockCode dynamic = BlockCode::Dynamic(histogram);
+    const BlockCode fixed = BlockCode::Fixed();
+    const TreeHeader header(dynamic);
+
+    const size_t dynamic_bits = 3 + header.Bits() + dynamic.DataBits(histogram);
+    const size_t fixed_bits = 3 + fixed.DataBits(histogram);
+    const size_t stored_bits = StoredBits(block.end - block.begin);
+
+    if (stored_bits < dynamic_bits && stored_bits < fixed_bits) {
+        block.stored = true;
+        return;
+    }
+
+    block.bits.Write(block.last ? 1 : 0, 1);
+    if (dynamic_bits < fixed_bits) {
+        block.bits.Write(2, 2);
+        header.Write(block.bits);
+        WriteSymbols(block.symbols, dynamic, block.bits);
+    } else {
+        block.bits.Write(1, 2);
+        WriteSymbols(block.symbols, fixed, block.bits);
+    }
+}
+
+void WriteStored(const uint8_t* data, const Block& block, BitWriter& writer) {
+    size_t pos = block.begin;
+    do {
+        const size_t size = std::min(kMaxStoredChunk, block.end - pos);
+        const bool last = block.last && pos + size == block.end;
+
+        writer.Write(last ? 1 : 0, 1);
+        writer.Write(0, 2);
+        writer.AlignToByte();
+        writer.Write(static_cast<uint32_t>(size), 16);
+        writer.Write(static_cast<uint32_t>(~size & 0xFFFF), 16);
+        writer.AppendBytes(data + pos, size);
+        pos += size;
+    } while (pos < block.end);
+}
+
+template <typename Body>
+void ForEach(ThreadPool* pool, size_t count, const Body& body) {
+    if (pool != nullptr && count > 1) {
+        pool->ParallelFor(count, body);
+        return;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        body(i);
+    }
+}
+
+}  // namespace
+
+std::vector<uint8_t> ArchivalDeflateCompressor::Compress(PixelView data,
+                                                         const CompressionProfile& profile,
+                                                         ThreadPool* pool) {
+    if (profile.iterations < 1) {
+        throw std::runtime_error("Archival deflate needs at least one iteration");
+    }
+    if (profile.window_bits < 9 || profile.window_bits > 15) {
+        throw std::runtime_error("Deflate window bits must be in [9, 15]");
+    }
+
+    const uint8_t* bytes = data.data();
+    const size_t max_distance = std::min(kMaxWindow, size_t{1} << profile.window_bits);
+
+    // Greedy parse and block split of every master block
+    const size_t master_count = std::max<size_t>((data.size() + kMasterBlockSize - 1) /
+                                                     kMasterBlockSize,
+                                                 1);
+    std::vector<std::vector<Block>> masters(master_count);
+
+    ForEach(pool, master_count, [&](size_t m) {
+        const size_t begin = std::min(m * kMasterBlockSize, data.size());
+        const size_t end = std::min(begin + kMasterBlockSize, data.size());
+        std::vector<Symbol> symbols = GreedyParse(bytes, begin, end, max_distance);
+        const std::vector<size_t> splits = SplitSymbols(symbols, kMaxBlocks);
+
+        size_t pos = begin;
+        size_t first = 0;
+        for (size_t i = 0; i <= splits.size(); ++i) {
+            const size_t last = i == splits.size() ? symbols.size() : splits[i];
+            Block block;
+            block.begin = pos;
+            block.symbols.assign(symbols.begin() + first, symbols.begin() + last);
+            for (const Symbol& symbol : block.symbols) {
+                pos += symbol.Size();
+            }
+            block.end = pos;
+            masters[m].push_back(std::move(block));
+            first = last;
+        }
+    });
+
+    std::vector<Block> blocks;
+    for (std::vector<Block>& master : masters) {
+        std::move(master.begin(), master.end(), std::back_inserter(blocks));
+    }
+    blocks.back().last = true;
+
+    ForEach(pool, blocks.size(), [&](size_t i) {
+        Block& block = blocks[i];
+        StageTimer timer(EncodeStage::Deflate, block.end - block.begin);
+
+        if (block.end > block.begin) {
+            Squeeze(bytes, block, profile.iterations, max_distance);
+        }
+        EncodeBlock(block);
+        std::vector<Symbol>().swap(block.symbols);
+        timer.AddBytesOut(block.bits.Bytes().size());
+    });
+
+    // RFC 1950 header with FLEVEL 3 (maximum compression)
+    BitWriter stream;
+    const unsigned cmf = (static_cast<unsigned>(profile.window_bits - 8) << 4) | 8;
+    unsigned flg = 3 << 6;
+    flg += 31 - (cmf * 256 + flg) % 31;
+    stream.Write(cmf, 8);
+    stream.Write(flg, 8);
+
+    for (const Block& block : blocks) {
+        if (block.stored) {
+            WriteStored(bytes, block, stream);
+        } else {
+            stream.Append(block.bits);
+        }
+    }
+    stream.AlignToByte();
+
+    const uLong adler = adler32_z(1L, bytes, data.size());
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        stream.Write(static_cast<uint32_t>((adler >> shift) & 0xFF), 8);
+    }
+
+    return std::move(stream.Bytes());
+}
+
+size_t ArchivalDeflateCompressor::Bound(size_t size) {
+    // Every block falls back to stored when that is smaller; blocks of one master block
+    // add at most one partial stored chunk each
+    const size_t blocks = (size / kMasterBlockSize + 1) * kMaxBlocks;
+    return 2 + 4 + size + (size / kMaxStoredChunk + blocks) * 5 + 1;
+}
@@ -0,0 +1,222 @@
+// batch_encoder.cpp
+#include "../include/batch_encoder.h"
+#include "../include/encode_stats.h"
+#include "../include/encoder_context.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <mutex>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Buffers a worker keeps for the next file
+constexpr size_t kMaxRetainedContextBytes = 64ull << 20;
+
+// Counts the bytes of the jobs in flight; a job that alone exceeds the limit
+// is still admitted once nothing else is running
+class MemoryBudget {
+public:
+    explicit MemoryBudget(uint64_t limit) : limit_(limit), used_(0) {
+    }
+
+    void Acquire(uint64_t bytes) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        released_.wait(lock, [&]() { return used_ == 0 || used_ + bytes <= limit_; });
+        used_ += bytes;
+    }
+
+    void Release(uint64_t bytes) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            used_ -= bytes;
+        }
+
+        released_.notify_all();
+    }
+
+private:
+    const uint64_t limit_;
+    uint64_t used_;
+    std::mutex mutex_;
+    std::condition_variable released_;
+};
+
+uint64_t FileSize(const std::string& path) {
+    std::error_code error;
+    auto size = std::filesystem::file_size(path, error);
+    return error ? 0 : static_cast<uint64_t>(size);
+}
+
+}  // namespace
+
+BatchEncoder::BatchEncoder(size_t threads, uint64_t max_in_flight_bytes)
+    : pool_(threads), max_in_flight_bytes_(max_in_flight_bytes) {
+}
+
+std::vector<EncodeJob> BatchEncoder::ReadManifest(const std::string& manifest_path,
+                                                  const std::vector<std::string>& default_args) {
+    std::ifstream manifest(manifest_path);
+
+    if (!manifest) {
+        throw std::runtime_error("Cannot open batch manifest: " + manifest_path);
+    }
+
+    std::vector<EncodeJob> jobs;
+    std::string line;
+    size_t line_number = 0;
+
+    while (std::getline(manifest, line)) {
+        ++line_number;
+
+        std::istringstream tokens(line);
+        std::vector<std::string> args = default_args;
+        const size_t default_count = args.size();
+
+        for (std::string token; tokens >> token;) {
+            args.push_back(token);
+        }
+
+        if (args.size() == default_count || args[default_count].front() == '#') {
+            continue;
+        }
+
+        try {
+            jobs.push_back(PNGEncoder::ParseJob(args));
+        } catch (const std::exception& ex) {
+            throw std::runtime_error(manifest_path + ":" + std::to_string(line_number) + ": " +
+                                     ex.what());
+        }
+    }
+
+    return jobs;
+}
+
+std::vector<EncodeJob> BatchEncoder::ScanDirectory(const std::string& input_dir,
+                                                   const std::string& output_dir,
+                                                   const std::vector<std::string>& default_args,
+                                                   std::vector<std::string>* skipped) {
+    namespace fs = std::filesystem;
+
+    const std::regex dimensions_pattern(R"(.*-(\d+)x(\d+))");
+    std::vector<fs::path> inputs;
+
+    for (const auto& entry : fs::directory_iterator(input_dir)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".raw") {
+            inputs.push_back(entry.path());
+        }
+    }
+
+    std::sort(inputs.begin(), inputs.end());
+    fs::create_directories(output_dir);
+
+    std::vector<EncodeJob> jobs;
+    for (const auto& input : inputs) {
+        const std::string stem = input.stem().string();
+        std::smatch match;
+
+        if (!std::regex_match(stem, match, dimensions_pattern)) {
+            if (skipped != nullptr) {
+                skipped->push_back(input.string());
+            }
+            continue;
+        }
+
+        std::vector<std::string> args = default_args;
+        args.push_back(input.string());
+        args.push_back((fs::path(output_dir) / (stem + ".png")).string());
+        args.push_back(match[1].str());
+        args.push_back(match[2].str());
+
+        jobs.push_back(PNGEncoder::ParseJob(args));
+    }
+
+    return jobs;
+}
+
+uint64_t BatchEncoder::EstimateJobBytes(const EncodeJob& job) {
+    const uint64_t rgb_bytes = job.width * job.height * 3;
+
+    if (job.options.streaming) {
+        return job.width * 3 * 4 + (256 << 10);
+    }
+
+    // Each --sizes variant resizes into and encodes from its own context, all of them
+    // alongside the full size: resized pixels, filtered copy, scanlines, deflate output
+    uint64_t variant_bytes = 0;
+    for (const OutputSize& size : job.options.sizes) {
+        uint64_t width = 0;
+        uint64_t height = 0;
+        size.Dimensions(job.width, job.height, width, height);
+        variant_bytes += width * height * 3 * 3 + height * (width * 3 + 1);
+    }
+
+    return rgb_bytes * 4 + variant_bytes;
+}
+
+void BatchEncoder::SetCache(EncodeCache* cache) {
+    cache_ = cache;
+}
+
+BatchReport BatchEncoder::Run(const std::vector<EncodeJob>& jobs) {
+    BatchReport report;
+    report.results.resize(jobs.size());
+
+    MemoryBudget budget(max_in_flight_bytes_);
+    std::vector<std::future<void>> pending;
+    pending.reserve(jobs.size());
+
+    const auto batch_start = Clock::now();
+
+    // Jobs report their stage timings to the collector of the calling thread
+    StatsCollector* collector = StatsCollector::Current();
+
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        const uint64_t job_bytes = EstimateJobBytes(jobs[i]);
+        budget.Acquire(job_bytes);
+
+        pending.push_back(pool_.Submit([this, &jobs, &report, &budget, i, job_bytes, collector]() {
+            ScopedStatsCollector scope(collector);
+            BatchResult& result = report.results[i];
+            result.job = jobs[i];
+
+            const auto start = Clock::now();
+            try {
+                // Workers keep their buffers between files, minus the ones a large image grew
+                thread_local EncoderContext context;
+                PNGEncoder::EncodeFile(result.job, pool_, context, cache_);
+                context.Trim(kMaxRetainedContextBytes);
+                result.ok = true;
+                result.input_bytes = result.job.width * result.job.height * 3;
+                result.output_bytes = FileSize(result.job.output_path);
+            } catch (const std::exception& ex) {
+                result.error = ex.what();
+            }
+            result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+            budget.Release(job_bytes);
+        }));
+    }
+
+    for (auto& job : pending) {
+        job.get();
+    }
+
+    report.wall_seconds = std::chrono::duration<double>(Clock::now() - batch_start).count();
+
+    for (const auto& result : report.results) {
+        report.input_bytes += result.input_bytes;
+        report.output_bytes += result.output_bytes;
+        report.failed += result.ok ? 0 : 1;
+    }
+
+    return report;
+}
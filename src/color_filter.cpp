@@ -34,27 +34,51 @@ ColorFilterType ColorFilter::Parse(const std::string& filter_name) {
     throw std::runtime_error("Unknown color filter: " + filter_name);
 }
 
-std::vector<uint8_t> ColorFilter::Apply(const std::vector<uint8_t>& rgb_data, uint64_t width,
-                                        uint64_t height, ColorFilterType filter_type,
-                                        float perlin_noise_scale) {
-    if (filter_type == ColorFilterType::None) {
-        return rgb_data;
-    }
-
-    std::vector<uint8_t> output_data = rgb_data;
+void ColorFilter::ApplyRows(uint8_t* rgb_rows, uint64_t width, uint64_t first_row,
+                            uint64_t row_count, ColorFilterType filter_type,
+                            float perlin_noise_scale) {
     switch (filter_type) {
         case ColorFilterType::Negative:
-            NegativeFilter::Apply(output_data);
+            NegativeFilter::Apply(rgb_rows, width * row_count * 3);
             break;
         case ColorFilterType::Grayscale:
-            GrayscaleFilter::Apply(output_data);
+            GrayscaleFilter::Apply(rgb_rows, width * row_count * 3);
             break;
         case ColorFilterType::PerlinNoise:
-            PerlinNoiseFilter::Apply(output_data, width, height, perlin_noise_scale);
+            PerlinNoiseFilter::ApplyRows(rgb_rows, width, first_row, row_count,
+                                         perlin_noise_scale);
             break;
         default:
             break;
     }
+}
+
+std::vector<uint8_t> ColorFilter::Apply(PixelView rgb_data, uint64_t width, uint64_t height,
+                                        ColorFilterType filter_type, float perlin_noise_scale,
+                                        ThreadPool* pool) {
+    std::vector<uint8_t> output_data(rgb_data.begin(), rgb_data.end());
+
+    if (filter_type == ColorFilterType::None || output_data.empty()) {
+        return output_data;
+    }
+
+    // A few bands per worker even out the threads, as in PNGFilter::Apply
+    size_t band_count = 1;
+    if (pool != nullptr && pool->Size() > 1) {
+        band_count = std::min<uint64_t>(pool->Size() * 4, height / kMinBandRows);
+    }
+
+    if (band_count <= 1) {
+        ApplyRows(output_data.data(), width, 0, height, filter_type, perlin_noise_scale);
+        return output_data;
+    }
+
+    pool->ParallelFor(band_count, [&](size_t band) {
+        const uint64_t begin = height * band / band_count;
+        const uint64_t end = height * (band + 1) / band_count;
+        ApplyRows(output_data.data() + begin * width * 3, width, begin, end - begin,
+                  filter_type, perlin_noise_scale);
+    });
 
     return output_data;
 }
\ No newline at end of file
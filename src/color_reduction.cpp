@@ -0,0 +1,296 @@
+// color_reduction.cpp
+#include "../include/color_reduction.h"
+#include "../include/encode_stats.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Gray levels exactly representable at a bit depth: multiples of 255 / (2^depth - 1)
+constexpr uint8_t kGrayDepths[] = {1, 2, 4};
+constexpr uint8_t kGrayStep[] = {255, 85, 17};
+
+uint32_t PackColor(const uint8_t* pixel) {
+    return (static_cast<uint32_t>(pixel[0]) << 16) | (static_cast<uint32_t>(pixel[1]) << 8) |
+           pixel[2];
+}
+
+size_t Slot(uint32_t color, size_t table_size) {
+    return (color * 0x9E3779B1u) >> 22 & (table_size - 1);
+}
+
+uint8_t PaletteDepth(size_t color_count) {
+    if (color_count <= 2) {
+        return 1;
+    }
+    if (color_count <= 4) {
+        return 2;
+    }
+    if (color_count <= 16) {
+        return 4;
+    }
+    return 8;
+}
+
+// Row y of the image after the color filter, which is applied in row when there is one
+const uint8_t* FilteredRow(const ImageView& image, uint64_t y, ColorFilterType color_filter,
+                           float perlin_noise_scale, std::vector<uint8_t>& row) {
+    const uint8_t* pixels = image.Row(y);
+    if (color_filter == ColorFilterType::None) {
+        return pixels;
+    }
+
+    const size_t row_bytes = image.width * 3;
+    StageTimer filter_timer(EncodeStage::ColorFilter, row_bytes);
+    row.resize(row_bytes);
+    std::memcpy(row.data(), pixels, row_bytes);
+    ColorFilter::ApplyRows(row.data(), image.width, y, 1, color_filter, perlin_noise_scale);
+    filter_timer.AddBytesOut(row_bytes);
+    return row.data();
+}
+
+}  // namespace
+
+ColorAnalyzer::ColorAnalyzer()
+    : gray_(true), gray_levels_{}, palette_overflow_(false), color_count_(0),
+      last_color_(kEmpty) {
+    colors_.fill(kEmpty);
+}
+
+void ColorAnalyzer::AddColor(uint32_t color) {
+    size_t slot = Slot(color, kTableSize);
+
+    while (colors_[slot] != kEmpty) {
+        if (colors_[slot] == color) {
+            return;
+        }
+        slot = (slot + 1) & (kTableSize - 1);
+    }
+
+    if (color_count_ == kMaxPaletteSize) {
+        palette_overflow_ = true;
+        return;
+    }
+
+    colors_[slot] = color;
+    ++color_count_;
+}
+
+void ColorAnalyzer::AddPixels(const uint8_t* rgb, size_t pixel_count) {
+    for (size_t i = 0; i < pixel_count && !IsTruecolor(); ++i) {
+        const uint8_t* pixel = rgb + i * 3;
+
+        if (gray_) {
+            if (pixel[0] == pixel[1] && pixel[1] == pixel[2]) {
+                gray_levels_[pixel[0]] = true;
+            } else {
+                gray_ = false;
+            }
+        }
+
+        // Runs of one color are common in flat content, skip the table for them
+        const uint32_t color = PackColor(pixel);
+        if (color != last_color_ && !palette_overflow_) {
+            AddColor(color);
+            last_color_ = color;
+        }
+    }
+}
+
+bool ColorAnalyzer::IsTruecolor() const {
+    return !gray_ && palette_overflow_;
+}
+
+PixelFormat ColorAnalyzer::Result() const {
+    PixelFormat format;
+
+    if (IsTruecolor()) {
+        return format;
+    }
+
+    uint8_t gray_depth = 8;
+    if (gray_) {
+        for (size_t d = 0; d < std::size(kGrayDepths); ++d) {
+            bool fits = true;
+            for (size_t level = 0; level < gray_levels_.size() && fits; ++level) {
+                fits = !gray_levels_[level] || level % kGrayStep[d] == 0;
+            }
+
+            if (fits) {
+                gray_depth = kGrayDepths[d];
+                break;
+            }
+        }
+    }
+
+    const uint8_t palette_depth = palette_overflow_ ? 8 : PaletteDepth(color_count_);
+
+    if (gray_ && (palette_overflow_ || gray_depth <= palette_depth)) {
+        format.color_type = PNGColorType::Grayscale;
+        format.bit_depth = gray_depth;
+        return format;
+    }
+
+    // Sorted entries keep similar colors at nearby indices, which filters better
+    std::vector<uint32_t> colors;
+    colors.reserve(color_count_);
+    for (uint32_t color : colors_) {
+        if (color != kEmpty) {
+            colors.push_back(color);
+        }
+    }
+    std::sort(colors.begin(), colors.end());
+
+    format.color_type = PNGColorType::Indexed;
+    format.bit_depth = palette_depth;
+    format.palette.reserve(colors.size() * 3);
+    for (uint32_t color : colors) {
+        format.palette.push_back(static_cast<uint8_t>(color >> 16));
+        format.palette.push_back(static_cast<uint8_t>(color >> 8));
+        format.palette.push_back(static_cast<uint8_t>(color));
+    }
+
+    return format;
+}
+
+PixelPacker::PixelPacker(const PixelFormat& format) : format_(format), indices_{} {
+    keys_.fill(kEmpty);
+
+    for (size_t i = 0; i * 3 < format_.palette.size(); ++i) {
+        const uint32_t color = PackColor(&format_.palette[i * 3]);
+        size_t slot = Slot(color, kTableSize);
+
+        while (keys_[slot] != kEmpty) {
+            slot = (slot + 1) & (kTableSize - 1);
+        }
+
+        keys_[slot] = color;
+        indices_[slot] = static_cast<uint8_t>(i);
+    }
+}
+
+size_t PixelPacker::PaletteSlot(uint32_t color) const {
+    size_t slot = Slot(color, kTableSize);
+
+    while (keys_[slot] != color && keys_[slot] != kEmpty) {
+        slot = (slot + 1) & (kTableSize - 1);
+    }
+
+    return slot;
+}
+
+uint8_t PixelPacker::PaletteIndex(uint32_t color) const {
+    return indices_[PaletteSlot(color)];
+}
+
+void PixelPacker::PackRow(const uint8_t* rgb_row, uint64_t width, uint8_t* out) const {
+    if (format_.IsRGB8()) {
+        std::memcpy(out, rgb_row, width * 3);
+        return;
+    }
+
+    const bool indexed = format_.color_type == PNGColorType::Indexed;
+    const unsigned depth = format_.bit_depth;
+    const unsigned gray_divisor = 255 / ((1u << depth) - 1);
+
+    if (depth == 8) {
+        for (uint64_t x = 0; x < width; ++x) {
+            const uint8_t* pixel = rgb_row + x * 3;
+            out[x] = indexed ? PaletteIndex(PackColor(pixel)) : pixel[0];
+        }
+        return;
+    }
+
+    std::memset(out, 0, format_.RowBytes(width));
+
+    const unsigned samples_per_byte = 8 / depth;
+    for (uint64_t x = 0; x < width; ++x) {
+        const uint8_t* pixel = rgb_row + x * 3;
+        const unsigned sample = indexed ? PaletteIndex(PackColor(pixel)) : pixel[0] / gray_divisor;
+        const unsigned shift = 8 - depth * (x % samples_per_byte + 1);
+
+        out[x / samples_per_byte] |= static_cast<uint8_t>(sample << shift);
+    }
+}
+
+bool PixelPacker::CanPack(const uint8_t* rgb_row, uint64_t width) const {
+    if (format_.IsRGB8()) {
+        return true;
+    }
+
+    if (format_.color_type == PNGColorType::Indexed) {
+        for (uint64_t x = 0; x < width; ++x) {
+            if (keys_[PaletteSlot(PackColor(rgb_row + x * 3))] == kEmpty) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const unsigned gray_divisor = 255 / ((1u << format_.bit_depth) - 1);
+    for (uint64_t x = 0; x < width; ++x) {
+        const uint8_t* pixel = rgb_row + x * 3;
+        if (pixel[0] != pixel[1] || pixel[1] != pixel[2] || pixel[0] % gray_divisor != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+PixelFormat ColorReducer::Analyze(const ImageView& image, ColorFilterType color_filter,
+                                  float perlin_noise_scale) {
+    StageTimer timer(EncodeStage::ColorAnalysis);
+    ColorAnalyzer analyzer;
+    const size_t row_bytes = image.width * 3;
+
+    std::vector<uint8_t> row;
+
+    for (uint64_t y = 0; y < image.height && !analyzer.IsTruecolor(); ++y) {
+        analyzer.AddPixels(FilteredRow(image, y, color_filter, perlin_noise_scale, row),
+                           image.width);
+        timer.AddBytesIn(row_bytes);
+    }
+
+    return analyzer.Result();
+}
+
+bool ColorReducer::Fits(const ImageView& image, const std::vector<uint8_t>& rows,
+                        const PixelFormat& format, ColorFilterType color_filter,
+                        float perlin_noise_scale) {
+    if (format.IsRGB8()) {
+        return true;
+    }
+
+    StageTimer timer(EncodeStage::ColorAnalysis);
+    const PixelPacker packer(format);
+    const size_t row_bytes = image.width * 3;
+    std::vector<uint8_t> row;
+
+    for (uint64_t y = 0; y < image.height; ++y) {
+        if (!rows[y]) {
+            continue;
+        }
+
+        timer.AddBytesIn(row_bytes);
+        if (!packer.CanPack(FilteredRow(image, y, color_filter, perlin_noise_scale, row),
+                            image.width)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+std::vector<uint8_t> ColorReducer::Pack(PixelView rgb_data, uint64_t width, uint64_t height,
+                                        const PixelFormat& format) {
+    const PixelPacker packer(format);
+    const size_t row_bytes = format.RowBytes(width);
+    std::vector<uint8_t> packed(row_bytes * height);
+
+    for (uint64_t y = 0; y < height; ++y) {
+        packer.PackRow(rgb_data.data() + y * width * 3, width, packed.data() + y * row_bytes);
+    }
+
+    return packed;
+}
@@ -0,0 +1,195 @@
+// compression_search.cpp
+#include "../include/compression_search.h"
+#include "../include/encode_stats.h"
+#include "../include/zlib_api.h"
+
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+namespace {
+
+// zlib stream and output buffer of one worker, reused by every trial it runs
+class TrialDeflater {
+public:
+    // Deflates data unless the output grows past *limit, which other trials may lower
+    // meanwhile. Returns false when the trial was stopped, else the stream is Output().
+    bool Compress(PixelView data, const CompressionProfile& profile,
+                  const std::atomic<size_t>& limit) {
+        stream_.Reset(profile);
+
+        const size_t bound = stream_.Bound(data.size());
+        if (output_.size() < bound) {
+            output_.resize(bound);
+        }
+
+        size_ = 0;
+        if (!stream_.Deflate(data, output_.data(), bound, CompressionSearch::kCheckInterval,
+                             [&](size_t written) {
+                                 return written > limit.load(std::memory_order_relaxed);
+                             })) {
+            return false;
+        }
+
+        size_ = stream_.Written();
+        return true;
+    }
+
+    PixelView Output() const {
+        return PixelView(output_.data(), size_);
+    }
+
+    std::vector<uint8_t>& Buffer() {
+        return output_;
+    }
+
+private:
+    ZlibStream<ZlibApi> stream_;
+    std::vector<uint8_t> output_;
+    size_t size_ = 0;
+};
+
+class DeflaterSlots {
+public:
+    std::unique_ptr<TrialDeflater> Take() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (free_.empty()) {
+            return std::make_unique<TrialDeflater>();
+        }
+
+        std::unique_ptr<TrialDeflater> deflater = std::move(free_.back());
+        free_.pop_back();
+        return deflater;
+    }
+
+    void Return(std::unique_ptr<TrialDeflater> deflater) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_.push_back(std::move(deflater));
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<TrialDeflater>> free_;
+};
+
+}  // namespace
+
+std::vector<SearchTrial> CompressionSearch::DefaultTrials(const CompressionProfile& base) {
+    return Matrix({PNGFilterStrategy::None, PNGFilterStrategy::Sub, PNGFilterStrategy::Up,
+                   PNGFilterStrategy::Average, PNGFilterStrategy::Paeth,
+                   PNGFilterStrategy::MinSum, PNGFilterStrategy::Entropy},
+                  {9}, {DeflateStrategy::Default, DeflateStrategy::Filtered, DeflateStrategy::RLE},
+                  {8, 9}, base);
+}
+
+std::vector<SearchTrial> CompressionSearch::Matrix(const std::vector<PNGFilterStrategy>& filters,
+                                                   const std::vector<int>& levels,
+                                                   const std::vector<DeflateStrategy>& strategies,
+                                                   const std::vector<int>& mem_levels,
+                                                   const CompressionProfile& base) {
+    std::vector<SearchTrial> trials;
+    trials.reserve(filters.size() * levels.size() * strategies.size() * mem_levels.size());
+
+    for (PNGFilterStrategy filter : filters) {
+        for (int level : levels) {
+            for (DeflateStrategy strategy : strategies) {
+                for (int mem_level : mem_levels) {
+                    SearchTrial trial;
+                    trial.png_filter = filter;
+                    trial.compression = base;
+                    trial.compression.level = level;
+                    trial.compression.strategy = strategy;
+                    trial.compression.mem_level = mem_level;
+                    trials.push_back(trial);
+                }
+            }
+        }
+    }
+
+    return trials;
+}
+
+SearchResult CompressionSearch::Run(const ImageView& image, ColorFilterType color_filter,
+                                    float perlin_noise_scale, const PixelFormat& format,
+                                    const std::vector<SearchTrial>& trials, ThreadPool* pool,
+                                    PNGFilterBuffers& buffers) {
+    if (trials.empty()) {
+        throw std::runtime_error("Compression search needs at least one trial");
+    }
+
+    for (const SearchTrial& trial : trials) {
+        if (trial.compression.backend != DeflateBackendType::Zlib) {
+            throw std::runtime_error("Compression search only supports the zlib backend");
+        }
+        trial.compression.Validate();
+    }
+
+    SearchResult result;
+    result.trials = trials.size();
+
+    std::mutex best_mutex;
+    std::atomic<size_t> best_size{std::numeric_limits<size_t>::max()};
+    size_t best_index = trials.size();
+    std::atomic<size_t> stopped{0};
+    DeflaterSlots slots;
+
+    // Filter strategies in order of first appearance, each filtered once
+    std::vector<bool> done(trials.size(), false);
+    for (size_t first = 0; first < trials.size(); ++first) {
+        if (done[first]) {
+            continue;
+        }
+
+        const PNGFilterStrategy filter = trials[first].png_filter;
+        std::vector<size_t> group;
+        for (size_t i = first; i < trials.size(); ++i) {
+            if (!done[i] && trials[i].png_filter == filter) {
+                group.push_back(i);
+                done[i] = true;
+            }
+        }
+
+        PNGFilter::Apply(image, filter, color_filter, perlin_noise_scale, format, pool, buffers);
+        const PixelView scanlines = buffers.scanlines;
+
+        auto run_trial = [&](size_t k) {
+            const size_t index = group[k];
+            StageTimer timer(EncodeStage::Deflate, scanlines.size());
+            std::unique_ptr<TrialDeflater> deflater = slots.Take();
+
+            if (!deflater->Compress(scanlines, trials[index].compression, best_size)) {
+                stopped.fetch_add(1, std::memory_order_relaxed);
+                slots.Return(std::move(deflater));
+                return;
+            }
+
+            const size_t size = deflater->Output().size();
+            timer.AddBytesOut(size);
+
+            std::lock_guard<std::mutex> lock(best_mutex);
+            if (size < best_size.load(std::memory_order_relaxed) ||
+                (size == best_size.load(std::memory_order_relaxed) && index < best_index)) {
+                // The winner's buffer becomes the result, the deflater keeps the old one
+                deflater->Buffer().resize(size);
+                result.compressed.swap(deflater->Buffer());
+                best_size.store(size, std::memory_order_relaxed);
+                best_index = index;
+            }
+            slots.Return(std::move(deflater));
+        };
+
+        if (pool != nullptr) {
+            pool->ParallelFor(group.size(), run_trial);
+        } else {
+            for (size_t k = 0; k < group.size(); ++k) {
+                run_trial(k);
+            }
+        }
+    }
+
+    result.best = trials[best_index];
+    result.stopped = stopped.load();
+    return result;
+}
@@ -0,0 +1,297 @@
+// crc32.cpp
+#include "../include/crc32.h"
+
+#include <array>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PNG_ENCODER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr uint32_t kPolynomial = 0xEDB88320u;
+
+using SliceTables = std::array<std::array<uint32_t, 256>, 8>;
+
+// tables[0] is the classic byte table, tables[k] advances a byte by k more zero bytes
+constexpr SliceTables MakeSliceTables() {
+    SliceTables tables{};
+
+    for (uint32_t n = 0; n < 256; ++n) {
+        uint32_t c = n;
+
+        for (int k = 0; k < 8; ++k) {
+            c = (c & 1) ? kPolynomial ^ (c >> 1) : c >> 1;
+        }
+
+        tables[0][n] = c;
+    }
+
+    for (uint32_t n = 0; n < 256; ++n) {
+        for (size_t k = 1; k < tables.size(); ++k) {
+            uint32_t prev = tables[k - 1][n];
+            tables[k][n] = (prev >> 8) ^ tables[0][prev & 0xFF];
+        }
+    }
+
+    return tables;
+}
+
+constexpr SliceTables kTables = MakeSliceTables();
+
+// All engines work on the inverted register value, CRC32 applies the final xor
+
+uint32_t UpdateBytewise(uint32_t crc, const uint8_t* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        crc = kTables[0][(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
+uint32_t UpdateSliceBy8(uint32_t crc, const uint8_t* data, size_t size) {
+    if constexpr (std::endian::native == std::endian::little) {
+        while (size >= 8) {
+            uint32_t one;
+            uint32_t two;
+            std::memcpy(&one, data, 4);
+            std::memcpy(&two, data + 4, 4);
+            one ^= crc;
+
+            crc = kTables[7][one & 0xFF] ^ kTables[6][(one >> 8) & 0xFF] ^
+                  kTables[5][(one >> 16) & 0xFF] ^ kTables[4][one >> 24] ^
+                  kTables[3][two & 0xFF] ^ kTables[2][(two >> 8) & 0xFF] ^
+                  kTables[1][(two >> 16) & 0xFF] ^ kTables[0][two >> 24];
+
+            data += 8;
+            size -= 8;
+        }
+    }
+
+    return UpdateBytewise(crc, data, size);
+}
+
+#ifdef PNG_ENCODER_X86
+
+// Carry-less multiplication folding from Intel's "Fast CRC Computation for Generic
+// Polynomials Using PCLMULQDQ Instruction", bit-reflected constants for 0xEDB88320.
+// Folds four 128-bit lanes at a time, then reduces with Barrett. Needs size >= 64
+// and a multiple of 16; the caller hands the rest to slice-by-8.
+__attribute__((target("pclmul,sse4.1"))) uint32_t FoldPCLMUL(uint32_t crc, const uint8_t* data,
+                                                              size_t size) {
+    const __m128i k1k2 = _mm_set_epi64x(0x01C6E41596, 0x0154442BD4);
+    const __m128i k3k4 = _mm_set_epi64x(0x00CCAA009E, 0x01751997D0);
+    const __m128i k5k0 = _mm_set_epi64x(0x0000000000, 0x0163CD6124);
+    const __m128i poly = _mm_set_epi64x(0x01F7011641, 0x01DB710641);
+    const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+    __m128i x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x00));
+    __m128i x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x10));
+    __m128i x3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x20));
+    __m128i x4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x30));
+
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(crc)));
+
+    data += 64;
+    size -= 64;
+
+    while (size >= 64) {
+        __m128i x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+        __m128i x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+        __m128i x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+        __m128i x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5),
+                           _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6),
+                           _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7),
+                           _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8),
+                           _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x30)));
+
+        data += 64;
+        size -= 64;
+    }
+
+    // Fold the four lanes into one
+    for (__m128i next : {x2, x3, x4}) {
+        __m128i low = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, next), low);
+    }
+
+    while (size >= 16) {
+        __m128i low = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+        __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, next), low);
+
+        data += 16;
+        size -= 16;
+    }
+
+    // 128 -> 64 bits
+    x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, mask32);
+    x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bits
+    x2 = _mm_and_si128(x1, mask32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+    x2 = _mm_and_si128(x2, mask32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+}
+
+uint32_t UpdatePCLMUL(uint32_t crc, const uint8_t* data, size_t size) {
+    if (size >= 64) {
+        const size_t folded = size & ~size_t{15};
+        crc = FoldPCLMUL(crc, data, folded);
+        data += folded;
+        size -= folded;
+    }
+
+    return UpdateSliceBy8(crc, data, size);
+}
+
+#endif  // PNG_ENCODER_X86
+
+using UpdateFunction = uint32_t (*)(uint32_t, const uint8_t*, size_t);
+
+UpdateFunction EngineFunction(CRC32Engine engine) {
+    switch (engine) {
+        case CRC32Engine::Bytewise:
+            return UpdateBytewise;
+#ifdef PNG_ENCODER_X86
+        case CRC32Engine::PCLMUL:
+            return UpdatePCLMUL;
+#endif
+        default:
+            return UpdateSliceBy8;
+    }
+}
+
+UpdateFunction ActiveFunction() {
+    static const UpdateFunction function = EngineFunction(CRC32::ActiveEngine());
+    return function;
+}
+
+// Polynomial arithmetic modulo the CRC polynomial, in the reflected bit order
+constexpr uint32_t MultiplyModP(uint32_t a, uint32_t b) {
+    uint32_t m = 1u << 31;
+    uint32_t product = 0;
+
+    for (;;) {
+        if (a & m) {
+            product ^= b;
+            if ((a & (m - 1)) == 0) {
+                break;
+            }
+        }
+
+        m >>= 1;
+        b = (b & 1) ? (b >> 1) ^ kPolynomial : b >> 1;
+    }
+
+    return product;
+}
+
+// kPowers[k] = x^(2^k) mod P; the sequence repeats with period 32
+constexpr std::array<uint32_t, 32> MakePowers() {
+    std::array<uint32_t, 32> powers{};
+    powers[0] = 1u << 30;  // x^1
+
+    for (size_t k = 1; k < powers.size(); ++k) {
+        powers[k] = MultiplyModP(powers[k - 1], powers[k - 1]);
+    }
+
+    return powers;
+}
+
+constexpr std::array<uint32_t, 32> kPowers = MakePowers();
+
+// x^(8 * bytes) mod P
+uint32_t ZeroBytesOperator(uint64_t bytes) {
+    uint32_t p = 1u << 31;  // x^0
+    size_t k = 3;
+
+    while (bytes != 0) {
+        if (bytes & 1) {
+            p = MultiplyModP(kPowers[k & 31], p);
+        }
+
+        bytes >>= 1;
+        ++k;
+    }
+
+    return p;
+}
+
+}  // namespace
+
+CRC32::CRC32() : state_(0xFFFFFFFFu) {
+}
+
+void CRC32::Update(const uint8_t* data, size_t size) {
+    state_ = ActiveFunction()(state_, data, size);
+}
+
+uint32_t CRC32::Value() const {
+    return state_ ^ 0xFFFFFFFFu;
+}
+
+void CRC32::Reset() {
+    state_ = 0xFFFFFFFFu;
+}
+
+uint32_t CRC32::Compute(const uint8_t* data, size_t size) {
+    return ActiveFunction()(0xFFFFFFFFu, data, size) ^ 0xFFFFFFFFu;
+}
+
+uint32_t CRC32::Compute(CRC32Engine engine, const uint8_t* data, size_t size) {
+    if (!IsSupported(engine)) {
+        throw std::runtime_error("CRC-32 engine is not supported by this CPU");
+    }
+
+    return EngineFunction(engine)(0xFFFFFFFFu, data, size) ^ 0xFFFFFFFFu;
+}
+
+uint32_t CRC32::Combine(uint32_t crc1, uint32_t crc2, uint64_t size2) {
+    return MultiplyModP(ZeroBytesOperator(size2), crc1) ^ crc2;
+}
+
+bool CRC32::IsSupported(CRC32Engine engine) {
+    switch (engine) {
+        case CRC32Engine::Bytewise:
+        case CRC32Engine::SliceBy8:
+            return true;
+#ifdef PNG_ENCODER_X86
+        case CRC32Engine::PCLMUL:
+            return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+#endif
+        default:
+            return false;
+    }
+}
+
+CRC32Engine CRC32::ActiveEngine() {
+    static const CRC32Engine engine =
+        IsSupported(CRC32Engine::PCLMUL) ? CRC32Engine::PCLMUL : CRC32Engine::SliceBy8;
+    return engine;
+}
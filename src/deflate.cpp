@@ -1,19 +1,192 @@
 // deflate.cpp
 #include "../include/deflate.h"
+#include "../include/deflate_backend.h"
+#include "../include/encode_stats.h"
+
 #include <zlib.h>
+#include <algorithm>
+#include <cctype>
+#include <limits>
 #include <stdexcept>
 
-std::vector<uint8_t> DeflateCompressor::Compress(const std::vector<uint8_t>& data) {
-    uLongf compressed_size = compressBound(data.size());
-    std::vector<uint8_t> compressed_data(compressed_size);
+namespace {
+
+std::string ToLower(const std::string& name) {
+    std::string lower_name;
+    lower_name.reserve(name.size());
+    std::transform(name.begin(), name.end(), std::back_inserter(lower_name),
+                   [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+    return lower_name;
+}
+
+}  // namespace
+
+CompressionProfile CompressionProfile::Fast() {
+    return {1, DeflateStrategy::RLE, 15, 9};
+}
+
+CompressionProfile CompressionProfile::Balanced() {
+    return {6, DeflateStrategy::Filtered, 15, 9};
+}
+
+CompressionProfile CompressionProfile::Max() {
+    return {9, DeflateStrategy::Default, 15, 8};
+}
+
+CompressionProfile CompressionProfile::Parse(const std::string& preset_name) {
+    std::string lower_name = ToLower(preset_name);
+
+    if (lower_name == "fast") {
+        return Fast();
+    }
+
+    if (lower_name == "balanced") {
+        return Balanced();
+    }
+
+    if (lower_name == "max") {
+        return Max();
+    }
+
+    throw std::runtime_error("Unknown compression preset: " + preset_name);
+}
 
-    int ret = ::compress2(compressed_data.data(), &compressed_size, data.data(), data.size(),
-                          Z_BEST_COMPRESSION);
+DeflateStrategy CompressionProfile::ParseStrategy(const std::string& strategy_name) {
+    std::string lower_name = ToLower(strategy_name);
+
+    if (lower_name == "default") {
+        return DeflateStrategy::Default;
+    }
+
+    if (lower_name == "filtered") {
+        return DeflateStrategy::Filtered;
+    }
+
+    if (lower_name == "huffman") {
+        return DeflateStrategy::HuffmanOnly;
+    }
+
+    if (lower_name == "rle") {
+        return DeflateStrategy::RLE;
+    }
+
+    if (lower_name == "fixed") {
+        return DeflateStrategy::Fixed;
+    }
+
+    throw std::runtime_error("Unknown deflate strategy: " + strategy_name);
+}
+
+DeflateBackendType CompressionProfile::ParseBackend(const std::string& backend_name) {
+    std::string lower_name = ToLower(backend_name);
+
+    if (lower_name == "zlib") {
+        return DeflateBackendType::Zlib;
+    }
 
-    if (ret != Z_OK) {
-        throw std::runtime_error("Failed to compress data with zlib");
+    if (lower_name == "libdeflate") {
+        return DeflateBackendType::Libdeflate;
     }
 
-    compressed_data.resize(compressed_size);
+    if (lower_name == "archival") {
+        return DeflateBackendType::Archival;
+    }
+
+    throw std::runtime_error("Unknown deflate backend: " + backend_name);
+}
+
+void CompressionProfile::Validate() const {
+    if (!DeflateBackend::IsAvailable(backend)) {
+        throw std::runtime_error(std::string("Deflate backend '") + DeflateBackend::Name(backend) +
+                                 "' is not built in");
+    }
+
+    if (backend == DeflateBackendType::Libdeflate) {
+        if (level < 0 || level > 12) {
+            throw std::runtime_error("libdeflate compression level must be in [0, 12]");
+        }
+    } else if (backend == DeflateBackendType::Archival) {
+        if (iterations < 1) {
+            throw std::runtime_error("Archival deflate needs at least one iteration");
+        }
+    } else if (level < 0 || level > 9) {
+        throw std::runtime_error("Compression level must be in [0, 9]");
+    }
+
+    if (window_bits < 9 || window_bits > 15) {
+        throw std::runtime_error("Deflate window bits must be in [9, 15]");
+    }
+
+    if (mem_level < 1 || mem_level > 9) {
+        throw std::runtime_error("Deflate memLevel must be in [1, 9]");
+    }
+}
+
+int CompressionProfile::ZlibStrategy() const {
+    switch (strategy) {
+        case DeflateStrategy::Filtered:
+            return Z_FILTERED;
+        case DeflateStrategy::HuffmanOnly:
+            return Z_HUFFMAN_ONLY;
+        case DeflateStrategy::RLE:
+            return Z_RLE;
+        case DeflateStrategy::Fixed:
+            return Z_FIXED;
+        default:
+            return Z_DEFAULT_STRATEGY;
+    }
+}
+
+std::vector<uint8_t> DeflateCompressor::Compress(PixelView data, const CompressionProfile& profile) {
+    profile.Validate();
+    StageTimer timer(EncodeStage::Deflate, data.size());
+
+    std::unique_ptr<DeflateBackend> backend = DeflateBackend::Create(profile.backend);
+    std::vector<uint8_t> compressed_data(backend->Bound(data.size(), profile));
+
+    compressed_data.resize(
+        backend->Compress(data, profile, compressed_data.data(), compressed_data.size()));
+    timer.AddBytesOut(compressed_data.size());
     return compressed_data;
-}
\ No newline at end of file
+}
+
+ReusableDeflater::ReusableDeflater() : backend_type_(DeflateBackendType::Zlib) {
+}
+
+ReusableDeflater::~ReusableDeflater() = default;
+
+PixelView ReusableDeflater::Compress(PixelView data, const CompressionProfile& profile) {
+    profile.Validate();
+    StageTimer timer(EncodeStage::Deflate, data.size());
+
+    if (!backend_ || backend_type_ != profile.backend) {
+        backend_ = DeflateBackend::Create(profile.backend);
+        backend_type_ = profile.backend;
+    }
+
+    const size_t bound = backend_->Bound(data.size(), profile);
+    if (output_.size() < bound) {
+        output_.resize(bound);
+    }
+
+    size_t size = 0;
+    try {
+        size = backend_->Compress(data, profile, output_.data(), output_.size());
+    } catch (...) {
+        // The backend state is unknown after a failure, start over next time
+        backend_.reset();
+        throw;
+    }
+
+    timer.AddBytesOut(size);
+    return PixelView(output_.data(), size);
+}
+
+size_t ReusableDeflater::Capacity() const {
+    return output_.capacity();
+}
+
+void ReusableDeflater::Release() {
+    backend_.reset();
+    std::vector<uint8_t>().swap(output_);
+}
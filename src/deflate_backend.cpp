@@ -0,0 +1,63 @@
+// deflate_backend.cpp
+#include "../include/deflate_backend.h"
+#include "../include/zlib_api.h"
+
+#include <stdexcept>
+#include <string>
+
+std::unique_ptr<DeflateBackend> DeflateBackend::CreateZlib() {
+    return std::make_unique<ZlibStreamBackend<ZlibApi>>();
+}
+
+#ifndef PNG_ENCODER_HAVE_LIBDEFLATE
+std::unique_ptr<DeflateBackend> DeflateBackend::CreateLibdeflate() {
+    return nullptr;
+}
+#endif
+
+std::unique_ptr<DeflateBackend> DeflateBackend::Create(DeflateBackendType type) {
+    std::unique_ptr<DeflateBackend> backend;
+
+    switch (type) {
+        case DeflateBackendType::Libdeflate:
+            backend = CreateLibdeflate();
+            break;
+        case DeflateBackendType::Archival:
+            backend = CreateArchival();
+            break;
+        default:
+            backend = CreateZlib();
+            break;
+    }
+
+    if (!backend) {
+        throw std::runtime_error(std::string("Deflate backend '") + Name(type) +
+                                 "' is not built in");
+    }
+
+    return backend;
+}
+
+bool DeflateBackend::IsAvailable(DeflateBackendType type) {
+    switch (type) {
+        case DeflateBackendType::Libdeflate:
+#ifdef PNG_ENCODER_HAVE_LIBDEFLATE
+            return true;
+#else
+            return false;
+#endif
+        default:
+            return true;
+    }
+}
+
+const char* DeflateBackend::Name(DeflateBackendType type) {
+    switch (type) {
+        case DeflateBackendType::Libdeflate:
+            return "libdeflate";
+        case DeflateBackendType::Archival:
+            return "archival";
+        default:
+            return "zlib";
+    }
+}
@@ -0,0 +1,34 @@
+// deflate_backend_archival.cpp
+#include "../include/archival_deflate.h"
+#include "../include/deflate_backend.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+// Runs the archival compressor on the calling thread; the encoder calls
+// ArchivalDeflateCompressor directly to spread the blocks over its pool
+class ArchivalBackend : public DeflateBackend {
+public:
+    size_t Bound(size_t size, const CompressionProfile&) override {
+        return ArchivalDeflateCompressor::Bound(size);
+    }
+
+    size_t Compress(PixelView data, const CompressionProfile& profile, uint8_t* out,
+                    size_t capacity) override {
+        std::vector<uint8_t> compressed = ArchivalDeflateCompressor::Compress(data, profile);
+        if (compressed.size() > capacity) {
+            throw std::runtime_error("Archival deflate output exceeds the buffer");
+        }
+
+        std::memcpy(out, compressed.data(), compressed.size());
+        return compressed.size();
+    }
+};
+
+}  // namespace
+
+std::unique_ptr<DeflateBackend> DeflateBackend::CreateArchival() {
+    return std::make_unique<ArchivalBackend>();
+}
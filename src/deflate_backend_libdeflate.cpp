@@ -0,0 +1,61 @@
+// deflate_backend_libdeflate.cpp
+#include "../include/deflate_backend.h"
+
+#include <libdeflate.h>
+#include <array>
+#include <stdexcept>
+
+namespace {
+
+// libdeflate compresses the whole buffer in one call and has no strategy, window or
+// memLevel knobs; a compressor is allocated per level on first use and kept
+class LibdeflateBackend : public DeflateBackend {
+public:
+    LibdeflateBackend() : compressors_{} {
+    }
+
+    ~LibdeflateBackend() override {
+        for (libdeflate_compressor* compressor : compressors_) {
+            if (compressor != nullptr) {
+                libdeflate_free_compressor(compressor);
+            }
+        }
+    }
+
+    size_t Bound(size_t size, const CompressionProfile& profile) override {
+        return libdeflate_zlib_compress_bound(Compressor(profile.level), size);
+    }
+
+    size_t Compress(PixelView data, const CompressionProfile& profile, uint8_t* out,
+                    size_t capacity) override {
+        const size_t size = libdeflate_zlib_compress(Compressor(profile.level), data.data(),
+                                                     data.size(), out, capacity);
+        if (size == 0) {
+            throw std::runtime_error("Failed to compress data with libdeflate");
+        }
+
+        return size;
+    }
+
+private:
+    libdeflate_compressor* Compressor(int level) {
+        libdeflate_compressor*& compressor = compressors_.at(level);
+
+        if (compressor == nullptr) {
+            compressor = libdeflate_alloc_compressor(level);
+            if (compressor == nullptr) {
+                throw std::runtime_error("Failed to allocate a libdeflate compressor");
+            }
+        }
+
+        return compressor;
+    }
+
+    std::array<libdeflate_compressor*, 13> compressors_;
+};
+
+}  // namespace
+
+std::unique_ptr<DeflateBackend> DeflateBackend::CreateLibdeflate() {
+    return std::make_unique<LibdeflateBackend>();
+}
@@ -0,0 +1,215 @@
+// encode_cache.cpp
+#include "../include/encode_cache.h"
+#include "../include/xxhash64.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+namespace fs = std::filesystem;
+
+// Bump when the encoder writes different bytes for the same options
+constexpr const char* kFormatVersion = "png_encoder cache 1";
+
+constexpr const char* kEntryExtension = ".png";
+
+std::string Hex(uint64_t value) {
+    std::ostringstream out;
+    out << std::hex << std::setw(16) << std::setfill('0') << value;
+    return out.str();
+}
+
+// Everything that changes the PNG bytes of a job, besides the pixels
+std::string DescribeOptions(const EncodeJob& job) {
+    const EncodeOptions& options = job.options;
+    const CompressionProfile& compression = options.compression;
+
+    std::ostringstream out;
+    out << std::setprecision(9) << kFormatVersion << ";w=" << job.width << ";h=" << job.height
+        << ";color_filter=" << static_cast<int>(options.color_filter)
+        << ";perlin=" << options.perlin_strength
+        << ";png_filter=" << static_cast<int>(options.png_filter)
+        << ";level=" << compression.level
+        << ";strategy=" << static_cast<int>(compression.strategy)
+        << ";window_bits=" << compression.window_bits
+        << ";mem_level=" << compression.mem_level
+        << ";backend=" << static_cast<int>(compression.backend)
+        << ";iterations=" << compression.iterations
+        // More than one thread switches zlib to block-parallel deflate; the block layout
+        // does not depend on the thread count
+        << ";parallel=" << (options.threads > 1)
+        << ";idat=" << options.idat_size << ";reduce=" << options.reduce_colors
+        << ";search=" << options.search
+        << ";interlace=" << static_cast<int>(options.interlace);
+    return out.str();
+}
+
+// Entries of directory with their size and age, ignoring files being written
+struct Entry {
+    fs::path path;
+    uint64_t size;
+    fs::file_time_type time;
+};
+
+std::vector<Entry> ListEntries(const std::string& directory) {
+    std::vector<Entry> entries;
+    std::error_code error;
+
+    for (const fs::directory_entry& file : fs::directory_iterator(directory, error)) {
+        std::error_code file_error;
+        if (file.path().extension() != kEntryExtension || !file.is_regular_file(file_error)) {
+            continue;
+        }
+
+        const uint64_t size = file.file_size(file_error);
+        const fs::file_time_type time = file.last_write_time(file_error);
+        if (!file_error) {
+            entries.push_back({file.path(), size, time});
+        }
+    }
+
+    return entries;
+}
+
+}  // namespace
+
+EncodeCache::EncodeCache(const std::string& directory, uint64_t max_bytes)
+    : directory_(directory), max_bytes_(max_bytes) {
+    std::error_code error;
+    fs::create_directories(directory_, error);
+    if (!fs::is_directory(directory_)) {
+        throw std::runtime_error("Cannot create cache directory: " + directory_);
+    }
+
+    uint64_t bytes = 0;
+    for (const Entry& entry : ListEntries(directory_)) {
+        bytes += entry.size;
+    }
+    bytes_.store(bytes);
+}
+
+std::string EncodeCache::Key(const EncodeJob& job, PixelView raw) {
+    const std::string options = DescribeOptions(job);
+    return Hex(XXHash64::Compute(raw.data(), raw.size())) +
+           Hex(XXHash64::Compute(reinterpret_cast<const uint8_t*>(options.data()),
+                                 options.size()));
+}
+
+bool EncodeCache::IsCacheable(const EncodeJob& job) {
+    return !job.options.streaming && job.options.sizes.empty() && job.output_path != "-";
+}
+
+bool EncodeCache::Fetch(const std::string& key, const std::string& output_path) {
+    const fs::path entry = EntryPath(key);
+    std::error_code error;
+
+    if (!fs::is_regular_file(entry, error)) {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // A link replaces the output, it never writes through an existing file
+    fs::remove(output_path, error);
+    fs::create_hard_link(entry, output_path, error);
+    if (error) {
+        error.clear();
+        fs::copy_file(entry, output_path, fs::copy_options::overwrite_existing, error);
+    }
+
+    if (error) {
+        // Evicted by another process meanwhile, or the output is not writable
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Marks the entry as recently used
+    fs::last_write_time(entry, fs::file_time_type::clock::now(), error);
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void EncodeCache::Store(const std::string& key, const std::string& output_path) {
+    const fs::path entry = EntryPath(key);
+    // Written under a unique name and renamed, so readers never see a partial entry
+    std::ostringstream temporary_name;
+    temporary_name << key << '.' << ::getpid() << '.'
+                   << next_temporary_.fetch_add(1, std::memory_order_relaxed) << ".tmp";
+    const fs::path temporary = fs::path(directory_) / temporary_name.str();
+
+    std::error_code error;
+    fs::copy_file(output_path, temporary, fs::copy_options::overwrite_existing, error);
+    if (!error) {
+        fs::permissions(temporary, fs::perms::owner_read | fs::perms::group_read |
+                                       fs::perms::others_read,
+                        error);
+    }
+    if (!error) {
+        fs::rename(temporary, entry, error);
+    }
+
+    if (error) {
+        fs::remove(temporary, error);
+        throw std::runtime_error("Cannot store " + output_path + " in the cache: " +
+                                 error.message());
+    }
+
+    stores_.fetch_add(1, std::memory_order_relaxed);
+    bytes_.fetch_add(fs::file_size(entry, error), std::memory_order_relaxed);
+    if (bytes_.load(std::memory_order_relaxed) > max_bytes_) {
+        Evict();
+    }
+}
+
+CacheStats EncodeCache::Stats() const {
+    CacheStats stats;
+    stats.hits = hits_.load();
+    stats.misses = misses_.load();
+    stats.stores = stores_.load();
+    stats.evictions = evictions_.load();
+    stats.bytes = bytes_.load();
+    return stats;
+}
+
+const std::string& EncodeCache::Directory() const {
+    return directory_;
+}
+
+std::string EncodeCache::EntryPath(const std::string& key) const {
+    return (fs::path(directory_) / (key + kEntryExtension)).string();
+}
+
+void EncodeCache::Evict() {
+    std::lock_guard<std::mutex> lock(evict_mutex_);
+
+    // Other processes may have added or removed entries, so the directory is the truth
+    std::vector<Entry> entries = ListEntries(directory_);
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry& a, const Entry& b) { return a.time < b.time; });
+
+    uint64_t bytes = 0;
+    for (const Entry& entry : entries) {
+        bytes += entry.size;
+    }
+
+    for (const Entry& entry : entries) {
+        if (bytes <= max_bytes_) {
+            break;
+        }
+
+        std::error_code error;
+        if (fs::remove(entry.path, error)) {
+            bytes -= entry.size;
+            evictions_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    bytes_.store(bytes, std::memory_order_relaxed);
+}
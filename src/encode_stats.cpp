@@ -0,0 +1,149 @@
+// encode_stats.cpp
+#include "../include/encode_stats.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+constexpr EncodeStage kStages[kEncodeStageCount] = {
+    EncodeStage::Load,      EncodeStage::Resize,  EncodeStage::ColorAnalysis,
+    EncodeStage::ColorFilter, EncodeStage::PNGFilter, EncodeStage::Deflate,
+    EncodeStage::CRC,       EncodeStage::Write,
+};
+
+double MegabytesPerSecond(uint64_t bytes, double seconds) {
+    return seconds > 0.0 ? bytes / 1e6 / seconds : 0.0;
+}
+
+}  // namespace
+
+const char* EncodeStats::StageName(EncodeStage stage) {
+    switch (stage) {
+        case EncodeStage::Load:
+            return "load";
+        case EncodeStage::Resize:
+            return "resize";
+        case EncodeStage::ColorAnalysis:
+            return "color_analysis";
+        case EncodeStage::ColorFilter:
+            return "color_filter";
+        case EncodeStage::PNGFilter:
+            return "png_filter";
+        case EncodeStage::Deflate:
+            return "deflate";
+        case EncodeStage::CRC:
+            return "crc";
+        default:
+            return "write";
+    }
+}
+
+std::string EncodeStats::ToText() const {
+    uint64_t total_nanoseconds = 0;
+    for (const EncodeStageStats& stage : stages) {
+        total_nanoseconds += stage.nanoseconds;
+    }
+
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2);
+    out << std::left << std::setw(16) << "stage" << std::right << std::setw(8) << "calls"
+        << std::setw(12) << "ms" << std::setw(8) << "%" << std::setw(14) << "bytes in"
+        << std::setw(14) << "bytes out" << std::setw(10) << "MB/s" << '\n';
+
+    for (EncodeStage stage : kStages) {
+        const EncodeStageStats& stats = Stage(stage);
+        const double share =
+            total_nanoseconds != 0 ? 100.0 * stats.nanoseconds / total_nanoseconds : 0.0;
+
+        out << std::left << std::setw(16) << StageName(stage) << std::right << std::setw(8)
+            << stats.calls << std::setw(12) << stats.Seconds() * 1000.0 << std::setw(8) << share
+            << std::setw(14) << stats.bytes_in << std::setw(14) << stats.bytes_out
+            << std::setw(10)
+            << MegabytesPerSecond(std::max(stats.bytes_in, stats.bytes_out), stats.Seconds())
+            << '\n';
+    }
+
+    out << "wall " << wall_seconds * 1000.0 << " ms, stages " << total_nanoseconds / 1e6
+        << " ms over all threads, " << allocations << " allocations (" << allocated_bytes
+        << " bytes)\n";
+    return out.str();
+}
+
+std::string EncodeStats::ToJSON() const {
+    std::ostringstream out;
+    out << std::setprecision(9);
+    out << "{\"wall_seconds\":" << wall_seconds << ",\"allocations\":" << allocations
+        << ",\"allocated_bytes\":" << allocated_bytes << ",\"stages\":{";
+
+    for (size_t i = 0; i < kEncodeStageCount; ++i) {
+        const EncodeStageStats& stats = Stage(kStages[i]);
+
+        out << (i != 0 ? "," : "") << '"' << StageName(kStages[i]) << "\":{\"calls\":"
+            << stats.calls << ",\"seconds\":" << stats.Seconds()
+            << ",\"bytes_in\":" << stats.bytes_in << ",\"bytes_out\":" << stats.bytes_out << '}';
+    }
+
+    out << "}}";
+    return out.str();
+}
+
+StatsCollector::StatsCollector() : start_(std::chrono::steady_clock::now()) {
+}
+
+void StatsCollector::AddStage(EncodeStage stage, uint64_t nanoseconds, uint64_t bytes_in,
+                              uint64_t bytes_out) {
+    AtomicStage& counters = stages_[static_cast<size_t>(stage)];
+
+    counters.calls.fetch_add(1, std::memory_order_relaxed);
+    counters.nanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+    counters.bytes_in.fetch_add(bytes_in, std::memory_order_relaxed);
+    counters.bytes_out.fetch_add(bytes_out, std::memory_order_relaxed);
+}
+
+void StatsCollector::AddAllocation(size_t bytes) {
+    allocations_.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+EncodeStats StatsCollector::Snapshot() const {
+    EncodeStats stats;
+
+    for (size_t i = 0; i < kEncodeStageCount; ++i) {
+        stats.stages[i].calls = stages_[i].calls.load(std::memory_order_relaxed);
+        stats.stages[i].nanoseconds = stages_[i].nanoseconds.load(std::memory_order_relaxed);
+        stats.stages[i].bytes_in = stages_[i].bytes_in.load(std::memory_order_relaxed);
+        stats.stages[i].bytes_out = stages_[i].bytes_out.load(std::memory_order_relaxed);
+    }
+
+    stats.allocations = allocations_.load(std::memory_order_relaxed);
+    stats.allocated_bytes = allocated_bytes_.load(std::memory_order_relaxed);
+    stats.wall_seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    return stats;
+}
+
+#ifdef PNG_ENCODER_STATS
+void StageTimer::Start(EncodeStage stage, uint64_t bytes_in) {
+    stage_ = stage;
+    bytes_in_ = bytes_in;
+    parent_ = innermost_;
+    innermost_ = this;
+    start_ = std::chrono::steady_clock::now();
+}
+
+void StageTimer::Stop() {
+    const uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                 std::chrono::steady_clock::now() - start_)
+                                 .count();
+
+    innermost_ = parent_;
+    if (parent_ != nullptr) {
+        parent_->nested_nanoseconds_ += elapsed;
+    }
+
+    const uint64_t own = elapsed > nested_nanoseconds_ ? elapsed - nested_nanoseconds_ : 0;
+    collector_->AddStage(stage_, own, bytes_in_, bytes_out_);
+}
+#endif
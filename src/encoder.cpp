@@ -0,0 +1,423 @@
+// encoder.cpp
+#include "../include/encoder.h"
+#include "../include/archival_deflate.h"
+#include "../include/color_reduction.h"
+#include "../include/compression_search.h"
+#include "../include/encode_cache.h"
+#include "../include/encoder_context.h"
+#include "../include/image_loader.h"
+#include "../include/output_sink.h"
+#include "../include/parallel_deflate.h"
+#include "../include/png_stream_encoder.h"
+#include "../include/png_writer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <memory>
+#include <stdexcept>
+
+#include <unistd.h>
+
+namespace {
+
+// Matches "--name=value" and stores the value
+bool TakeOption(const std::string& arg, const std::string& name, std::string& value) {
+    const std::string prefix = "--" + name + "=";
+
+    if (arg.rfind(prefix, 0) != 0) {
+        return false;
+    }
+
+    value = arg.substr(prefix.size());
+    return true;
+}
+
+PNGInterlace ParseInterlace(const std::string& name) {
+    if (name == "none") {
+        return PNGInterlace::None;
+    }
+    if (name == "adam7") {
+        return PNGInterlace::Adam7;
+    }
+
+    throw std::runtime_error("Unknown interlace method: " + name);
+}
+
+// Caller buffers reach Encode without ImageLoader, so their layout is checked here
+void ValidateImage(const ImageView& image) {
+    if (image.width == 0 || image.height == 0) {
+        throw std::runtime_error("Image dimensions must be positive!");
+    }
+    if (image.data == nullptr) {
+        throw std::runtime_error("Image pixels are missing!");
+    }
+    if (image.stride < image.width * 3) {
+        throw std::runtime_error("Row stride is shorter than a row of W*3 bytes!");
+    }
+}
+
+std::unique_ptr<OutputSink> OpenOutput(const std::string& path) {
+    if (path == "-") {
+        return std::make_unique<FileDescriptorSink>(STDOUT_FILENO);
+    }
+
+    return std::make_unique<FileSink>(path);
+}
+
+}  // namespace
+
+const char* PNGEncoder::OptionsHelp() {
+    return "  --png-filter=<none|sub|up|average|paeth|minsum|entropy>  (default: minsum)\n"
+           "  --threads=<N>  worker threads for compression (default: all cores)\n"
+           "  --stream       encode row by row with memory bounded by the image width\n"
+           "  --idat-size=<KiB>  largest IDAT chunk (default: 1024)\n"
+           "  --color-type=<auto|rgb>  auto stores gray or palette images in the smallest\n"
+           "                 lossless format, rgb always writes 8-bit RGB (default: auto)\n"
+           "  --compression=<fast|balanced|max>  deflate preset (default: max)\n"
+           "  --level=<0-9> --strategy=<default|filtered|huffman|rle|fixed>\n"
+           "  --window-bits=<9-15> --mem-level=<1-9>  override the preset\n"
+           "  --deflate=<zlib|libdeflate|archival>  deflate library, if built in\n"
+           "                 (default: zlib); libdeflate takes --level up to 12 and\n"
+           "                 compresses on one thread; archival is an optimal parser,\n"
+           "                 much slower than zlib and 3-8% smaller\n"
+           "  --iterations=<N>  optimal parse rounds of --deflate=archival (default: 15)\n"
+           "  --sizes=<1/N|<W>w,...>  also write downscaled copies as <name>-<W>x<H>.png,\n"
+           "                 e.g. --sizes=1/2,1/4,320w; the input is read once\n"
+           "  --resize=<box|bilinear>  downscaling filter for --sizes (default: box)\n"
+           "  --search       try every PNG filter with zlib strategies default, filtered and\n"
+           "                 rle and memLevel 8 and 9, keep the smallest (slow)\n"
+           "  --interlace[=<none|adam7>]  Adam7 interlacing for progressive display; the\n"
+           "                 seven passes are filtered in parallel (default: none)\n";
+}
+
+EncodeOptions PNGEncoder::ParseOptions(const std::vector<std::string>& args,
+                                       std::vector<std::string>& positional) {
+    std::string png_filter_option = "minsum";
+    std::string threads_option = "1";
+    std::string compression_option = "max";
+    std::string level_option;
+    std::string strategy_option;
+    std::string window_bits_option;
+    std::string mem_level_option;
+    std::string iterations_option;
+    std::string idat_size_option;
+    std::string color_type_option = "auto";
+    std::string deflate_option = "zlib";
+    std::string sizes_option;
+    std::string resize_option = "box";
+    std::string interlace_option = "none";
+
+    EncodeOptions options;
+
+    for (const std::string& arg : args) {
+        if (TakeOption(arg, "png-filter", png_filter_option) ||
+            TakeOption(arg, "threads", threads_option) ||
+            TakeOption(arg, "compression", compression_option) ||
+            TakeOption(arg, "level", level_option) ||
+            TakeOption(arg, "strategy", strategy_option) ||
+            TakeOption(arg, "window-bits", window_bits_option) ||
+            TakeOption(arg, "mem-level", mem_level_option) ||
+            TakeOption(arg, "iterations", iterations_option) ||
+            TakeOption(arg, "idat-size", idat_size_option) ||
+            TakeOption(arg, "color-type", color_type_option) ||
+            TakeOption(arg, "deflate", deflate_option) ||
+            TakeOption(arg, "sizes", sizes_option) ||
+            TakeOption(arg, "resize", resize_option) ||
+            TakeOption(arg, "interlace", interlace_option)) {
+            continue;
+        }
+
+        if (arg == "--stream") {
+            options.streaming = true;
+            continue;
+        }
+
+        if (arg == "--search") {
+            options.search = true;
+            continue;
+        }
+
+        if (arg == "--interlace") {
+            interlace_option = "adam7";
+            continue;
+        }
+
+        if (arg.rfind("--", 0) == 0) {
+            throw std::runtime_error("Unknown option '" + arg + "'");
+        }
+
+        positional.push_back(arg);
+    }
+
+    options.png_filter = PNGFilter::Parse(png_filter_option);
+    options.threads = std::stoull(threads_option);
+
+    if (color_type_option != "auto" && color_type_option != "rgb") {
+        throw std::runtime_error("Unknown color type: " + color_type_option);
+    }
+    options.reduce_colors = color_type_option == "auto";
+
+    options.interlace = ParseInterlace(interlace_option);
+    if (options.interlace != PNGInterlace::None && options.streaming) {
+        throw std::runtime_error("--interlace cannot be combined with --stream");
+    }
+
+    options.sizes = OutputSize::ParseList(sizes_option);
+    options.resize_filter = ImageResizer::ParseFilter(resize_option);
+    if (!options.sizes.empty() && options.streaming) {
+        throw std::runtime_error("--sizes cannot be combined with --stream");
+    }
+
+    if (!idat_size_option.empty()) {
+        options.idat_size = std::stoull(idat_size_option) * 1024;
+
+        if (options.idat_size == 0 || options.idat_size > PNGWriter::kMaxChunkSize) {
+            throw std::runtime_error("IDAT size must be between 1 KiB and 2 GiB");
+        }
+    }
+
+    // The preset comes first, explicit parameters override it regardless of their order
+    options.compression = CompressionProfile::Parse(compression_option);
+    options.compression.backend = CompressionProfile::ParseBackend(deflate_option);
+    if (!level_option.empty()) {
+        options.compression.level = std::stoi(level_option);
+    }
+    if (!strategy_option.empty()) {
+        options.compression.strategy = CompressionProfile::ParseStrategy(strategy_option);
+    }
+    if (!window_bits_option.empty()) {
+        options.compression.window_bits = std::stoi(window_bits_option);
+    }
+    if (!mem_level_option.empty()) {
+        options.compression.mem_level = std::stoi(mem_level_option);
+    }
+    if (!iterations_option.empty()) {
+        options.compression.iterations = std::stoi(iterations_option);
+    }
+    options.compression.Validate();
+
+    if (options.search && options.streaming) {
+        throw std::runtime_error("--search cannot be combined with --stream");
+    }
+    if (options.search && options.compression.backend != DeflateBackendType::Zlib) {
+        throw std::runtime_error("--search only supports the zlib backend");
+    }
+
+    return options;
+}
+
+EncodeJob PNGEncoder::ParseJob(const std::vector<std::string>& args) {
+    std::vector<std::string> positional;
+    EncodeJob job;
+    job.options = ParseOptions(args, positional);
+
+    if (positional.size() < 4 || positional.size() > 6) {
+        throw std::runtime_error("Expected: in.raw out.png W H [filter [percent]]");
+    }
+
+    job.input_path = positional[0];
+    job.output_path = positional[1];
+    job.width = std::stoull(positional[2]);
+    job.height = std::stoull(positional[3]);
+
+    if (positional.size() >= 5) {
+        std::string filter_option = positional[4];
+        std::transform(filter_option.begin(), filter_option.end(), filter_option.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+        job.options.color_filter = ColorFilter::Parse(filter_option);
+
+        if (job.options.color_filter == ColorFilterType::PerlinNoise) {
+            if (positional.size() == 6) {
+                job.options.perlin_strength = std::stof(positional[5]);
+            }
+        } else if (positional.size() == 6) {
+            throw std::runtime_error("Extra parameter after '" + filter_option +
+                                     "' is not allowed");
+        }
+    }
+
+    return job;
+}
+
+void PNGEncoder::EncodeFile(const EncodeJob& job, ThreadPool& pool) {
+    EncoderContext context;
+    EncodeFile(job, pool, context);
+}
+
+void PNGEncoder::EncodeFile(const EncodeJob& job, ThreadPool& pool, EncoderContext& context,
+                            EncodeCache* cache) {
+    const EncodeOptions& options = job.options;
+
+    if (options.streaming) {
+        std::unique_ptr<OutputSink> sink = OpenOutput(job.output_path);
+        PNGStreamEncoder::EncodeFile(job.input_path, *sink, job.width, job.height,
+                                     options.color_filter, options.perlin_strength,
+                                     options.png_filter, options.compression,
+                                     options.idat_size);
+        sink->Close();
+        return;
+    }
+
+    MappedRawImage raw_image(job.input_path, job.width, job.height);
+    const ImageView image(raw_image.View(), job.width, job.height);
+
+    // Hashing reads the mapped input once; on a miss the encode finds its pages in memory
+    std::string cache_key;
+    if (cache != nullptr && EncodeCache::IsCacheable(job)) {
+        cache_key = EncodeCache::Key(job, raw_image.View());
+        if (cache->Fetch(cache_key, job.output_path)) {
+            return;
+        }
+    }
+
+    if (options.sizes.empty()) {
+        std::unique_ptr<OutputSink> sink = OpenOutput(job.output_path);
+        Encode(image, options, *sink, pool, context);
+        sink->Close();
+
+        if (!cache_key.empty()) {
+            cache->Store(cache_key, job.output_path);
+        }
+        return;
+    }
+
+    if (job.output_path == "-") {
+        throw std::runtime_error("--sizes needs an output file name, not stdout");
+    }
+
+    // The full size and every variant are separate encodes of the one mapped source;
+    // each variant resizes into and encodes with its own context
+    EncodeOptions variant_options = options;
+    variant_options.sizes.clear();
+
+    auto encode_size = [&](size_t index) {
+        if (index == 0) {
+            FileSink sink(job.output_path);
+            Encode(image, variant_options, sink, pool, context);
+            sink.Close();
+            return;
+        }
+
+        uint64_t width = 0;
+        uint64_t height = 0;
+        options.sizes[index - 1].Dimensions(job.width, job.height, width, height);
+
+        EncoderContext& variant_context = context.Variant(index - 1);
+        std::vector<uint8_t>& pixels = variant_context.ResizedPixels();
+        ImageResizer::Resize(image, width, height, options.resize_filter, pixels);
+
+        FileSink sink(SizedOutputPath(job.output_path, width, height));
+        Encode(ImageView(pixels, width, height), variant_options, sink, pool, variant_context);
+        sink.Close();
+    };
+
+    if (options.threads > 1) {
+        pool.ParallelFor(options.sizes.size() + 1, encode_size);
+    } else {
+        for (size_t i = 0; i <= options.sizes.size(); ++i) {
+            encode_size(i);
+        }
+    }
+}
+
+std::string PNGEncoder::SizedOutputPath(const std::string& path, uint64_t width,
+                                        uint64_t height) {
+    std::string suffix = "-";
+    suffix += std::to_string(width);
+    suffix += 'x';
+    suffix += std::to_string(height);
+    const size_t slash = path.find_last_of('/');
+    const size_t dot = path.find_last_of('.');
+
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return path + suffix;
+    }
+
+    return path.substr(0, dot) + suffix + path.substr(dot);
+}
+
+void PNGEncoder::Encode(const ImageView& image, const EncodeOptions& options, OutputSink& sink,
+                        ThreadPool& pool) {
+    EncoderContext context;
+    Encode(image, options, sink, pool, context);
+}
+
+void PNGEncoder::Encode(const ImageView& image, const EncodeOptions& options, OutputSink& sink,
+                        ThreadPool& pool, EncoderContext& context) {
+    ValidateImage(image);
+
+    if (options.streaming) {
+        PNGStreamEncoder encoder(options.png_filter, options.compression, options.idat_size);
+        encoder.BeginImage(sink, image.width, image.height, options.color_filter,
+                           options.perlin_strength);
+
+        for (uint64_t y = 0; y < image.height; ++y) {
+            encoder.WriteRows(image.Row(y), 1);
+        }
+
+        encoder.Finish();
+        return;
+    }
+
+    PixelFormat format;
+    if (options.reduce_colors) {
+        format = ColorReducer::Analyze(image, options.color_filter, options.perlin_strength);
+    }
+    format.interlace = options.interlace;
+
+    if (options.search) {
+        const SearchResult result = CompressionSearch::Run(
+            image, options.color_filter, options.perlin_strength, format,
+            CompressionSearch::DefaultTrials(options.compression),
+            options.threads > 1 ? &pool : nullptr, context.FilterBuffers());
+
+        PNGWriter& png_writer = context.Writer();
+        png_writer.SetMaxIDATSize(options.idat_size);
+        png_writer.WritePNG(sink, image.width, image.height, result.compressed, format);
+        return;
+    }
+
+    // Palette indices carry no numeric relation to their neighbours, so prediction rarely
+    // helps them; adaptive strategies leave indexed rows unfiltered
+    PNGFilterStrategy png_filter = options.png_filter;
+    if (format.color_type == PNGColorType::Indexed &&
+        (png_filter == PNGFilterStrategy::MinSum || png_filter == PNGFilterStrategy::Entropy)) {
+        png_filter = PNGFilterStrategy::None;
+    }
+
+    // The color filter and packing run row by row inside the PNG filter pass,
+    // split into row bands across the pool like the compression
+    ThreadPool* filter_pool = options.threads > 1 ? &pool : nullptr;
+    PNGFilter::Apply(image, png_filter, options.color_filter, options.perlin_strength, format,
+                     filter_pool, context.FilterBuffers());
+    const std::vector<uint8_t>& scanlines = context.FilterBuffers().scanlines;
+
+    // The parallel compressor allocates per block; the serial one reuses the context stream.
+    // Block-parallel deflate is built on zlib, the archival compressor splits blocks
+    // itself, other backends compress the whole image.
+    std::vector<uint8_t> parallel_data;
+    PixelView compressed_data;
+    if (options.threads > 1 && options.compression.backend == DeflateBackendType::Zlib) {
+        parallel_data = ParallelDeflateCompressor::Compress(
+            scanlines, format.RowBytes(image.width) + 1, pool, options.compression);
+        compressed_data = parallel_data;
+    } else if (options.threads > 1 &&
+               options.compression.backend == DeflateBackendType::Archival) {
+        parallel_data = ArchivalDeflateCompressor::Compress(scanlines, options.compression, &pool);
+        compressed_data = parallel_data;
+    } else {
+        compressed_data = context.Deflater().Compress(scanlines, options.compression);
+    }
+
+    PNGWriter& png_writer = context.Writer();
+    png_writer.SetMaxIDATSize(options.idat_size);
+    png_writer.WritePNG(sink, image.width, image.height, compressed_data, format);
+}
+
+std::vector<uint8_t> PNGEncoder::EncodeToMemory(const ImageView& image,
+                                                const EncodeOptions& options, ThreadPool& pool) {
+    MemorySink sink;
+    Encode(image, options, sink, pool);
+    return sink.TakeData();
+}
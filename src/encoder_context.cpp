@@ -0,0 +1,51 @@
+// encoder_context.cpp
+#include "../include/encoder_context.h"
+
+PNGFilterBuffers& EncoderContext::FilterBuffers() {
+    return filter_buffers_;
+}
+
+ReusableDeflater& EncoderContext::Deflater() {
+    return deflater_;
+}
+
+PNGWriter& EncoderContext::Writer() {
+    return writer_;
+}
+
+std::vector<uint8_t>& EncoderContext::ResizedPixels() {
+    return resized_pixels_;
+}
+
+EncoderContext& EncoderContext::Variant(size_t index) {
+    if (variants_.size() <= index) {
+        variants_.resize(index + 1);
+    }
+
+    if (!variants_[index]) {
+        variants_[index] = std::make_unique<EncoderContext>();
+    }
+
+    return *variants_[index];
+}
+
+size_t EncoderContext::RetainedBytes() const {
+    size_t bytes = filter_buffers_.Capacity() + deflater_.Capacity() + resized_pixels_.capacity();
+
+    for (const auto& variant : variants_) {
+        bytes += variant ? variant->RetainedBytes() : 0;
+    }
+
+    return bytes;
+}
+
+void EncoderContext::Trim(size_t max_retained_bytes) {
+    if (RetainedBytes() <= max_retained_bytes) {
+        return;
+    }
+
+    filter_buffers_ = PNGFilterBuffers();
+    deflater_.Release();
+    std::vector<uint8_t>().swap(resized_pixels_);
+    variants_.clear();
+}
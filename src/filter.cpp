@@ -1,6 +1,79 @@
 // filter.cpp
 #include "../include/filter.h"
+#include "../include/filter_kernels.h"
+#include "../include/color_reduction.h"
+#include "../include/encode_stats.h"
+#include "../include/interlace.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
 #include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+constexpr size_t kBytesPerPixel = 3;
+
+bool IsAdaptive(PNGFilterStrategy strategy) {
+    return strategy == PNGFilterStrategy::MinSum || strategy == PNGFilterStrategy::Entropy;
+}
+
+PNGFilterType ToFilterType(PNGFilterStrategy strategy) {
+    switch (strategy) {
+        case PNGFilterStrategy::None:
+            return PNGFilterType::None;
+        case PNGFilterStrategy::Sub:
+            return PNGFilterType::Sub;
+        case PNGFilterStrategy::Up:
+            return PNGFilterType::Up;
+        case PNGFilterStrategy::Average:
+            return PNGFilterType::Average;
+        default:
+            return PNGFilterType::Paeth;
+    }
+}
+
+}  // namespace
+
+PNGFilterStrategy PNGFilter::Parse(const std::string& strategy_name) {
+    std::string lower_name;
+    lower_name.reserve(strategy_name.size());
+    std::transform(strategy_name.begin(), strategy_name.end(), std::back_inserter(lower_name),
+                   [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+
+    if (lower_name == "none") {
+        return PNGFilterStrategy::None;
+    }
+
+    if (lower_name == "sub") {
+        return PNGFilterStrategy::Sub;
+    }
+
+    if (lower_name == "up") {
+        return PNGFilterStrategy::Up;
+    }
+
+    if (lower_name == "average") {
+        return PNGFilterStrategy::Average;
+    }
+
+    if (lower_name == "paeth") {
+        return PNGFilterStrategy::Paeth;
+    }
+
+    if (lower_name == "minsum") {
+        return PNGFilterStrategy::MinSum;
+    }
+
+    if (lower_name == "entropy") {
+        return PNGFilterStrategy::Entropy;
+    }
+
+    throw std::runtime_error("Unknown PNG filter strategy: " + strategy_name);
+}
 
 uint8_t PNGFilter::PaethPredictor(uint8_t a, uint8_t b, uint8_t c) {
     int predict = static_cast<int>(a) + static_cast<int>(b) - static_cast<int>(c);
@@ -18,39 +91,398 @@ uint8_t PNGFilter::PaethPredictor(uint8_t a, uint8_t b, uint8_t c) {
     return c;
 }
 
-std::vector<uint8_t> PNGFilter::Apply(const std::vector<uint8_t>& rgb_data, uint64_t width,
-                                      uint64_t height) {
-    std::vector<uint8_t> filtered;
-    filtered.reserve((width * 3 + 1) * height);
+// Filtered bytes are treated as signed deltas, so 0xFF costs as much as 0x01
+uint64_t PNGFilter::SumOfAbsoluteDifferences(const uint8_t* filtered, size_t size) {
+    uint64_t sum = 0;
 
-    for (size_t y = 0; y < height; ++y) {
-        filtered.push_back(static_cast<uint8_t>(PNGFilterType::Paeth));
+    for (size_t i = 0; i < size; ++i) {
+        sum += static_cast<uint64_t>(std::abs(static_cast<int>(static_cast<int8_t>(filtered[i]))));
+    }
+
+    return sum;
+}
+
+// Shannon entropy of the byte histogram, in bits for the whole row
+double PNGFilter::EstimateEntropy(const uint8_t* filtered, size_t size) {
+    std::array<uint32_t, 256> histogram{};
 
-        for (size_t x = 0; x < width; ++x) {
-            for (size_t c = 0; c < 3; ++c) {
-                uint8_t A = 0;
-                uint8_t B = 0;
-                uint8_t C = 0;
+    for (size_t i = 0; i < size; ++i) {
+        ++histogram[filtered[i]];
+    }
 
-                if (x > 0) {
-                    A = rgb_data[(y * width + (x - 1)) * 3 + c];
-                }
+    double bits = 0.0;
+    const double total = static_cast<double>(size);
 
-                if (y > 0) {
-                    B = rgb_data[((y - 1) * width + x) * 3 + c];
-                }
+    for (uint32_t count : histogram) {
+        if (count != 0) {
+            bits -= count * std::log2(count / total);
+        }
+    }
 
-                if (x > 0 && y > 0) {
-                    C = rgb_data[((y - 1) * width + (x - 1)) * 3 + c];
-                }
+    return bits;
+}
 
-                uint8_t current = rgb_data[(y * width + x) * 3 + c];
-                uint8_t pred = PaethPredictor(A, B, C);
-                uint8_t filtered_val = current - pred;
-                filtered.push_back(filtered_val);
+void PNGFilter::FilterRow(const uint8_t* row, const uint8_t* prev_row, size_t row_bytes,
+                          size_t bpp, PNGFilterType type, uint8_t* out) {
+    out[0] = static_cast<uint8_t>(type);
+    uint8_t* filtered = out + 1;
+
+    if (type == PNGFilterType::None) {
+        std::memcpy(filtered, row, row_bytes);
+        return;
+    }
+
+    if (prev_row != nullptr) {
+        const PNGFilterKernels& kernels = PNGFilterKernels::Get();
+
+        switch (type) {
+            case PNGFilterType::Sub:
+                kernels.sub(row, prev_row, row_bytes, bpp, filtered);
+                break;
+            case PNGFilterType::Up:
+                kernels.up(row, prev_row, row_bytes, bpp, filtered);
+                break;
+            case PNGFilterType::Average:
+                kernels.average(row, prev_row, row_bytes, bpp, filtered);
+                break;
+            default:
+                kernels.paeth(row, prev_row, row_bytes, bpp, filtered);
+                break;
+        }
+
+        return;
+    }
+
+    // The first row has no row above it, B = C = 0
+    for (size_t i = 0; i < row_bytes; ++i) {
+        uint8_t A = i >= bpp ? row[i - bpp] : 0;
+
+        uint8_t pred = 0;
+        switch (type) {
+            case PNGFilterType::Sub:
+                pred = A;
+                break;
+            case PNGFilterType::Average:
+                pred = A / 2;
+                break;
+            case PNGFilterType::Paeth:
+                pred = PaethPredictor(A, 0, 0);
+                break;
+            default:
+                break;
+        }
+
+        filtered[i] = row[i] - pred;
+    }
+}
+
+PNGFilterType PNGFilter::FilterRow(const uint8_t* row, const uint8_t* prev_row, size_t row_bytes,
+                                   size_t bpp, PNGFilterStrategy strategy, uint8_t* out,
+                                   std::vector<uint8_t>& scratch) {
+    if (!IsAdaptive(strategy)) {
+        PNGFilterType type = ToFilterType(strategy);
+        FilterRow(row, prev_row, row_bytes, bpp, type, out);
+        return type;
+    }
+
+    const size_t line_size = row_bytes + 1;
+    scratch.resize(line_size);
+
+    PNGFilterType best_type = PNGFilterType::None;
+    double best_cost = std::numeric_limits<double>::infinity();
+
+    for (size_t t = 0; t < kFilterTypeCount; ++t) {
+        PNGFilterType type = static_cast<PNGFilterType>(t);
+        FilterRow(row, prev_row, row_bytes, bpp, type, scratch.data());
+
+        double cost = strategy == PNGFilterStrategy::MinSum
+                          ? static_cast<double>(SumOfAbsoluteDifferences(scratch.data() + 1,
+                                                                         row_bytes))
+                          : EstimateEntropy(scratch.data() + 1, row_bytes);
+
+        if (cost < best_cost) {
+            best_cost = cost;
+            best_type = type;
+            std::memcpy(out, scratch.data(), line_size);
+        }
+    }
+
+    return best_type;
+}
+
+std::vector<uint8_t> PNGFilter::Apply(PixelView rgb_data, uint64_t width, uint64_t height,
+                                      PNGFilterStrategy strategy) {
+    return Apply(rgb_data, width, height, strategy, ColorFilterType::None);
+}
+
+size_t PNGFilterBuffers::Capacity() const {
+    size_t capacity = scanlines.capacity();
+
+    for (const Band& band : bands) {
+        capacity += band.scratch.capacity() + band.colored_row.capacity() +
+                    band.current_row.capacity() + band.previous_row.capacity();
+    }
+
+    return capacity;
+}
+
+std::vector<uint8_t> PNGFilter::Apply(PixelView rgb_data, uint64_t width, uint64_t height,
+                                      PNGFilterStrategy strategy, ColorFilterType color_filter,
+                                      float perlin_noise_scale, const PixelFormat& format,
+                                      ThreadPool* pool) {
+    PNGFilterBuffers buffers;
+    Apply(ImageView(rgb_data, width, height), strategy, color_filter, perlin_noise_scale, format,
+          pool, buffers);
+    return std::move(buffers.scanlines);
+}
+
+void PNGFilter::Apply(const ImageView& image, PNGFilterStrategy strategy,
+                      ColorFilterType color_filter, float perlin_noise_scale,
+                      const PixelFormat& format, ThreadPool* pool, PNGFilterBuffers& buffers) {
+    if (format.interlace == PNGInterlace::Adam7) {
+        FilterInterlaced(image, strategy, color_filter, perlin_noise_scale, format, pool,
+                         buffers);
+        return;
+    }
+
+    const uint64_t height = image.height;
+
+    // Every byte is overwritten, so growing is the only cost of a reused buffer
+    buffers.scanlines.resize((format.RowBytes(image.width) + 1) * height);
+
+    // A few bands per worker even out rows of uneven cost
+    size_t band_count = 1;
+    if (pool != nullptr && pool->Size() > 1) {
+        band_count = std::max<uint64_t>(std::min<uint64_t>(pool->Size() * 4,
+                                                           height / kMinBandRows),
+                                        1);
+    }
+
+    std::vector<RowRange> bands(band_count);
+    for (size_t band = 0; band < band_count; ++band) {
+        bands[band] = {height * band / band_count, height * (band + 1) / band_count};
+    }
+
+    FilterRanges(image, strategy, color_filter, perlin_noise_scale, format, bands, pool,
+                 buffers);
+}
+
+void PNGFilter::ApplyRows(const ImageView& image, PNGFilterStrategy strategy,
+                          ColorFilterType color_filter, float perlin_noise_scale,
+                          const PixelFormat& format, const std::vector<RowRange>& ranges,
+                          ThreadPool* pool, PNGFilterBuffers& buffers) {
+    if (format.interlace != PNGInterlace::None) {
+        throw std::runtime_error("Row ranges of interlaced images are not supported");
+    }
+    if (buffers.scanlines.size() != (format.RowBytes(image.width) + 1) * image.height) {
+        throw std::runtime_error("Scanlines do not match the image size");
+    }
+
+    for (const RowRange& range : ranges) {
+        if (range.begin > range.end || range.end > image.height) {
+            throw std::runtime_error("Row range is outside the image");
+        }
+    }
+
+    FilterRanges(image, strategy, color_filter, perlin_noise_scale, format, ranges, pool,
+                 buffers);
+}
+
+void PNGFilter::FilterRanges(const ImageView& image, PNGFilterStrategy strategy,
+                             ColorFilterType color_filter, float perlin_noise_scale,
+                             const PixelFormat& format, const std::vector<RowRange>& ranges,
+                             ThreadPool* pool, PNGFilterBuffers& buffers) {
+    const uint64_t width = image.width;
+    const size_t rgb_row_bytes = width * kBytesPerPixel;
+    const size_t row_bytes = format.RowBytes(width);
+    const size_t bpp = format.FilterBpp();
+    std::vector<uint8_t>& filtered = buffers.scanlines;
+
+    // Plain RGB rows are read in place, otherwise only two transformed rows per band exist
+    const bool transform = color_filter != ColorFilterType::None;
+    const bool pack = !format.IsRGB8();
+    const PixelPacker packer(format);
+
+    // Color filters and packing into out, for the current row or the row above a band
+    auto prepare_row = [&](uint64_t y, uint8_t* colored_row, uint8_t* out) {
+        StageTimer timer(EncodeStage::ColorFilter, rgb_row_bytes);
+        timer.AddBytesOut(row_bytes);
+        const uint8_t* row = image.Row(y);
+
+        if (transform) {
+            uint8_t* colored = pack ? colored_row : out;
+            std::memcpy(colored, row, rgb_row_bytes);
+            ColorFilter::ApplyRows(colored, width, y, 1, color_filter, perlin_noise_scale);
+            row = colored;
+        }
+
+        if (pack) {
+            packer.PackRow(row, width, out);
+        }
+    };
+
+    // Every range writes to its own rows of filtered; a range only reads the input row
+    // above its first row, so ranges are independent and the output matches a serial run
+    auto filter_band = [&](PNGFilterBuffers::Band& band, uint64_t begin, uint64_t end) {
+        StageTimer timer(EncodeStage::PNGFilter, (end - begin) * rgb_row_bytes);
+        timer.AddBytesOut((end - begin) * (row_bytes + 1));
+
+        std::vector<uint8_t>& scratch = band.scratch;
+        std::vector<uint8_t>& colored_row = band.colored_row;
+        std::vector<uint8_t>& current_row = band.current_row;
+        std::vector<uint8_t>& previous_row = band.previous_row;
+
+        colored_row.resize(transform && pack ? rgb_row_bytes : 0);
+        current_row.resize(transform || pack ? row_bytes : 0);
+        previous_row.resize(transform || pack ? row_bytes : 0);
+
+        if ((transform || pack) && begin > 0) {
+            prepare_row(begin - 1, colored_row.data(), previous_row.data());
+        }
+
+        for (uint64_t y = begin; y < end; ++y) {
+            const uint8_t* row = image.Row(y);
+            const uint8_t* prev_row = y > 0 ? image.Row(y - 1) : nullptr;
+
+            if (transform || pack) {
+                prepare_row(y, colored_row.data(), current_row.data());
+                row = current_row.data();
+                prev_row = y > 0 ? previous_row.data() : nullptr;
+            }
+
+            FilterRow(row, prev_row, row_bytes, bpp, strategy,
+                      filtered.data() + y * (row_bytes + 1), scratch);
+
+            if (transform || pack) {
+                current_row.swap(previous_row);
             }
         }
+    };
+
+    // Serially every range goes through the row buffers of the first band
+    const bool parallel = ranges.size() > 1 && pool != nullptr && pool->Size() > 1;
+    const size_t band_count = parallel ? ranges.size() : 1;
+    if (buffers.bands.size() < band_count) {
+        buffers.bands.resize(band_count);
+    }
+
+    if (!parallel) {
+        for (const RowRange& range : ranges) {
+            filter_band(buffers.bands[0], range.begin, range.end);
+        }
+    } else {
+        pool->ParallelFor(ranges.size(), [&](size_t band) {
+            filter_band(buffers.bands[band], ranges[band].begin, ranges[band].end);
+        });
+    }
+}
+
+void PNGFilter::FilterInterlaced(const ImageView& image, PNGFilterStrategy strategy,
+                                 ColorFilterType color_filter, float perlin_noise_scale,
+                                 const PixelFormat& format, ThreadPool* pool,
+                                 PNGFilterBuffers& buffers) {
+    const uint64_t width = image.width;
+    const size_t rgb_row_bytes = width * kBytesPerPixel;
+    const size_t bpp = format.FilterBpp();
+    const auto offsets = Adam7::PassOffsets(width, image.height, format);
+    buffers.scanlines.resize(offsets[Adam7::kPassCount]);
+
+    const bool transform = color_filter != ColorFilterType::None;
+    const bool pack = !format.IsRGB8();
+    const PixelPacker packer(format);
+
+    // Rows [begin, end) of one pass
+    struct Band {
+        size_t pass;
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    uint64_t total_rows = 0;
+    for (size_t pass = 0; pass < Adam7::kPassCount; ++pass) {
+        total_rows += Adam7::PassWidth(pass, width) == 0 ? 0
+                                                         : Adam7::PassHeight(pass, image.height);
+    }
+
+    // Bands of the seven passes share one ParallelFor, a few per worker as in Apply
+    uint64_t band_rows = std::max<uint64_t>(total_rows, 1);
+    if (pool != nullptr && pool->Size() > 1) {
+        band_rows = std::max<uint64_t>((total_rows + pool->Size() * 4 - 1) / (pool->Size() * 4),
+                                       kMinBandRows);
+    }
+
+    std::vector<Band> bands;
+    for (size_t pass = 0; pass < Adam7::kPassCount; ++pass) {
+        const uint64_t pass_height =
+            Adam7::PassWidth(pass, width) == 0 ? 0 : Adam7::PassHeight(pass, image.height);
+        for (uint64_t begin = 0; begin < pass_height; begin += band_rows) {
+            bands.push_back({pass, begin, std::min(begin + band_rows, pass_height)});
+        }
     }
 
-    return filtered;
-}
\ No newline at end of file
+    // Row j of pass into out: the color filter sees the full source row at its own
+    // coordinates, then the pass pixels are gathered and packed
+    auto prepare_row = [&](size_t pass, uint64_t j, uint8_t* colored_row, uint8_t* out) {
+        const uint64_t y = Adam7::kPasses[pass].y0 + j * Adam7::kPasses[pass].dy;
+        const uint64_t pass_width = Adam7::PassWidth(pass, width);
+        StageTimer timer(EncodeStage::ColorFilter, pass_width * kBytesPerPixel);
+        timer.AddBytesOut(format.RowBytes(pass_width));
+        const uint8_t* row = image.Row(y);
+
+        if (transform) {
+            std::memcpy(colored_row, row, rgb_row_bytes);
+            ColorFilter::ApplyRows(colored_row, width, y, 1, color_filter, perlin_noise_scale);
+            row = colored_row;
+        }
+
+        if (pack) {
+            Adam7::ExtractRow(row, width, pass, colored_row);
+            packer.PackRow(colored_row, pass_width, out);
+        } else {
+            Adam7::ExtractRow(row, width, pass, out);
+        }
+    };
+
+    auto filter_band = [&](PNGFilterBuffers::Band& band_buffers, const Band& band) {
+        const uint64_t pass_width = Adam7::PassWidth(band.pass, width);
+        const size_t row_bytes = format.RowBytes(pass_width);
+        StageTimer timer(EncodeStage::PNGFilter,
+                         (band.end - band.begin) * pass_width * kBytesPerPixel);
+        timer.AddBytesOut((band.end - band.begin) * (row_bytes + 1));
+
+        std::vector<uint8_t>& colored_row = band_buffers.colored_row;
+        std::vector<uint8_t>& current_row = band_buffers.current_row;
+        std::vector<uint8_t>& previous_row = band_buffers.previous_row;
+        colored_row.resize(transform || pack ? rgb_row_bytes : 0);
+        current_row.resize(row_bytes);
+        previous_row.resize(row_bytes);
+
+        if (band.begin > 0) {
+            prepare_row(band.pass, band.begin - 1, colored_row.data(), previous_row.data());
+        }
+
+        uint8_t* out = buffers.scanlines.data() + offsets[band.pass] +
+                       band.begin * (row_bytes + 1);
+        for (uint64_t j = band.begin; j < band.end; ++j, out += row_bytes + 1) {
+            prepare_row(band.pass, j, colored_row.data(), current_row.data());
+            FilterRow(current_row.data(), j > 0 ? previous_row.data() : nullptr, row_bytes, bpp,
+                      strategy, out, band_buffers.scratch);
+            current_row.swap(previous_row);
+        }
+    };
+
+    const bool parallel = bands.size() > 1 && pool != nullptr && pool->Size() > 1;
+    const size_t buffer_count = parallel ? bands.size() : 1;
+    if (buffers.bands.size() < buffer_count) {
+        buffers.bands.resize(buffer_count);
+    }
+
+    if (!parallel) {
+        for (const Band& band : bands) {
+            filter_band(buffers.bands[0], band);
+        }
+    } else {
+        pool->ParallelFor(bands.size(),
+                          [&](size_t band) { filter_band(buffers.bands[band], bands[band]); });
+    }
+}
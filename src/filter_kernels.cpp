@@ -0,0 +1,326 @@
+// filter_kernels.cpp
+#include "../include/filter_kernels.h"
+
+#include <cstdlib>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PNG_ENCODER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+uint8_t Paeth(uint8_t a, uint8_t b, uint8_t c) {
+    int p = static_cast<int>(a) + static_cast<int>(b) - static_cast<int>(c);
+    int pa = std::abs(p - static_cast<int>(a));
+    int pb = std::abs(p - static_cast<int>(b));
+    int pc = std::abs(p - static_cast<int>(c));
+
+    if (pa <= pb && pa <= pc) {
+        return a;
+    } else if (pb <= pc) {
+        return b;
+    }
+
+    return c;
+}
+
+// Scalar tails, shared by every instruction set: bytes [begin, end) with begin >= bpp
+
+void SubTail(const uint8_t* row, size_t begin, size_t end, size_t bpp, uint8_t* out) {
+    for (size_t i = begin; i < end; ++i) {
+        out[i] = row[i] - row[i - bpp];
+    }
+}
+
+void UpTail(const uint8_t* row, const uint8_t* prev_row, size_t begin, size_t end, uint8_t* out) {
+    for (size_t i = begin; i < end; ++i) {
+        out[i] = row[i] - prev_row[i];
+    }
+}
+
+void AverageTail(const uint8_t* row, const uint8_t* prev_row, size_t begin, size_t end,
+                 size_t bpp, uint8_t* out) {
+    for (size_t i = begin; i < end; ++i) {
+        out[i] = row[i] - static_cast<uint8_t>((row[i - bpp] + prev_row[i]) >> 1);
+    }
+}
+
+void PaethTail(const uint8_t* row, const uint8_t* prev_row, size_t begin, size_t end, size_t bpp,
+               uint8_t* out) {
+    for (size_t i = begin; i < end; ++i) {
+        out[i] = row[i] - Paeth(row[i - bpp], prev_row[i], prev_row[i - bpp]);
+    }
+}
+
+// The first pixel has no left neighbour: A = C = 0, so Sub copies the bytes,
+// Average halves B and Paeth degenerates to Up
+size_t Head(size_t row_bytes, size_t bpp) {
+    return bpp < row_bytes ? bpp : row_bytes;
+}
+
+void SubScalar(const uint8_t* row, const uint8_t*, size_t row_bytes, size_t bpp, uint8_t* out) {
+    const size_t head = Head(row_bytes, bpp);
+    for (size_t i = 0; i < head; ++i) {
+        out[i] = row[i];
+    }
+    SubTail(row, head, row_bytes, bpp, out);
+}
+
+void UpScalar(const uint8_t* row, const uint8_t* prev_row, size_t row_bytes, size_t,
+              uint8_t* out) {
+    UpTail(row, prev_row, 0, row_bytes, out);
+}
+
+void AverageScalar(const uint8_t* row, const uint8_t* prev_row, size_t row_bytes, size_t bpp,
+                   uint8_t* out) {
+    const size_t head = Head(row_bytes, bpp);
+    for (size_t i = 0; i < head; ++i) {
+        out[i] = row[i] - (prev_row[i] >> 1);
+    }
+    AverageTail(row, prev_row, head, row_bytes, bpp, out);
+}
+
+void PaethScalar(const uint8_t* row, const uint8_t* prev_row, size_t row_bytes, size_t bpp,
+                 uint8_t* out) {
+    const size_t head = Head(row_bytes, bpp);
+    UpTail(row, prev_row, 0, head, out);
+    PaethTail(row, prev_row, head, row_bytes, bpp, out);
+}
+
+constexpr PNGFilterKernels kScalarKernels = {SubScalar, UpScalar, AverageScalar, PaethScalar};
+
+#ifdef PNG_ENCODER_X86
+
+// SSE4.1: 16 bytes per iteration
+
+__attribute__((target("sse4.1"))) void SubSSE41(const uint8_t* row, const uint8_t*,
+                                                size_t row_bytes, size_t bpp, uint8_t* out) {
+    const size_t head = Head(row_bytes, bpp);
+    for (size_t i = 0; i < head; ++i) {
+        out[i] = row[i];
+    }
+
+    size_t i = head;
+    for (; i + 16 <= row_bytes; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i - bpp));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_sub_epi8(x, a));
+    }
+    SubTail(row, i, row_bytes, bpp, out);
+}
+
+__attribute__((target("sse4.1"))) void UpSSE41(const uint8_t* row, const uint8_t* prev_row,
+                                               size_t row_bytes, size_t, uint8_t* out) {
+    size_t i = 0;
+    for (; i + 16 <= row_bytes; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev_row + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_sub_epi8(x, b));
+    }
+    UpTail(row, prev_row, i, row_bytes, out);
+}
+
+// floor((a + b) / 2) == avg_epu8(a, b) - ((a ^ b) & 1)
+__attribute__((target("sse4.1"))) void AverageSSE41(const uint8_t* row, const uint8_t* prev_row,
+                                                    size_t row_bytes, size_t bpp, uint8_t* out) {
+    const size_t head = Head(row_bytes, bpp);
+    for (size_t i = 0; i < head; ++i) {
+        out[i] = row[i] - (prev_row[i] >> 1);
+    }
+
+    const __m128i one = _mm_set1_epi8(1);
+    size_t i = head;
+    for (; i + 16 <= row_bytes; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i - bpp));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev_row + i));
+        __m128i avg =
+            _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_sub_epi8(x, avg));
+    }
+    AverageTail(row, prev_row, i, row_bytes, bpp, out);
+}
+
+// Branchless Paeth on 8 lanes of 16-bit values:
+// pa = |b - c|, pb = |a - c|, pc = |a + b - 2c|; ties resolve to a, then b
+__attribute__((target("sse4.1"))) __m128i PaethPredict8(__m128i a, __m128i b, __m128i c) {
+    __m128i pa = _mm_sub_epi16(b, c);
+    __m128i pb = _mm_sub_epi16(a, c);
+    __m128i pc = _mm_abs_epi16(_mm_add_epi16(pa, pb));
+    pa = _mm_abs_epi16(pa);
+    pb = _mm_abs_epi16(pb);
+
+    __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+    __m128i nearest = _mm_blendv_epi8(c, b, _mm_cmpeq_epi16(pb, smallest));
+    return _mm_blendv_epi8(nearest, a, _mm_cmpeq_epi16(pa, smallest));
+}
+
+__attribute__((target("sse4.1"))) void PaethSSE41(const uint8_t* row, const uint8_t* prev_row,
+                                                  size_t row_bytes, size_t bpp, uint8_t* out) {
+    const size_t head = Head(row_bytes, bpp);
+    UpTail(row, prev_row, 0, head, out);
+
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = head;
+    for (; i + 16 <= row_bytes; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i - bpp));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev_row + i));
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev_row + i - bpp));
+
+        __m128i lo = PaethPredict8(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero),
+                                   _mm_unpacklo_epi8(c, zero));
+        __m128i hi = PaethPredict8(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero),
+                                   _mm_unpackhi_epi8(c, zero));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                         _mm_sub_epi8(x, _mm_packus_epi16(lo, hi)));
+    }
+    PaethTail(row, prev_row, i, row_bytes, bpp, out);
+}
+
+// AVX2: 32 bytes per iteration. unpack/pack work within 128-bit lanes,
+// so unpacking and packing back keeps the byte order intact
+
+__attribute__((target("avx2"))) void SubAVX2(const uint8_t* row, const uint8_t*,
+                                             size_t row_bytes, size_t bpp, uint8_t* out) {
+    const size_t head = Head(row_bytes, bpp);
+    for (size_t i = 0; i < head; ++i) {
+        out[i] = row[i];
+    }
+
+    size_t i = head;
+    for (; i + 32 <= row_bytes; i += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i - bpp));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_sub_epi8(x, a));
+    }
+    SubTail(row, i, row_bytes, bpp, out);
+}
+
+__attribute__((target("avx2"))) void UpAVX2(const uint8_t* row, const uint8_t* prev_row,
+                                            size_t row_bytes, size_t, uint8_t* out) {
+    size_t i = 0;
+    for (; i + 32 <= row_bytes; i += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev_row + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_sub_epi8(x, b));
+    }
+    UpTail(row, prev_row, i, row_bytes, out);
+}
+
+__attribute__((target("avx2"))) void AverageAVX2(const uint8_t* row, const uint8_t* prev_row,
+                                                 size_t row_bytes, size_t bpp, uint8_t* out) {
+    const size_t head = Head(row_bytes, bpp);
+    for (size_t i = 0; i < head; ++i) {
+        out[i] = row[i] - (prev_row[i] >> 1);
+    }
+
+    const __m256i one = _mm256_set1_epi8(1);
+    size_t i = head;
+    for (; i + 32 <= row_bytes; i += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i - bpp));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev_row + i));
+        __m256i avg = _mm256_sub_epi8(_mm256_avg_epu8(a, b),
+                                      _mm256_and_si256(_mm256_xor_si256(a, b), one));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_sub_epi8(x, avg));
+    }
+    AverageTail(row, prev_row, i, row_bytes, bpp, out);
+}
+
+__attribute__((target("avx2"))) __m256i PaethPredict16(__m256i a, __m256i b, __m256i c) {
+    __m256i pa = _mm256_sub_epi16(b, c);
+    __m256i pb = _mm256_sub_epi16(a, c);
+    __m256i pc = _mm256_abs_epi16(_mm256_add_epi16(pa, pb));
+    pa = _mm256_abs_epi16(pa);
+    pb = _mm256_abs_epi16(pb);
+
+    __m256i smallest = _mm256_min_epi16(pc, _mm256_min_epi16(pa, pb));
+    __m256i nearest = _mm256_blendv_epi8(c, b, _mm256_cmpeq_epi16(pb, smallest));
+    return _mm256_blendv_epi8(nearest, a, _mm256_cmpeq_epi16(pa, smallest));
+}
+
+__attribute__((target("avx2"))) void PaethAVX2(const uint8_t* row, const uint8_t* prev_row,
+                                               size_t row_bytes, size_t bpp, uint8_t* out) {
+    const size_t head = Head(row_bytes, bpp);
+    UpTail(row, prev_row, 0, head, out);
+
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = head;
+    for (; i + 32 <= row_bytes; i += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i - bpp));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev_row + i));
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev_row + i - bpp));
+
+        __m256i lo =
+            PaethPredict16(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero),
+                           _mm256_unpacklo_epi8(c, zero));
+        __m256i hi =
+            PaethPredict16(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero),
+                           _mm256_unpackhi_epi8(c, zero));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                            _mm256_sub_epi8(x, _mm256_packus_epi16(lo, hi)));
+    }
+    PaethTail(row, prev_row, i, row_bytes, bpp, out);
+}
+
+constexpr PNGFilterKernels kSSE41Kernels = {SubSSE41, UpSSE41, AverageSSE41, PaethSSE41};
+constexpr PNGFilterKernels kAVX2Kernels = {SubAVX2, UpAVX2, AverageAVX2, PaethAVX2};
+
+#endif  // PNG_ENCODER_X86
+
+}  // namespace
+
+bool PNGFilterKernels::IsSupported(SIMDLevel level) {
+    switch (level) {
+        case SIMDLevel::Scalar:
+            return true;
+#ifdef PNG_ENCODER_X86
+        case SIMDLevel::SSE41:
+            return __builtin_cpu_supports("sse4.1");
+        case SIMDLevel::AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+SIMDLevel PNGFilterKernels::DetectLevel() {
+    if (IsSupported(SIMDLevel::AVX2)) {
+        return SIMDLevel::AVX2;
+    }
+
+    if (IsSupported(SIMDLevel::SSE41)) {
+        return SIMDLevel::SSE41;
+    }
+
+    return SIMDLevel::Scalar;
+}
+
+const PNGFilterKernels& PNGFilterKernels::ForLevel(SIMDLevel level) {
+    if (!IsSupported(level)) {
+        throw std::runtime_error("SIMD level is not supported by this CPU");
+    }
+
+    switch (level) {
+#ifdef PNG_ENCODER_X86
+        case SIMDLevel::SSE41:
+            return kSSE41Kernels;
+        case SIMDLevel::AVX2:
+            return kAVX2Kernels;
+#endif
+        default:
+            return kScalarKernels;
+    }
+}
+
+const PNGFilterKernels& PNGFilterKernels::Get() {
+    static const PNGFilterKernels& kernels = ForLevel(DetectLevel());
+    return kernels;
+}
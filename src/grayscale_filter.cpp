@@ -1,22 +1,230 @@
 // grayscale_filter.cpp
 #include "../include/grayscale_filter.h"
-#include <algorithm>
 
-void GrayscaleFilter::Apply(std::vector<uint8_t>& rgb_data) {
-    const float red_weight = 0.299f;
-    const float green_weight = 0.587f;
-    const float blue_weight = 0.114f;
+#include <array>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PNG_ENCODER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
 
-    for (size_t pixel_index = 0; pixel_index < rgb_data.size(); pixel_index += 3) {
-        float red = rgb_data[pixel_index];
-        float green = rgb_data[pixel_index + 1];
-        float blue = rgb_data[pixel_index + 2];
+// 0.299, 0.587 and 0.114 times 2^16, summing to 2^16
+constexpr uint32_t kRedWeight = 19595;
+constexpr uint32_t kGreenWeight = 38470;
+constexpr uint32_t kBlueWeight = 7471;
+constexpr int kWeightShift = 16;
 
-        uint8_t gray_value = static_cast<uint8_t>(
-            std::clamp(red_weight * red + green_weight * green + blue_weight * blue, 0.f, 255.f));
+void ApplyScalar(uint8_t* rgb_data, size_t size) {
+    for (size_t pixel_index = 0; pixel_index + 2 < size; pixel_index += 3) {
+        const uint32_t red = rgb_data[pixel_index];
+        const uint32_t green = rgb_data[pixel_index + 1];
+        const uint32_t blue = rgb_data[pixel_index + 2];
+
+        const uint8_t gray_value = static_cast<uint8_t>(
+            (kRedWeight * red + kGreenWeight * green + kBlueWeight * blue) >> kWeightShift);
 
         rgb_data[pixel_index] = gray_value;
         rgb_data[pixel_index + 1] = gray_value;
         rgb_data[pixel_index + 2] = gray_value;
     }
-}
\ No newline at end of file
+}
+
+#ifdef PNG_ENCODER_X86
+
+constexpr size_t kBlockPixels = 16;
+constexpr size_t kBlockBytes = kBlockPixels * 3;
+
+using ShuffleMask = std::array<uint8_t, 16>;
+
+// Mask picking the bytes of channel from the 16-byte part `part` of 16 interleaved pixels
+// into their pixel positions; other positions are zeroed (0x80)
+constexpr ShuffleMask GatherMask(size_t channel, size_t part) {
+    ShuffleMask mask{};
+    for (size_t pixel = 0; pixel < kBlockPixels; ++pixel) {
+        const size_t byte = pixel * 3 + channel;
+        mask[pixel] = byte / 16 == part ? static_cast<uint8_t>(byte % 16) : 0x80;
+    }
+    return mask;
+}
+
+// Mask spreading 16 gray bytes over part `part` of the 48 output bytes
+constexpr ShuffleMask SpreadMask(size_t part) {
+    ShuffleMask mask{};
+    for (size_t i = 0; i < 16; ++i) {
+        mask[i] = static_cast<uint8_t>((part * 16 + i) / 3);
+    }
+    return mask;
+}
+
+constexpr std::array<std::array<ShuffleMask, 3>, 3> kGatherMasks = {{
+    {GatherMask(0, 0), GatherMask(0, 1), GatherMask(0, 2)},
+    {GatherMask(1, 0), GatherMask(1, 1), GatherMask(1, 2)},
+    {GatherMask(2, 0), GatherMask(2, 1), GatherMask(2, 2)},
+}};
+
+constexpr std::array<ShuffleMask, 3> kSpreadMasks = {SpreadMask(0), SpreadMask(1),
+                                                     SpreadMask(2)};
+
+// pmaddwd takes signed 16-bit weights, so green is split over the red and blue pairs
+constexpr uint32_t kGreenHalf = kGreenWeight / 2;
+static_assert(kGreenHalf * 2 == kGreenWeight && kGreenHalf < 32768);
+
+// The helpers are inlined into both kernels, so the AVX2 one has no calls to legacy SSE code
+#define PNG_ENCODER_GRAY_HELPER __attribute__((target("sse4.1"), always_inline)) inline
+
+// Shuffle masks loaded once per call of a kernel
+struct GrayMasks {
+    __m128i gather[3][3];
+    __m128i spread[3];
+};
+
+PNG_ENCODER_GRAY_HELPER GrayMasks LoadMasks() {
+    GrayMasks masks;
+    for (size_t channel = 0; channel < 3; ++channel) {
+        for (size_t part = 0; part < 3; ++part) {
+            masks.gather[channel][part] = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(kGatherMasks[channel][part].data()));
+        }
+    }
+    for (size_t part = 0; part < 3; ++part) {
+        masks.spread[part] =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(kSpreadMasks[part].data()));
+    }
+    return masks;
+}
+
+// One channel of 16 pixels from the three 16-byte parts
+PNG_ENCODER_GRAY_HELPER __m128i GatherChannel(const GrayMasks& masks, const __m128i parts[3],
+                                              size_t channel) {
+    return _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(parts[0], masks.gather[channel][0]),
+                                     _mm_shuffle_epi8(parts[1], masks.gather[channel][1])),
+                        _mm_shuffle_epi8(parts[2], masks.gather[channel][2]));
+}
+
+PNG_ENCODER_GRAY_HELPER void StoreGray(const GrayMasks& masks, uint8_t* out, __m128i gray) {
+    for (size_t part = 0; part < 3; ++part) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + part * 16),
+                         _mm_shuffle_epi8(gray, masks.spread[part]));
+    }
+}
+
+// Gray of 4 pixels from red/green and blue/green word pairs
+PNG_ENCODER_GRAY_HELPER __m128i Luma4(__m128i red_green, __m128i blue_green) {
+    const __m128i red_weights =
+        _mm_set1_epi32(static_cast<int>(kGreenHalf << 16 | kRedWeight));
+    const __m128i blue_weights =
+        _mm_set1_epi32(static_cast<int>(kGreenHalf << 16 | kBlueWeight));
+
+    return _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(red_green, red_weights),
+                                        _mm_madd_epi16(blue_green, blue_weights)),
+                          kWeightShift);
+}
+
+// Gray of 8 pixels given as words
+PNG_ENCODER_GRAY_HELPER __m128i Luma8(__m128i red, __m128i green, __m128i blue) {
+    __m128i low = Luma4(_mm_unpacklo_epi16(red, green), _mm_unpacklo_epi16(blue, green));
+    __m128i high = Luma4(_mm_unpackhi_epi16(red, green), _mm_unpackhi_epi16(blue, green));
+    return _mm_packus_epi32(low, high);
+}
+
+// SSE4.1: 16 pixels per step, deinterleaved into channel vectors with pshufb
+__attribute__((target("sse4.1"))) void ApplySSE41(uint8_t* rgb_data, size_t size) {
+    const GrayMasks masks = LoadMasks();
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; i + kBlockBytes <= size; i += kBlockBytes) {
+        const __m128i parts[3] = {
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb_data + i)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb_data + i + 16)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb_data + i + 32)),
+        };
+
+        const __m128i red = GatherChannel(masks, parts, 0);
+        const __m128i green = GatherChannel(masks, parts, 1);
+        const __m128i blue = GatherChannel(masks, parts, 2);
+
+        __m128i low = Luma8(_mm_unpacklo_epi8(red, zero), _mm_unpacklo_epi8(green, zero),
+                            _mm_unpacklo_epi8(blue, zero));
+        __m128i high = Luma8(_mm_unpackhi_epi8(red, zero), _mm_unpackhi_epi8(green, zero),
+                             _mm_unpackhi_epi8(blue, zero));
+        StoreGray(masks, rgb_data + i, _mm_packus_epi16(low, high));
+    }
+
+    ApplyScalar(rgb_data + i, size - i);
+}
+
+// AVX2: the same deinterleave, with the arithmetic of all 16 pixels in one register
+__attribute__((target("avx2"))) void ApplyAVX2(uint8_t* rgb_data, size_t size) {
+    const __m256i red_weights =
+        _mm256_set1_epi32(static_cast<int>(kGreenHalf << 16 | kRedWeight));
+    const __m256i blue_weights =
+        _mm256_set1_epi32(static_cast<int>(kGreenHalf << 16 | kBlueWeight));
+    const GrayMasks masks = LoadMasks();
+    size_t i = 0;
+
+    for (; i + kBlockBytes <= size; i += kBlockBytes) {
+        const __m128i parts[3] = {
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb_data + i)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb_data + i + 16)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb_data + i + 32)),
+        };
+
+        const __m256i red = _mm256_cvtepu8_epi16(GatherChannel(masks, parts, 0));
+        const __m256i green = _mm256_cvtepu8_epi16(GatherChannel(masks, parts, 1));
+        const __m256i blue = _mm256_cvtepu8_epi16(GatherChannel(masks, parts, 2));
+
+        // Unpack and pack both work within 128-bit lanes, so pixel order comes back intact
+        __m256i low = _mm256_add_epi32(
+            _mm256_madd_epi16(_mm256_unpacklo_epi16(red, green), red_weights),
+            _mm256_madd_epi16(_mm256_unpacklo_epi16(blue, green), blue_weights));
+        __m256i high = _mm256_add_epi32(
+            _mm256_madd_epi16(_mm256_unpackhi_epi16(red, green), red_weights),
+            _mm256_madd_epi16(_mm256_unpackhi_epi16(blue, green), blue_weights));
+        __m256i gray = _mm256_packus_epi32(_mm256_srli_epi32(low, kWeightShift),
+                                           _mm256_srli_epi32(high, kWeightShift));
+
+        StoreGray(masks, rgb_data + i, _mm_packus_epi16(_mm256_castsi256_si128(gray),
+                                                 _mm256_extracti128_si256(gray, 1)));
+    }
+
+    ApplyScalar(rgb_data + i, size - i);
+}
+
+#undef PNG_ENCODER_GRAY_HELPER
+
+#endif
+
+}  // namespace
+
+void GrayscaleFilter::Apply(std::vector<uint8_t>& rgb_data) {
+    Apply(rgb_data.data(), rgb_data.size());
+}
+
+void GrayscaleFilter::Apply(uint8_t* rgb_data, size_t size) {
+    static const SIMDLevel level = PNGFilterKernels::DetectLevel();
+    Apply(rgb_data, size, level);
+}
+
+void GrayscaleFilter::Apply(uint8_t* rgb_data, size_t size, SIMDLevel level) {
+    if (!PNGFilterKernels::IsSupported(level)) {
+        throw std::runtime_error("SIMD level is not supported by this CPU");
+    }
+
+    switch (level) {
+#ifdef PNG_ENCODER_X86
+        case SIMDLevel::SSE41:
+            ApplySSE41(rgb_data, size);
+            break;
+        case SIMDLevel::AVX2:
+            ApplyAVX2(rgb_data, size);
+            break;
+#endif
+        default:
+            ApplyScalar(rgb_data, size);
+            break;
+    }
+}
@@ -1,9 +1,20 @@
 // image_loader.cpp
 #include "../include/image_loader.h"
+#include "../include/encode_stats.h"
+#include <algorithm>
 #include <fstream>
 #include <stdexcept>
 
+#if defined(__unix__) || defined(__APPLE__)
+#define PNG_ENCODER_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 RawImage ImageLoader::LoadRawImage(const std::string& path, uint64_t width, uint64_t height) {
+    StageTimer timer(EncodeStage::Load);
     RawImage image;
     image.width = width;
     image.height = height;
@@ -21,5 +32,127 @@ RawImage ImageLoader::LoadRawImage(const std::string& path, uint64_t width, uint
         throw std::runtime_error("Invalid file data! It must consist of HxWx3 bytes!");
     }
 
+    timer.AddBytesIn(image.data.size());
+    timer.AddBytesOut(image.data.size());
+    return image;
+}
+
+ImageView ImageLoader::FromMemory(const uint8_t* pixels, uint64_t width, uint64_t height,
+                                  size_t stride) {
+    ImageView image(pixels, width, height, stride);
+
+    if (pixels == nullptr && width * height != 0) {
+        throw std::runtime_error("Image pixels are missing!");
+    }
+
+    if (image.stride < width * 3) {
+        throw std::runtime_error("Row stride is shorter than a row of W*3 bytes!");
+    }
+
     return image;
-}
\ No newline at end of file
+}
+
+RawImageReader::RawImageReader(const std::string& path, uint64_t width, uint64_t height)
+    : file_(path, std::ios::binary), width_(width), height_(height), rows_read_(0) {
+    if (!file_) {
+        throw std::runtime_error("Cannot open raw image file!");
+    }
+}
+
+uint64_t RawImageReader::ReadRows(uint8_t* dst, uint64_t row_count) {
+    row_count = std::min(row_count, height_ - rows_read_);
+    const std::streamsize bytes = static_cast<std::streamsize>(row_count * width_ * 3);
+    StageTimer timer(EncodeStage::Load, bytes);
+    timer.AddBytesOut(bytes);
+
+    file_.read(reinterpret_cast<char*>(dst), bytes);
+
+    if (file_.gcount() != bytes) {
+        throw std::runtime_error("Invalid file data! It must consist of HxWx3 bytes!");
+    }
+
+    rows_read_ += row_count;
+    return row_count;
+}
+
+uint64_t RawImageReader::Width() const {
+    return width_;
+}
+
+uint64_t RawImageReader::Height() const {
+    return height_;
+}
+
+uint64_t RawImageReader::RowsRead() const {
+    return rows_read_;
+}
+
+MappedRawImage::MappedRawImage(const std::string& path, uint64_t width, uint64_t height)
+    : width_(width),
+      height_(height),
+      data_(nullptr),
+      size_(width * height * 3),
+      mapping_(nullptr),
+      mapping_size_(0) {
+    // Only the mapping itself: the pages are read later by whichever stage touches them
+    StageTimer timer(EncodeStage::Load, size_);
+    timer.AddBytesOut(size_);
+
+#ifdef PNG_ENCODER_HAVE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open raw image file!");
+    }
+
+    struct stat file_stat {};
+    if (::fstat(fd, &file_stat) != 0 || static_cast<uint64_t>(file_stat.st_size) < size_) {
+        ::close(fd);
+        throw std::runtime_error("Invalid file data! It must consist of HxWx3 bytes!");
+    }
+
+    if (size_ != 0) {
+        mapping_size_ = size_;
+        mapping_ = ::mmap(nullptr, mapping_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+
+    ::close(fd);
+
+    if (mapping_ == MAP_FAILED) {
+        mapping_ = nullptr;
+        throw std::runtime_error("Cannot map raw image file!");
+    }
+
+    if (mapping_ != nullptr) {
+        // Hints only: the pipeline walks the image once from top to bottom
+        ::madvise(mapping_, mapping_size_, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+        ::madvise(mapping_, mapping_size_, MADV_HUGEPAGE);
+#endif
+        data_ = static_cast<const uint8_t*>(mapping_);
+    }
+#else
+    fallback_ = ImageLoader::LoadRawImage(path, width, height).data;
+    data_ = fallback_.data();
+#endif
+}
+
+MappedRawImage::~MappedRawImage() {
+#ifdef PNG_ENCODER_HAVE_MMAP
+    if (mapping_ != nullptr) {
+        ::munmap(mapping_, mapping_size_);
+    }
+#endif
+}
+
+PixelView MappedRawImage::View() const {
+    return PixelView(data_, size_);
+}
+
+uint64_t MappedRawImage::Width() const {
+    return width_;
+}
+
+uint64_t MappedRawImage::Height() const {
+    return height_;
+}
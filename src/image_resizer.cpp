@@ -0,0 +1,341 @@
+// image_resizer.cpp
+#include "../include/image_resizer.h"
+#include "../include/encode_stats.h"
+
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PNG_ENCODER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr size_t kChannels = 3;
+
+// Bilinear weights are 8-bit fixed point: a pair of weights always sums to 256
+constexpr uint32_t kWeightOne = 256;
+
+// acc[i] += row[i] for i in [0, size)
+using AccumulateRowKernel = void (*)(const uint8_t* row, size_t size, uint32_t* acc);
+
+// out[i] = row0[i] * weight0 + row1[i] * weight1, weights summing to kWeightOne
+using BlendRowsKernel = void (*)(const uint8_t* row0, const uint8_t* row1, size_t size,
+                                 uint16_t weight0, uint16_t weight1, uint16_t* out);
+
+struct ResizeKernels {
+    AccumulateRowKernel accumulate;
+    BlendRowsKernel blend;
+};
+
+void AccumulateRowScalar(const uint8_t* row, size_t size, uint32_t* acc) {
+    for (size_t i = 0; i < size; ++i) {
+        acc[i] += row[i];
+    }
+}
+
+void BlendRowsScalar(const uint8_t* row0, const uint8_t* row1, size_t size, uint16_t weight0,
+                     uint16_t weight1, uint16_t* out) {
+    for (size_t i = 0; i < size; ++i) {
+        out[i] = static_cast<uint16_t>(row0[i] * weight0 + row1[i] * weight1);
+    }
+}
+
+constexpr ResizeKernels kScalarKernels = {AccumulateRowScalar, BlendRowsScalar};
+
+#ifdef PNG_ENCODER_X86
+
+// SSE4.1: 8 bytes widened per step
+__attribute__((target("sse4.1"))) void AccumulateRowSSE41(const uint8_t* row, size_t size,
+                                                          uint32_t* acc) {
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + i));
+        __m128i low = _mm_cvtepu8_epi32(bytes);
+        __m128i high = _mm_cvtepu8_epi32(_mm_srli_si128(bytes, 4));
+
+        __m128i* out = reinterpret_cast<__m128i*>(acc + i);
+        _mm_storeu_si128(out, _mm_add_epi32(_mm_loadu_si128(out), low));
+        _mm_storeu_si128(out + 1, _mm_add_epi32(_mm_loadu_si128(out + 1), high));
+    }
+
+    AccumulateRowScalar(row + i, size - i, acc + i);
+}
+
+__attribute__((target("sse4.1"))) void BlendRowsSSE41(const uint8_t* row0, const uint8_t* row1,
+                                                      size_t size, uint16_t weight0,
+                                                      uint16_t weight1, uint16_t* out) {
+    const __m128i w0 = _mm_set1_epi16(static_cast<short>(weight0));
+    const __m128i w1 = _mm_set1_epi16(static_cast<short>(weight1));
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        __m128i a = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row0 + i)));
+        __m128i b = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row1 + i)));
+
+        // 255 * 256 fits in 16 bits, so the low half of the products is exact
+        __m128i sum = _mm_add_epi16(_mm_mullo_epi16(a, w0), _mm_mullo_epi16(b, w1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), sum);
+    }
+
+    BlendRowsScalar(row0 + i, row1 + i, size - i, weight0, weight1, out + i);
+}
+
+// AVX2: 16 bytes widened per step
+__attribute__((target("avx2"))) void AccumulateRowAVX2(const uint8_t* row, size_t size,
+                                                      uint32_t* acc) {
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        __m256i low = _mm256_cvtepu8_epi32(bytes);
+        __m256i high = _mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8));
+
+        __m256i* out = reinterpret_cast<__m256i*>(acc + i);
+        _mm256_storeu_si256(out, _mm256_add_epi32(_mm256_loadu_si256(out), low));
+        _mm256_storeu_si256(out + 1, _mm256_add_epi32(_mm256_loadu_si256(out + 1), high));
+    }
+
+    AccumulateRowScalar(row + i, size - i, acc + i);
+}
+
+__attribute__((target("avx2"))) void BlendRowsAVX2(const uint8_t* row0, const uint8_t* row1,
+                                                  size_t size, uint16_t weight0,
+                                                  uint16_t weight1, uint16_t* out) {
+    const __m256i w0 = _mm256_set1_epi16(static_cast<short>(weight0));
+    const __m256i w1 = _mm256_set1_epi16(static_cast<short>(weight1));
+
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m256i a =
+            _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + i)));
+        __m256i b =
+            _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + i)));
+
+        __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(a, w0), _mm256_mullo_epi16(b, w1));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), sum);
+    }
+
+    BlendRowsScalar(row0 + i, row1 + i, size - i, weight0, weight1, out + i);
+}
+
+constexpr ResizeKernels kSSE41Kernels = {AccumulateRowSSE41, BlendRowsSSE41};
+constexpr ResizeKernels kAVX2Kernels = {AccumulateRowAVX2, BlendRowsAVX2};
+
+#endif
+
+const ResizeKernels& KernelsFor(SIMDLevel level) {
+    if (!PNGFilterKernels::IsSupported(level)) {
+        throw std::runtime_error("SIMD level is not supported by this CPU");
+    }
+
+    switch (level) {
+#ifdef PNG_ENCODER_X86
+        case SIMDLevel::SSE41:
+            return kSSE41Kernels;
+        case SIMDLevel::AVX2:
+            return kAVX2Kernels;
+#endif
+        default:
+            return kScalarKernels;
+    }
+}
+
+// Source span [begin, end) of output index i out of dst; at least one source element
+void BoxSpan(uint64_t i, uint64_t src, uint64_t dst, uint64_t& begin, uint64_t& end) {
+    begin = i * src / dst;
+    end = std::max((i + 1) * src / dst, begin + 1);
+}
+
+// Neighbours and weight of the second one for output index i, pixel centers aligned
+void BilinearTap(uint64_t i, uint64_t src, uint64_t dst, uint64_t& first, uint64_t& second,
+                 uint32_t& weight) {
+    // Center of the output pixel in source coordinates, in 1/256 of a pixel
+    const int64_t center = static_cast<int64_t>(((2 * i + 1) * src * kWeightOne) / (2 * dst)) -
+                           static_cast<int64_t>(kWeightOne / 2);
+    const int64_t clamped =
+        std::clamp<int64_t>(center, 0, static_cast<int64_t>((src - 1) * kWeightOne));
+
+    first = static_cast<uint64_t>(clamped) / kWeightOne;
+    second = std::min(first + 1, src - 1);
+    weight = static_cast<uint32_t>(static_cast<uint64_t>(clamped) % kWeightOne);
+}
+
+void ResizeBox(const ImageView& image, uint64_t width, uint64_t height,
+               const ResizeKernels& kernels, uint8_t* out) {
+    const size_t src_row_bytes = image.width * kChannels;
+
+    std::vector<uint64_t> x_begin(width);
+    std::vector<uint64_t> x_end(width);
+    for (uint64_t x = 0; x < width; ++x) {
+        BoxSpan(x, image.width, width, x_begin[x], x_end[x]);
+    }
+
+    std::vector<uint32_t> acc(src_row_bytes);
+
+    for (uint64_t y = 0; y < height; ++y) {
+        uint64_t y_begin = 0;
+        uint64_t y_end = 0;
+        BoxSpan(y, image.height, height, y_begin, y_end);
+
+        // Column sums over the rows of the box, then box sums along the row
+        std::fill(acc.begin(), acc.end(), 0);
+        for (uint64_t sy = y_begin; sy < y_end; ++sy) {
+            kernels.accumulate(image.Row(sy), src_row_bytes, acc.data());
+        }
+
+        uint8_t* dst = out + y * width * kChannels;
+        for (uint64_t x = 0; x < width; ++x) {
+            const uint64_t area = (x_end[x] - x_begin[x]) * (y_end - y_begin);
+
+            for (size_t c = 0; c < kChannels; ++c) {
+                uint64_t sum = 0;
+                for (uint64_t sx = x_begin[x]; sx < x_end[x]; ++sx) {
+                    sum += acc[sx * kChannels + c];
+                }
+
+                dst[x * kChannels + c] = static_cast<uint8_t>((sum + area / 2) / area);
+            }
+        }
+    }
+}
+
+void ResizeBilinear(const ImageView& image, uint64_t width, uint64_t height,
+                    const ResizeKernels& kernels, uint8_t* out) {
+    const size_t src_row_bytes = image.width * kChannels;
+
+    std::vector<uint64_t> x_first(width);
+    std::vector<uint64_t> x_second(width);
+    std::vector<uint32_t> x_weight(width);
+    for (uint64_t x = 0; x < width; ++x) {
+        BilinearTap(x, image.width, width, x_first[x], x_second[x], x_weight[x]);
+    }
+
+    std::vector<uint16_t> blended(src_row_bytes);
+
+    for (uint64_t y = 0; y < height; ++y) {
+        uint64_t y_first = 0;
+        uint64_t y_second = 0;
+        uint32_t y_weight = 0;
+        BilinearTap(y, image.height, height, y_first, y_second, y_weight);
+
+        kernels.blend(image.Row(y_first), image.Row(y_second), src_row_bytes,
+                      static_cast<uint16_t>(kWeightOne - y_weight),
+                      static_cast<uint16_t>(y_weight), blended.data());
+
+        uint8_t* dst = out + y * width * kChannels;
+        for (uint64_t x = 0; x < width; ++x) {
+            const uint16_t* first = blended.data() + x_first[x] * kChannels;
+            const uint16_t* second = blended.data() + x_second[x] * kChannels;
+
+            for (size_t c = 0; c < kChannels; ++c) {
+                const uint32_t value =
+                    first[c] * (kWeightOne - x_weight[x]) + second[c] * x_weight[x];
+                dst[x * kChannels + c] =
+                    static_cast<uint8_t>((value + kWeightOne * kWeightOne / 2) /
+                                         (kWeightOne * kWeightOne));
+            }
+        }
+    }
+}
+
+}  // namespace
+
+OutputSize OutputSize::Parse(const std::string& size_name) {
+    OutputSize size;
+
+    try {
+        if (size_name.rfind("1/", 0) == 0) {
+            size.divisor = std::stoull(size_name.substr(2));
+        } else if (size_name.size() > 1 && size_name.back() == 'w') {
+            size.width = std::stoull(size_name.substr(0, size_name.size() - 1));
+        }
+    } catch (const std::exception&) {
+        size = OutputSize{};
+    }
+
+    if (size.divisor == 0 && size.width == 0) {
+        throw std::runtime_error("Unknown output size '" + size_name +
+                                 "', expected 1/<N> or <width>w");
+    }
+
+    return size;
+}
+
+std::vector<OutputSize> OutputSize::ParseList(const std::string& size_list) {
+    std::vector<OutputSize> sizes;
+    std::stringstream stream(size_list);
+    std::string size_name;
+
+    while (std::getline(stream, size_name, ',')) {
+        if (!size_name.empty()) {
+            sizes.push_back(Parse(size_name));
+        }
+    }
+
+    return sizes;
+}
+
+void OutputSize::Dimensions(uint64_t source_width, uint64_t source_height, uint64_t& out_width,
+                            uint64_t& out_height) const {
+    if (width != 0) {
+        out_width = width;
+        out_height = source_width != 0 ? (source_height * width + source_width / 2) / source_width
+                                       : 0;
+    } else {
+        out_width = source_width / divisor;
+        out_height = source_height / divisor;
+    }
+
+    out_width = std::max<uint64_t>(out_width, 1);
+    out_height = std::max<uint64_t>(out_height, 1);
+}
+
+ResizeFilter ImageResizer::ParseFilter(const std::string& filter_name) {
+    std::string lower_name = filter_name;
+    std::transform(lower_name.begin(), lower_name.end(), lower_name.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    if (lower_name == "box") {
+        return ResizeFilter::Box;
+    }
+
+    if (lower_name == "bilinear") {
+        return ResizeFilter::Bilinear;
+    }
+
+    throw std::runtime_error("Unknown resize filter: " + filter_name);
+}
+
+void ImageResizer::Resize(const ImageView& image, uint64_t width, uint64_t height,
+                          ResizeFilter filter, std::vector<uint8_t>& out) {
+    static const SIMDLevel level = PNGFilterKernels::DetectLevel();
+    Resize(image, width, height, filter, out, level);
+}
+
+void ImageResizer::Resize(const ImageView& image, uint64_t width, uint64_t height,
+                          ResizeFilter filter, std::vector<uint8_t>& out, SIMDLevel level) {
+    if (image.width == 0 || image.height == 0 || width == 0 || height == 0) {
+        throw std::runtime_error("Cannot resize an empty image");
+    }
+
+    StageTimer timer(EncodeStage::Resize, image.width * image.height * kChannels);
+    const ResizeKernels& kernels = KernelsFor(level);
+    out.resize(width * height * kChannels);
+    timer.AddBytesOut(out.size());
+
+    if (filter == ResizeFilter::Bilinear) {
+        ResizeBilinear(image, width, height, kernels, out.data());
+    } else {
+        ResizeBox(image, width, height, kernels, out.data());
+    }
+}
+
+std::vector<uint8_t> ImageResizer::Resize(const ImageView& image, uint64_t width,
+                                          uint64_t height, ResizeFilter filter) {
+    std::vector<uint8_t> out;
+    Resize(image, width, height, filter, out);
+    return out;
+}
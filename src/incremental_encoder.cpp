@@ -0,0 +1,242 @@
+// incremental_encoder.cpp
+#include "../include/incremental_encoder.h"
+#include "../include/color_reduction.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+// 64-bit hash of one row of pixels; equal hashes are taken for equal rows
+uint64_t HashRow(const uint8_t* row, size_t size) {
+    constexpr uint64_t kMultiplier = 0xFF51AFD7ED558CCDull;
+    uint64_t hash = 0x9E3779B97F4A7C15ull ^ size;
+    size_t i = 0;
+
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, row + i, 8);
+        hash = (hash ^ word) * kMultiplier;
+        hash ^= hash >> 29;
+    }
+
+    uint64_t tail = 0;
+    std::memcpy(&tail, row + i, size - i);
+    hash = (hash ^ tail) * kMultiplier;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+// Splits [0, count) into at most pool->Size() * 4 parts of at least min_size
+template <typename Body>
+void ForEachPart(ThreadPool* pool, uint64_t count, uint64_t min_size, Body body) {
+    uint64_t parts = 1;
+    if (pool != nullptr && pool->Size() > 1) {
+        parts = std::max<uint64_t>(std::min<uint64_t>(pool->Size() * 4, count / min_size), 1);
+    }
+
+    if (parts == 1) {
+        body(0, count);
+        return;
+    }
+
+    pool->ParallelFor(parts, [&](size_t part) {
+        body(count * part / parts, count * (part + 1) / parts);
+    });
+}
+
+}  // namespace
+
+IncrementalStats& IncrementalStats::operator+=(const IncrementalStats& other) {
+    frames += other.frames;
+    rows += other.rows;
+    rows_changed += other.rows_changed;
+    rows_filtered += other.rows_filtered;
+    blocks += other.blocks;
+    blocks_compressed += other.blocks_compressed;
+    return *this;
+}
+
+IncrementalEncoder::IncrementalEncoder(const EncodeOptions& options, size_t block_size)
+    : options_(options), block_size_(block_size), writer_(options.idat_size) {
+    options_.compression.Validate();
+    if (options_.compression.backend != DeflateBackendType::Zlib) {
+        throw std::runtime_error("Incremental encoding only supports the zlib backend");
+    }
+    if (options_.interlace != PNGInterlace::None) {
+        throw std::runtime_error("Incremental encoding does not support interlacing");
+    }
+}
+
+void IncrementalEncoder::Encode(const ImageView& frame, OutputSink& sink, ThreadPool* pool) {
+    bool full = !has_previous_ || frame.width != width_ || frame.height != height_;
+    has_previous_ = false;
+    width_ = frame.width;
+    height_ = frame.height;
+
+    stats_ = IncrementalStats{};
+    stats_.frames = 1;
+    stats_.rows = height_;
+
+    HashRows(frame, pool);
+    changed_.assign(height_, 1);
+    if (!full) {
+        for (uint64_t y = 0; y < height_; ++y) {
+            changed_[y] = new_hashes_[y] != row_hashes_[y];
+        }
+    }
+    row_hashes_.swap(new_hashes_);
+
+    for (uint8_t changed : changed_) {
+        stats_.rows_changed += changed;
+    }
+
+    // The format is kept while the changed rows fit in it; a new color analyzes the frame
+    if (options_.reduce_colors &&
+        (full || !ColorReducer::Fits(frame, changed_, format_, options_.color_filter,
+                                     options_.perlin_strength))) {
+        PixelFormat format =
+            ColorReducer::Analyze(frame, options_.color_filter, options_.perlin_strength);
+        full = full || !(format == format_);
+        format_ = std::move(format);
+    }
+
+    if (full) {
+        changed_.assign(height_, 1);
+        stats_.rows_changed = height_;
+    }
+
+    FilterRows(frame, full, pool);
+    CompressBlocks(full, pool);
+
+    writer_.WritePNG(sink, width_, height_, compressed_, format_);
+    has_previous_ = true;
+}
+
+const IncrementalStats& IncrementalEncoder::LastStats() const {
+    return stats_;
+}
+
+PixelView IncrementalEncoder::Compressed() const {
+    return compressed_;
+}
+
+void IncrementalEncoder::Reset() {
+    has_previous_ = false;
+}
+
+void IncrementalEncoder::HashRows(const ImageView& frame, ThreadPool* pool) {
+    new_hashes_.resize(height_);
+    const size_t row_bytes = frame.width * 3;
+
+    ForEachPart(pool, height_, PNGFilter::kMinBandRows, [&](uint64_t begin, uint64_t end) {
+        for (uint64_t y = begin; y < end; ++y) {
+            new_hashes_[y] = HashRow(frame.Row(y), row_bytes);
+        }
+    });
+}
+
+void IncrementalEncoder::FilterRows(const ImageView& frame, bool full, ThreadPool* pool) {
+    // Same choice as PNGEncoder::Encode: indexed rows stay unfiltered
+    PNGFilterStrategy png_filter = options_.png_filter;
+    if (format_.color_type == PNGColorType::Indexed &&
+        (png_filter == PNGFilterStrategy::MinSum || png_filter == PNGFilterStrategy::Entropy)) {
+        png_filter = PNGFilterStrategy::None;
+    }
+
+    if (full) {
+        PNGFilter::Apply(frame, png_filter, options_.color_filter, options_.perlin_strength,
+                         format_, pool, filter_buffers_);
+        refiltered_.assign(height_, 1);
+        stats_.rows_filtered = height_;
+        return;
+    }
+
+    // Up, Average, Paeth and the adaptive choice read the row above
+    refiltered_.resize(height_);
+    for (uint64_t y = 0; y < height_; ++y) {
+        refiltered_[y] = changed_[y] || (y > 0 && changed_[y - 1]);
+        stats_.rows_filtered += refiltered_[y];
+    }
+
+    // Runs of dirty rows, long runs cut so a pool has a few ranges per worker
+    uint64_t max_rows = height_;
+    if (pool != nullptr && pool->Size() > 1) {
+        max_rows = std::max<uint64_t>(stats_.rows_filtered / (pool->Size() * 4),
+                                      PNGFilter::kMinBandRows);
+    }
+
+    std::vector<RowRange> ranges;
+    for (uint64_t y = 0; y < height_;) {
+        if (!refiltered_[y]) {
+            ++y;
+            continue;
+        }
+
+        const uint64_t begin = y;
+        while (y < height_ && refiltered_[y] && y - begin < max_rows) {
+            ++y;
+        }
+        ranges.push_back({begin, y});
+    }
+
+    if (!ranges.empty()) {
+        PNGFilter::ApplyRows(frame, png_filter, options_.color_filter, options_.perlin_strength,
+                             format_, ranges, pool, filter_buffers_);
+    }
+}
+
+void IncrementalEncoder::CompressBlocks(bool full, ThreadPool* pool) {
+    const CompressionProfile& profile = options_.compression;
+    const std::vector<uint8_t>& scanlines = filter_buffers_.scanlines;
+    const size_t row_size = format_.RowBytes(width_) + 1;
+
+    // The block layout of ParallelDeflateCompressor::Compress
+    const uint64_t block_rows = std::max<size_t>(block_size_ / row_size, 1);
+    const size_t block_bytes = block_rows * row_size;
+    const size_t block_count =
+        std::max<size_t>((scanlines.size() + block_bytes - 1) / block_bytes, 1);
+    const size_t window = size_t{1} << profile.window_bits;
+
+    if (blocks_.size() != block_count) {
+        blocks_.resize(block_count);
+        full = true;
+    }
+
+    std::vector<size_t> dirty;
+    for (size_t i = 0; i < block_count; ++i) {
+        const size_t begin = std::min(i * block_bytes, scanlines.size());
+        const uint64_t first_row = (begin - std::min(begin, window)) / row_size;
+        const uint64_t end_row = std::min<uint64_t>((i + 1) * block_rows, height_);
+
+        bool changed = full;
+        for (uint64_t y = first_row; y < end_row && !changed; ++y) {
+            changed = refiltered_[y] != 0;
+        }
+
+        if (changed) {
+            dirty.push_back(i);
+        }
+    }
+
+    auto compress = [&](size_t k) {
+        const size_t i = dirty[k];
+        const size_t begin = std::min(i * block_bytes, scanlines.size());
+        const size_t end = std::min(begin + block_bytes, scanlines.size());
+        ParallelDeflateCompressor::CompressBlock(scanlines.data(), begin, end,
+                                                 i + 1 == block_count, profile, blocks_[i]);
+    };
+
+    if (pool != nullptr && dirty.size() > 1) {
+        pool->ParallelFor(dirty.size(), compress);
+    } else {
+        for (size_t k = 0; k < dirty.size(); ++k) {
+            compress(k);
+        }
+    }
+
+    stats_.blocks = block_count;
+    stats_.blocks_compressed = dirty.size();
+    ParallelDeflateCompressor::Join(blocks_, profile, compressed_);
+}
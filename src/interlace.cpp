@@ -0,0 +1,55 @@
+// interlace.cpp
+#include "../include/interlace.h"
+
+#include <cstring>
+
+namespace {
+
+constexpr size_t kBytesPerPixel = 3;
+
+// Positions start, start + step, ... below size
+uint64_t CountPositions(uint64_t size, uint64_t start, uint64_t step) {
+    return size > start ? (size - start + step - 1) / step : 0;
+}
+
+}  // namespace
+
+uint64_t Adam7::PassWidth(size_t pass, uint64_t width) {
+    return CountPositions(width, kPasses[pass].x0, kPasses[pass].dx);
+}
+
+uint64_t Adam7::PassHeight(size_t pass, uint64_t height) {
+    return CountPositions(height, kPasses[pass].y0, kPasses[pass].dy);
+}
+
+std::array<size_t, Adam7::kPassCount + 1> Adam7::PassOffsets(uint64_t width, uint64_t height,
+                                                             const PixelFormat& format) {
+    std::array<size_t, kPassCount + 1> offsets{};
+
+    for (size_t pass = 0; pass < kPassCount; ++pass) {
+        const uint64_t pass_width = PassWidth(pass, width);
+        const uint64_t pass_height = pass_width == 0 ? 0 : PassHeight(pass, height);
+        offsets[pass + 1] = offsets[pass] + (format.RowBytes(pass_width) + 1) * pass_height;
+    }
+
+    return offsets;
+}
+
+void Adam7::ExtractRow(const uint8_t* row, uint64_t width, size_t pass, uint8_t* out) {
+    const uint64_t pass_width = PassWidth(pass, width);
+    const size_t step = kPasses[pass].dx * kBytesPerPixel;
+    const uint8_t* in = row + kPasses[pass].x0 * kBytesPerPixel;
+
+    // The last pass takes whole odd rows; in place they do not move at all
+    if (kPasses[pass].dx == 1) {
+        std::memmove(out, in, pass_width * kBytesPerPixel);
+        return;
+    }
+
+    // Byte copies: in place the first pixel of a pass may be its own source
+    for (uint64_t i = 0; i < pass_width; ++i, in += step, out += kBytesPerPixel) {
+        out[0] = in[0];
+        out[1] = in[1];
+        out[2] = in[2];
+    }
+}
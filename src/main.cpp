@@ -1,70 +1,288 @@
 // main.cpp
-#include "../include/image_loader.h"
-#include "../include/filter.h"
-#include "../include/color_filter.h"
-#include "../include/deflate.h"
-#include "../include/png_writer.h"
-
-#include <algorithm>
-#include <cctype>
+#include "../include/batch_encoder.h"
+#include "../include/encode_cache.h"
+#include "../include/encode_stats.h"
+#include "../include/encoder.h"
+#include "../include/encoder_context.h"
+#include "../include/sequence_encoder.h"
+#include "../include/thread_pool.h"
+
 #include <cstdint>
+#include <filesystem>
+#include <iomanip>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
 
-int main(int argc, char* argv[]) {
-    if (argc != 5 && argc != 6 && argc != 7) {
-        std::cerr << "Usage:\n"
-                     "  png_encoder in.raw out.png W H\n"
-                     "  png_encoder in.raw out.png W H <filter>\n"
-                     "  png_encoder in.raw out.png W H perlin <0-100>\n";
-        return 1;
+namespace {
+
+void PrintUsage() {
+    std::cerr << "Usage:\n"
+                 "  png_encoder in.raw out.png W H [options]\n"
+                 "  png_encoder in.raw out.png W H <filter> [options]\n"
+                 "  png_encoder in.raw out.png W H perlin <0-100> [options]\n"
+                 "  png_encoder --batch=<manifest> [options]\n"
+                 "  png_encoder --batch=<raw dir> --output-dir=<dir> [options]\n"
+                 "  png_encoder --sequence frames.raw out-%05d.png W H [filter] [options]\n"
+                 "Options:\n"
+              << PNGEncoder::OptionsHelp()
+              << "Batch options:\n"
+                 "  --batch=<manifest|dir>  manifest lines use the single-file syntax above;\n"
+                 "                          in a directory every <name>-<W>x<H>.raw is encoded\n"
+                 "  --output-dir=<dir>      destination for directory batches\n"
+                 "  --max-memory=<MiB>      memory budget of the jobs in flight (default: 1024)\n"
+                 "  --threads=<N>           number of files encoded concurrently\n"
+                 "Sequence options:\n"
+                 "  --sequence              frames.raw holds W x H frames back to back; load,\n"
+                 "                          filter, compress and write run as pipelined stages\n"
+                 "  --queue-depth=<N>       frames queued between two stages (default: 4)\n"
+                 "  --repeat=<N>            encode the frames N times (default: 1)\n"
+                 "  --incremental           re-filter and recompress only what changed since\n"
+                 "                          the previous frame; frames are encoded in order\n"
+                 "  --threads=<N>           threads shared by the filter and compress stages\n"
+                 "Cache options (single files and batches):\n"
+                 "  --cache=<dir>           reuse the PNG of an input already encoded with the\n"
+                 "                          same options, keyed by a hash of input and options\n"
+                 "  --cache-size=<MiB>      least recently used entries are evicted above this\n"
+                 "                          size (default: 1024)\n"
+                 "Instrumentation:\n"
+                 "  --stats[=text|json]     time, bytes and allocations per stage of all images\n";
+}
+
+// Matches "--name=value" and stores the value
+bool TakeOption(const std::string& arg, const std::string& name, std::string& value) {
+    const std::string prefix = "--" + name + "=";
+
+    if (arg.rfind(prefix, 0) != 0) {
+        return false;
     }
 
-    const std::string input_file = argv[1];
-    const std::string output_file = argv[2];
-    const uint64_t image_width = std::stoull(argv[3]);
-    const uint64_t image_height = std::stoull(argv[4]);
+    value = arg.substr(prefix.size());
+    return true;
+}
 
-    std::string filter_option = "none";
-    float perlin_strength = 0.f;
+double MegabytesPerSecond(uint64_t bytes, double seconds) {
+    return seconds > 0.0 ? bytes / 1e6 / seconds : 0.0;
+}
 
-    if (argc >= 6) {
-        filter_option = argv[5];
-        std::transform(filter_option.begin(), filter_option.end(), filter_option.begin(),
-                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+void PrintCacheStats(const EncodeCache& cache) {
+    const CacheStats stats = cache.Stats();
+    std::cout << "cache: " << stats.hits << " hits, " << stats.misses << " misses, "
+              << stats.stores << " stored, " << stats.evictions << " evicted, " << stats.bytes
+              << " bytes in " << cache.Directory() << '\n';
+}
 
-        if (filter_option == "perlin") {
-            if (argc == 7) {
-                perlin_strength = std::stof(argv[6]);
-            }
-        } else if (argc == 7) {
-            std::cerr << "Error: extra parameter after '" << filter_option << "' is not allowed.\n";
+int RunBatch(const std::string& batch_source, const std::string& output_dir,
+             const std::vector<std::string>& job_args, size_t threads, uint64_t max_memory,
+             EncodeCache* cache) {
+    std::vector<EncodeJob> jobs;
+
+    if (std::filesystem::is_directory(batch_source)) {
+        if (output_dir.empty()) {
+            std::cerr << "Error: --output-dir is required for a directory batch.\n";
             return 1;
         }
+
+        std::vector<std::string> skipped;
+        jobs = BatchEncoder::ScanDirectory(batch_source, output_dir, job_args, &skipped);
+
+        for (const auto& path : skipped) {
+            std::cerr << "Skipped " << path << ": no <W>x<H> in the file name\n";
+        }
+    } else {
+        jobs = BatchEncoder::ReadManifest(batch_source, job_args);
+    }
+
+    BatchEncoder batch(threads, max_memory);
+    batch.SetCache(cache);
+    BatchReport report = batch.Run(jobs);
+
+    std::cout << std::fixed << std::setprecision(1);
+    for (const auto& result : report.results) {
+        if (result.ok) {
+            std::cout << "ok    " << result.job.output_path << "  " << result.seconds * 1000.0
+                      << " ms  " << MegabytesPerSecond(result.input_bytes, result.seconds)
+                      << " MB/s  " << result.output_bytes << " bytes\n";
+        } else {
+            std::cout << "FAIL  " << result.job.output_path << "  " << result.error << '\n';
+        }
+    }
+
+    std::cout << report.results.size() - report.failed << "/" << report.results.size()
+              << " files in " << report.wall_seconds << " s, "
+              << MegabytesPerSecond(report.input_bytes, report.wall_seconds) << " MB/s in, "
+              << report.input_bytes << " -> " << report.output_bytes << " bytes\n";
+
+    if (cache != nullptr) {
+        PrintCacheStats(*cache);
+    }
+
+    return report.failed == 0 ? 0 : 1;
+}
+
+int RunSequence(const EncodeJob& job, const SequenceOptions& options) {
+    SequenceReport report = SequenceEncoder::EncodeFile(job, options);
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << report.frames << " frames in " << report.wall_seconds << " s, "
+              << report.FramesPerSecond() << " fps, "
+              << MegabytesPerSecond(report.input_bytes, report.wall_seconds) << " MB/s in, "
+              << report.input_bytes << " -> " << report.output_bytes << " bytes\n";
+
+    if (options.incremental) {
+        const IncrementalStats& work = report.incremental;
+        std::cout << "incremental: " << work.rows_changed << "/" << work.rows
+                  << " rows changed, " << work.rows_filtered << " filtered, "
+                  << work.blocks_compressed << "/" << work.blocks << " blocks compressed\n";
+    }
+
+    // Utilization near 100% marks the stage that limits the frame rate
+    for (const StageStats& stage : report.stages) {
+        const double capacity = report.wall_seconds * static_cast<double>(stage.threads);
+        std::cout << "stage " << std::setw(10) << std::left << stage.name << std::right
+                  << stage.threads << " threads  "
+                  << (stage.frames != 0 ? stage.busy_seconds * 1000.0 / stage.frames : 0.0)
+                  << " ms/frame  " << (capacity > 0.0 ? stage.busy_seconds * 100.0 / capacity : 0.0)
+                  << "% busy\n";
+    }
+
+    // Queues named after the stage they feed; a queue that stays full sits in front of
+    // the bottleneck, one that stays empty behind it
+    for (const SequenceQueueStats& queue : report.queues) {
+        std::cout << "queue " << std::setw(10) << std::left << queue.name << std::right
+                  << "depth avg " << queue.stats.AverageDepth() << " max " << queue.stats.max_depth
+                  << "/" << queue.capacity << "  full waits " << queue.stats.full_waits
+                  << "  empty waits " << queue.stats.empty_waits << '\n';
+    }
+
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    std::string batch_source;
+    std::string output_dir;
+    std::string max_memory_option = "1024";
+    std::string threads_option = std::to_string(ThreadPool::DefaultThreadCount());
+    std::string queue_depth_option = "4";
+    std::string repeat_option = "1";
+    std::string cache_dir;
+    std::string cache_size_option = "1024";
+    bool sequence = false;
+    bool incremental = false;
+    std::string stats_option;
+    std::vector<std::string> job_args;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+
+        if (TakeOption(arg, "batch", batch_source) ||
+            TakeOption(arg, "output-dir", output_dir) ||
+            TakeOption(arg, "max-memory", max_memory_option) ||
+            TakeOption(arg, "threads", threads_option) ||
+            TakeOption(arg, "queue-depth", queue_depth_option) ||
+            TakeOption(arg, "repeat", repeat_option) ||
+            TakeOption(arg, "cache", cache_dir) ||
+            TakeOption(arg, "cache-size", cache_size_option) ||
+            TakeOption(arg, "stats", stats_option)) {
+            continue;
+        }
+
+        if (arg == "--incremental") {
+            incremental = true;
+            continue;
+        }
+
+        if (arg == "--sequence") {
+            sequence = true;
+            continue;
+        }
+
+        if (arg == "--stats") {
+            stats_option = "text";
+            continue;
+        }
+
+        job_args.push_back(arg);
     }
 
+    size_t threads = 0;
+    EncodeJob job;
+    SequenceOptions sequence_options;
+
     try {
-        RawImage raw_image = ImageLoader::LoadRawImage(input_file, image_width, image_height);
+        threads = std::stoull(threads_option);
+        sequence_options.queue_depth = std::stoull(queue_depth_option);
+        sequence_options.repeat = std::stoull(repeat_option);
+        sequence_options.incremental = incremental;
 
-        ColorFilterType filter_type = ColorFilter::Parse(filter_option);
+        if (!stats_option.empty() && stats_option != "text" && stats_option != "json") {
+            throw std::runtime_error("Unknown stats format: " + stats_option);
+        }
+        if (!stats_option.empty() && !StatsCollector::kEnabled) {
+            throw std::runtime_error("--stats needs a build with PNG_ENCODER_ENABLE_STATS=ON");
+        }
 
-        std::vector<uint8_t> filtered_rgb_data = ColorFilter::Apply(
-            raw_image.data, image_width, image_height, filter_type, perlin_strength);
+        if (sequence && !cache_dir.empty()) {
+            throw std::runtime_error("--cache cannot be combined with --sequence");
+        }
 
-        std::vector<uint8_t> scanlines =
-            PNGFilter::Apply(filtered_rgb_data, image_width, image_height);
+        if (batch_source.empty()) {
+            job_args.push_back("--threads=" + threads_option);
+            job = PNGEncoder::ParseJob(job_args);
+        }
+    } catch (const std::exception& ex) {
+        std::cerr << "Error: " << ex.what() << '\n';
+        PrintUsage();
+        return 1;
+    }
+
+    // Collects from every thread working for this run while --stats is given
+    StatsCollector collector;
+    ScopedStatsCollector stats_scope(stats_option.empty() ? nullptr : &collector);
+    int status = 0;
 
-        std::vector<uint8_t> compressed_data = DeflateCompressor::Compress(scanlines);
+    try {
+        std::unique_ptr<EncodeCache> cache;
+        if (!cache_dir.empty()) {
+            cache = std::make_unique<EncodeCache>(cache_dir, std::stoull(cache_size_option) << 20);
+        }
 
-        PNGWriter png_writer;
-        png_writer.WritePNG(output_file, image_width, image_height, compressed_data);
+        if (!batch_source.empty()) {
+            status = RunBatch(batch_source, output_dir, job_args, threads,
+                              std::stoull(max_memory_option) << 20, cache.get());
+        } else if (sequence) {
+            status = RunSequence(job, sequence_options);
+        } else {
+            ThreadPool pool(threads);
+            EncoderContext context;
+            PNGEncoder::EncodeFile(job, pool, context, cache.get());
 
-        std::cout << "PNG file saved as " << output_file << '\n';
+            // With "-" stdout carries the PNG itself
+            if (job.output_path != "-") {
+                std::cout << "PNG file saved as " << job.output_path << '\n';
+                if (cache) {
+                    PrintCacheStats(*cache);
+                }
+            }
+        }
     } catch (const std::exception& ex) {
         std::cerr << "Error: " << ex.what() << '\n';
         return 1;
     }
 
-    return 0;
-}
\ No newline at end of file
+    if (!stats_option.empty()) {
+        const EncodeStats stats = collector.Snapshot();
+        std::ostream& out = job.output_path == "-" ? std::cerr : std::cout;
+
+        if (stats_option == "json") {
+            out << stats.ToJSON() << '\n';
+        } else {
+            out << stats.ToText();
+        }
+    }
+
+    return status;
+}
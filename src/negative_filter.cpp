@@ -1,8 +1,75 @@
 // negative_filter.cpp
 #include "../include/negative_filter.h"
 
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PNG_ENCODER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+void ApplyScalar(uint8_t* rgb_data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        rgb_data[i] = 255 - rgb_data[i];
+    }
+}
+
+#ifdef PNG_ENCODER_X86
+
+// 255 - v == v ^ 0xFF for bytes
+__attribute__((target("sse4.1"))) void ApplySSE41(uint8_t* rgb_data, size_t size) {
+    const __m128i ones = _mm_set1_epi8(-1);
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i* data = reinterpret_cast<__m128i*>(rgb_data + i);
+        _mm_storeu_si128(data, _mm_xor_si128(_mm_loadu_si128(data), ones));
+    }
+
+    ApplyScalar(rgb_data + i, size - i);
+}
+
+__attribute__((target("avx2"))) void ApplyAVX2(uint8_t* rgb_data, size_t size) {
+    const __m256i ones = _mm256_set1_epi8(-1);
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i* data = reinterpret_cast<__m256i*>(rgb_data + i);
+        _mm256_storeu_si256(data, _mm256_xor_si256(_mm256_loadu_si256(data), ones));
+    }
+
+    ApplyScalar(rgb_data + i, size - i);
+}
+
+#endif
+
+}  // namespace
+
 void NegativeFilter::Apply(std::vector<uint8_t>& rgb_data) {
-    for (auto& pixel_value : rgb_data) {
-        pixel_value = 255 - pixel_value;
+    Apply(rgb_data.data(), rgb_data.size());
+}
+
+void NegativeFilter::Apply(uint8_t* rgb_data, size_t size) {
+    static const SIMDLevel level = PNGFilterKernels::DetectLevel();
+    Apply(rgb_data, size, level);
+}
+
+void NegativeFilter::Apply(uint8_t* rgb_data, size_t size, SIMDLevel level) {
+    if (!PNGFilterKernels::IsSupported(level)) {
+        throw std::runtime_error("SIMD level is not supported by this CPU");
+    }
+
+    switch (level) {
+#ifdef PNG_ENCODER_X86
+        case SIMDLevel::SSE41:
+            ApplySSE41(rgb_data, size);
+            break;
+        case SIMDLevel::AVX2:
+            ApplyAVX2(rgb_data, size);
+            break;
+#endif
+        default:
+            ApplyScalar(rgb_data, size);
+            break;
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,146 @@
+// output_sink.cpp
+#include "../include/output_sink.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+
+// writev accepts at most IOV_MAX pieces per call
+constexpr size_t kMaxPiecesPerCall = 1024;
+
+// A regular file that other names share, e.g. a read-only cache entry hard-linked to the
+// output, is unlinked first so the PNG never writes through that inode. Every other file
+// is truncated in place and keeps its mode.
+int CreateOutput(const std::string& path) {
+    struct stat info;
+    if (::lstat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode) && info.st_nlink > 1 &&
+        ::unlink(path.c_str()) != 0 && errno != ENOENT) {
+        return -1;
+    }
+
+    return ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+}
+
+}  // namespace
+
+FileDescriptorSink::FileDescriptorSink(int fd) : fd_(fd) {
+}
+
+void FileDescriptorSink::Write(const PixelView* pieces, size_t count) {
+    std::vector<iovec> vectors;
+    vectors.reserve(std::min(count, kMaxPiecesPerCall));
+
+    size_t next = 0;
+    while (next < count) {
+        vectors.clear();
+
+        for (; next < count && vectors.size() < kMaxPiecesPerCall; ++next) {
+            if (!pieces[next].empty()) {
+                vectors.push_back(
+                    {const_cast<uint8_t*>(pieces[next].data()), pieces[next].size()});
+            }
+        }
+
+        // Retry after short writes, skipping what the kernel already took
+        size_t first = 0;
+        while (first < vectors.size()) {
+            ssize_t written = ::writev(fd_, vectors.data() + first,
+                                       static_cast<int>(vectors.size() - first));
+
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error("Error with output PNG file!");
+            }
+
+            size_t remaining = static_cast<size_t>(written);
+            while (first < vectors.size() && remaining >= vectors[first].iov_len) {
+                remaining -= vectors[first].iov_len;
+                ++first;
+            }
+
+            if (remaining != 0) {
+                vectors[first].iov_base =
+                    static_cast<uint8_t*>(vectors[first].iov_base) + remaining;
+                vectors[first].iov_len -= remaining;
+            }
+        }
+    }
+}
+
+FileSink::FileSink(const std::string& path)
+    : FileDescriptorSink(CreateOutput(path)) {
+    if (fd_ < 0) {
+        throw std::runtime_error("Error with output PNG file!");
+    }
+}
+
+FileSink::~FileSink() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+void FileSink::Close() {
+    if (fd_ < 0) {
+        return;
+    }
+
+    int ret = ::close(fd_);
+    fd_ = -1;
+
+    if (ret != 0) {
+        throw std::runtime_error("Error with output PNG file!");
+    }
+}
+
+BufferSink::BufferSink(uint8_t* buffer, size_t capacity)
+    : buffer_(buffer), capacity_(capacity), size_(0) {
+}
+
+void BufferSink::Write(const PixelView* pieces, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        if (pieces[i].size() > capacity_ - size_) {
+            throw std::runtime_error("Output buffer is too small for the PNG");
+        }
+
+        std::copy(pieces[i].begin(), pieces[i].end(), buffer_ + size_);
+        size_ += pieces[i].size();
+    }
+}
+
+size_t BufferSink::Size() const {
+    return size_;
+}
+
+void MemorySink::Write(const PixelView* pieces, size_t count) {
+    size_t total = data_.size();
+    for (size_t i = 0; i < count; ++i) {
+        total += pieces[i].size();
+    }
+
+    if (total > data_.capacity()) {
+        data_.reserve(std::max(total, data_.capacity() * 2));
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        data_.insert(data_.end(), pieces[i].begin(), pieces[i].end());
+    }
+}
+
+const std::vector<uint8_t>& MemorySink::Data() const {
+    return data_;
+}
+
+std::vector<uint8_t> MemorySink::TakeData() {
+    return std::move(data_);
+}
@@ -0,0 +1,126 @@
+// parallel_deflate.cpp
+#include "../include/parallel_deflate.h"
+#include "../include/encode_stats.h"
+
+#include <zlib.h>
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+// RFC 1950 header: CM = 8, CINFO = log2(window) - 8, FLEVEL as zlib would report it
+void AppendZlibHeader(std::vector<uint8_t>& out, const CompressionProfile& profile) {
+    const unsigned cmf = (static_cast<unsigned>(profile.window_bits - 8) << 4) | 8;
+    const int level = profile.level;
+    unsigned flevel = 3;
+
+    if (level < 2 || profile.strategy == DeflateStrategy::HuffmanOnly ||
+        profile.strategy == DeflateStrategy::RLE || profile.strategy == DeflateStrategy::Fixed) {
+        flevel = 0;
+    } else if (level < 6) {
+        flevel = 1;
+    } else if (level == 6) {
+        flevel = 2;
+    }
+
+    unsigned flg = flevel << 6;
+    flg += 31 - (cmf * 256 + flg) % 31;
+
+    out.push_back(static_cast<uint8_t>(cmf));
+    out.push_back(static_cast<uint8_t>(flg));
+}
+
+}  // namespace
+
+void ParallelDeflateCompressor::CompressBlock(const uint8_t* data, size_t begin, size_t end,
+                                              bool last, const CompressionProfile& profile,
+                                              Block& block) {
+    StageTimer timer(EncodeStage::Deflate, end - begin);
+    z_stream stream{};
+
+    if (deflateInit2(&stream, profile.level, Z_DEFLATED, -profile.window_bits, profile.mem_level,
+                     profile.ZlibStrategy()) != Z_OK) {
+        throw std::runtime_error("Failed to initialize zlib stream");
+    }
+
+    if (begin > 0) {
+        const size_t dict_size = std::min(begin, size_t{1} << profile.window_bits);
+        if (deflateSetDictionary(&stream, data + begin - dict_size,
+                                 static_cast<uInt>(dict_size)) != Z_OK) {
+            deflateEnd(&stream);
+            throw std::runtime_error("Failed to set zlib dictionary");
+        }
+    }
+
+    block.adler = static_cast<uint32_t>(adler32(1L, data + begin, static_cast<uInt>(end - begin)));
+    block.input_size = end - begin;
+    // The sync flush marker adds at most a few bytes to deflateBound
+    block.deflated.resize(deflateBound(&stream, end - begin) + 16);
+
+    stream.next_in = const_cast<Bytef*>(data + begin);
+    stream.avail_in = static_cast<uInt>(end - begin);
+    stream.next_out = block.deflated.data();
+    stream.avail_out = static_cast<uInt>(block.deflated.size());
+
+    int ret = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+    const bool complete = last ? ret == Z_STREAM_END : (ret == Z_OK && stream.avail_out != 0);
+
+    block.deflated.resize(stream.total_out);
+    deflateEnd(&stream);
+
+    if (!complete) {
+        throw std::runtime_error("Failed to compress data with zlib");
+    }
+
+    timer.AddBytesOut(block.deflated.size());
+}
+
+void ParallelDeflateCompressor::Join(const std::vector<Block>& blocks,
+                                     const CompressionProfile& profile,
+                                     std::vector<uint8_t>& out) {
+    size_t total_size = 2 + 4;
+    for (const auto& block : blocks) {
+        total_size += block.deflated.size();
+    }
+
+    out.clear();
+    out.reserve(total_size);
+    AppendZlibHeader(out, profile);
+
+    uLong adler = 1L;
+    for (const Block& block : blocks) {
+        out.insert(out.end(), block.deflated.begin(), block.deflated.end());
+        adler = adler32_combine(adler, block.adler, static_cast<z_off_t>(block.input_size));
+    }
+
+    out.push_back(static_cast<uint8_t>((adler >> 24) & 0xFF));
+    out.push_back(static_cast<uint8_t>((adler >> 16) & 0xFF));
+    out.push_back(static_cast<uint8_t>((adler >> 8) & 0xFF));
+    out.push_back(static_cast<uint8_t>(adler & 0xFF));
+}
+
+std::vector<uint8_t> ParallelDeflateCompressor::Compress(PixelView data, size_t row_size,
+                                                         ThreadPool& pool,
+                                                         const CompressionProfile& profile,
+                                                         size_t block_size) {
+    profile.Validate();
+    if (profile.backend != DeflateBackendType::Zlib) {
+        throw std::runtime_error("Parallel deflate only supports the zlib backend");
+    }
+
+    row_size = std::max<size_t>(row_size, 1);
+    block_size = std::max(block_size / row_size, size_t{1}) * row_size;
+
+    const size_t block_count = std::max<size_t>((data.size() + block_size - 1) / block_size, 1);
+    std::vector<Block> blocks(block_count);
+
+    pool.ParallelFor(block_count, [&](size_t i) {
+        const size_t begin = std::min(i * block_size, data.size());
+        const size_t end = std::min(begin + block_size, data.size());
+        CompressBlock(data.data(), begin, end, i + 1 == block_count, profile, blocks[i]);
+    });
+
+    std::vector<uint8_t> compressed_data;
+    Join(blocks, profile, compressed_data);
+    return compressed_data;
+}
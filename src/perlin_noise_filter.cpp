@@ -5,8 +5,14 @@
 #include <cstdint>
 #include <random>
 #include <numeric>
+#include <stdexcept>
 #include <vector>
 
+#if defined(__x86_64__) || defined(__i386__)
+#define PNG_ENCODER_X86 1
+#include <immintrin.h>
+#endif
+
 namespace {
 
 class Perlin2D {
@@ -39,7 +45,11 @@ public:
         return lerp(x1, x2, v);
     }
 
-private:
+    // Permutation table of 512 entries
+    const int* Table() const {
+        return p_.data();
+    }
+
     static float fade(float t) {
         return t * t * t * (t * (t * 6 - 15) + 10);
     }
@@ -48,6 +58,7 @@ private:
         return a + t * (b - a);
     }
 
+private:
     static float grad(int h, float x, float y) {
         switch (h & 3) {
             case 0:
@@ -64,11 +75,122 @@ private:
     std::vector<int> p_;
 };
 
+void AddDelta(uint8_t* pixel, int delta) {
+    for (int c = 0; c < 3; ++c) {
+        int new_val = static_cast<int>(pixel[c]) + delta;
+        pixel[c] = static_cast<uint8_t>(std::clamp(new_val, 0, 255));
+    }
+}
+
+#ifdef PNG_ENCODER_X86
+
+__attribute__((target("avx2"))) __m256 Fade8(__m256 t) {
+    const __m256 cube = _mm256_mul_ps(_mm256_mul_ps(t, t), t);
+    const __m256 inner = _mm256_sub_ps(_mm256_mul_ps(t, _mm256_set1_ps(6.0f)),
+                                       _mm256_set1_ps(15.0f));
+    return _mm256_mul_ps(cube,
+                         _mm256_add_ps(_mm256_mul_ps(t, inner), _mm256_set1_ps(10.0f)));
+}
+
+__attribute__((target("avx2"))) __m256 Lerp8(__m256 a, __m256 b, __m256 t) {
+    return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a)));
+}
+
+// Bit 0 of the hash negates x, bit 1 negates y; negation is exact, so -x + y rounds the
+// same as the scalar y - x
+__attribute__((target("avx2"))) __m256 Grad8(__m256i hash, __m256 x, __m256 y) {
+    const __m256i x_sign = _mm256_slli_epi32(_mm256_and_si256(hash, _mm256_set1_epi32(1)), 31);
+    const __m256i y_sign = _mm256_slli_epi32(_mm256_and_si256(hash, _mm256_set1_epi32(2)), 30);
+    return _mm256_add_ps(_mm256_xor_ps(x, _mm256_castsi256_ps(x_sign)),
+                         _mm256_xor_ps(y, _mm256_castsi256_ps(y_sign)));
+}
+
+// Noise of row y for pixels [0, width rounded down to 8); returns the first pixel left
+__attribute__((target("avx2"))) uint64_t NoiseRowAVX2(const Perlin2D& perlin, uint8_t* pixels,
+                                                      uint64_t width, uint64_t y,
+                                                      float frequency, float amplitude) {
+    const int* table = perlin.Table();
+
+    // The row coordinate is the same for all pixels
+    const float fy = y * frequency;
+    const float y_floor = std::floor(fy);
+    const __m256i yi = _mm256_set1_epi32(static_cast<int>(y_floor) & 255);
+    const __m256 yf = _mm256_set1_ps(fy - y_floor);
+    const __m256 yf1 = _mm256_set1_ps(fy - y_floor - 1);
+    const __m256 v = _mm256_set1_ps(Perlin2D::fade(fy - y_floor));
+
+    const __m256 freq = _mm256_set1_ps(frequency);
+    const __m256 amp = _mm256_set1_ps(amplitude);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256i mask = _mm256_set1_epi32(255);
+    const __m256i step = _mm256_set1_epi32(1);
+    __m256i xs = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    // Float coordinates are exact only below 2^24
+    const uint64_t vector_end = std::min<uint64_t>(width, uint64_t{1} << 24) / 8 * 8;
+    alignas(32) int32_t deltas[8];
+
+    uint64_t x = 0;
+    for (; x < vector_end; x += 8) {
+        const __m256 fx = _mm256_mul_ps(_mm256_cvtepi32_ps(xs), freq);
+        const __m256 x_floor = _mm256_floor_ps(fx);
+        const __m256i xi = _mm256_and_si256(_mm256_cvttps_epi32(x_floor), mask);
+        const __m256 xf = _mm256_sub_ps(fx, x_floor);
+        const __m256 xf1 = _mm256_sub_ps(xf, one);
+
+        const __m256i px = _mm256_i32gather_epi32(table, xi, 4);
+        const __m256i px1 = _mm256_i32gather_epi32(table, _mm256_add_epi32(xi, step), 4);
+        const __m256i a = _mm256_add_epi32(px, yi);
+        const __m256i b = _mm256_add_epi32(px1, yi);
+
+        const __m256i aa = _mm256_i32gather_epi32(table, a, 4);
+        const __m256i ab = _mm256_i32gather_epi32(table, _mm256_add_epi32(a, step), 4);
+        const __m256i ba = _mm256_i32gather_epi32(table, b, 4);
+        const __m256i bb = _mm256_i32gather_epi32(table, _mm256_add_epi32(b, step), 4);
+
+        const __m256 u = Fade8(xf);
+        const __m256 x1 = Lerp8(Grad8(aa, xf, yf), Grad8(ba, xf1, yf), u);
+        const __m256 x2 = Lerp8(Grad8(ab, xf, yf1), Grad8(bb, xf1, yf1), u);
+        const __m256 n = Lerp8(x1, x2, v);
+
+        _mm256_store_si256(reinterpret_cast<__m256i*>(deltas),
+                           _mm256_cvttps_epi32(_mm256_mul_ps(n, amp)));
+        for (int i = 0; i < 8; ++i) {
+            AddDelta(pixels + (x + i) * 3, deltas[i]);
+        }
+
+        xs = _mm256_add_epi32(xs, _mm256_set1_epi32(8));
+    }
+
+    return x;
+}
+
+#endif
+
 }  // namespace
 
 void PerlinNoiseFilter::Apply(std::vector<uint8_t>& rgb_data, uint64_t width, uint64_t height,
                               float percent) {
-    if (percent <= 0.0f || rgb_data.empty()) {
+    if (rgb_data.empty()) {
+        return;
+    }
+
+    ApplyRows(rgb_data.data(), width, 0, height, percent);
+}
+
+void PerlinNoiseFilter::ApplyRows(uint8_t* rgb_rows, uint64_t width, uint64_t first_row,
+                                  uint64_t row_count, float percent) {
+    static const SIMDLevel level = PNGFilterKernels::DetectLevel();
+    ApplyRows(rgb_rows, width, first_row, row_count, percent, level);
+}
+
+void PerlinNoiseFilter::ApplyRows(uint8_t* rgb_rows, uint64_t width, uint64_t first_row,
+                                  uint64_t row_count, float percent, SIMDLevel level) {
+    if (!PNGFilterKernels::IsSupported(level)) {
+        throw std::runtime_error("SIMD level is not supported by this CPU");
+    }
+
+    if (percent <= 0.0f) {
         return;
     }
 
@@ -81,18 +203,22 @@ void PerlinNoiseFilter::Apply(std::vector<uint8_t>& rgb_data, uint64_t width, ui
     const float max_amplitude = 128.0f;
     const float amplitude = max_amplitude * (percent / 100.0f);
 
-    Perlin2D perlin(0xC0FFEE);
+    static const Perlin2D perlin(0xC0FFEE);
 
-    for (uint64_t y = 0; y < height; ++y) {
-        for (uint64_t x = 0; x < width; ++x) {
-            float n = perlin.noise(x * frequency, y * frequency);
-            int delta = static_cast<int>(n * amplitude);
+    for (uint64_t row = 0; row < row_count; ++row) {
+        const uint64_t y = first_row + row;
+        uint8_t* pixels = rgb_rows + row * width * 3;
+        uint64_t x = 0;
 
-            size_t idx = (y * width + x) * 3;
-            for (int c = 0; c < 3; ++c) {
-                int new_val = static_cast<int>(rgb_data[idx + c]) + delta;
-                rgb_data[idx + c] = static_cast<uint8_t>(std::clamp(new_val, 0, 255));
-            }
+#ifdef PNG_ENCODER_X86
+        if (level == SIMDLevel::AVX2) {
+            x = NoiseRowAVX2(perlin, pixels, width, y, frequency, amplitude);
+        }
+#endif
+
+        for (; x < width; ++x) {
+            float n = perlin.noise(x * frequency, y * frequency);
+            AddDelta(pixels + x * 3, static_cast<int>(n * amplitude));
         }
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,190 @@
+// png_stream_encoder.cpp
+#include "../include/png_stream_encoder.h"
+#include "../include/encode_stats.h"
+#include "../include/image_loader.h"
+
+#include <cstring>
+#include <utility>
+#include <stdexcept>
+
+PNGStreamEncoder::PNGStreamEncoder(PNGFilterStrategy png_filter,
+                                   const CompressionProfile& compression, size_t idat_size)
+    : png_filter_(png_filter),
+      compression_(compression),
+      idat_size_(idat_size == 0 ? kDefaultIDATSize : idat_size),
+      writer_(idat_size_),
+      sink_(nullptr),
+      stream_{},
+      stream_initialized_(false),
+      width_(0),
+      height_(0),
+      rows_written_(0),
+      color_filter_(ColorFilterType::None),
+      perlin_noise_scale_(-1.0f) {
+}
+
+PNGStreamEncoder::~PNGStreamEncoder() {
+    Reset();
+}
+
+void PNGStreamEncoder::Reset() {
+    if (stream_initialized_) {
+        deflateEnd(&stream_);
+        stream_initialized_ = false;
+    }
+
+    sink_ = nullptr;
+    file_.reset();
+}
+
+void PNGStreamEncoder::BeginImage(const std::string& filename, uint64_t width, uint64_t height,
+                                  ColorFilterType color_filter, float perlin_noise_scale) {
+    Reset();
+
+    auto file = std::make_unique<FileSink>(filename);
+    BeginImage(*file, width, height, color_filter, perlin_noise_scale);
+    file_ = std::move(file);
+}
+
+void PNGStreamEncoder::BeginImage(OutputSink& sink, uint64_t width, uint64_t height,
+                                  ColorFilterType color_filter, float perlin_noise_scale) {
+    Reset();
+    compression_.Validate();
+    if (compression_.backend != DeflateBackendType::Zlib) {
+        throw std::runtime_error("The streaming encoder only supports the zlib backend");
+    }
+
+    stream_ = z_stream{};
+    if (deflateInit2(&stream_, compression_.level, Z_DEFLATED, compression_.window_bits,
+                     compression_.mem_level, compression_.ZlibStrategy()) != Z_OK) {
+        throw std::runtime_error("Failed to initialize zlib stream");
+    }
+    stream_initialized_ = true;
+
+    width_ = width;
+    height_ = height;
+    rows_written_ = 0;
+    color_filter_ = color_filter;
+    perlin_noise_scale_ = perlin_noise_scale;
+
+    current_row_.assign(width * 3, 0);
+    previous_row_.assign(width * 3, 0);
+    filtered_line_.resize(width * 3 + 1);
+    idat_buffer_.resize(idat_size_);
+
+    stream_.next_out = idat_buffer_.data();
+    stream_.avail_out = static_cast<uInt>(idat_buffer_.size());
+
+    writer_.WriteHeader(sink, width, height);
+    sink_ = &sink;
+}
+
+void PNGStreamEncoder::WriteRows(const uint8_t* rgb_rows, uint64_t row_count) {
+    if (!stream_initialized_) {
+        throw std::runtime_error("BeginImage must be called before WriteRows");
+    }
+
+    if (rows_written_ + row_count > height_) {
+        throw std::runtime_error("Too many rows written to PNG stream");
+    }
+
+    const size_t row_bytes = width_ * 3;
+
+    for (uint64_t i = 0; i < row_count; ++i) {
+        {
+            StageTimer timer(EncodeStage::ColorFilter, row_bytes);
+            std::memcpy(current_row_.data(), rgb_rows + i * row_bytes, row_bytes);
+            ColorFilter::ApplyRows(current_row_.data(), width_, rows_written_, 1, color_filter_,
+                                   perlin_noise_scale_);
+            timer.AddBytesOut(row_bytes);
+        }
+
+        {
+            StageTimer timer(EncodeStage::PNGFilter, row_bytes);
+            PNGFilter::FilterRow(current_row_.data(),
+                                 rows_written_ > 0 ? previous_row_.data() : nullptr, row_bytes, 3,
+                                 png_filter_, filtered_line_.data(), filter_scratch_);
+            timer.AddBytesOut(filtered_line_.size());
+        }
+
+        Deflate(filtered_line_.data(), filtered_line_.size(), Z_NO_FLUSH);
+
+        current_row_.swap(previous_row_);
+        ++rows_written_;
+    }
+}
+
+void PNGStreamEncoder::Finish() {
+    if (!stream_initialized_) {
+        throw std::runtime_error("BeginImage must be called before Finish");
+    }
+
+    if (rows_written_ != height_) {
+        throw std::runtime_error("PNG stream finished before all rows were written");
+    }
+
+    Deflate(nullptr, 0, Z_FINISH);
+
+    const size_t pending = idat_buffer_.size() - stream_.avail_out;
+    if (pending != 0) {
+        WriteIDAT(pending);
+    }
+
+    writer_.WriteEnd(*sink_);
+
+    if (file_) {
+        file_->Close();
+    }
+
+    Reset();
+}
+
+void PNGStreamEncoder::Deflate(const uint8_t* data, size_t size, int flush) {
+    StageTimer timer(EncodeStage::Deflate, size);
+    const uLong total_out = stream_.total_out;
+
+    stream_.next_in = const_cast<Bytef*>(data);
+    stream_.avail_in = static_cast<uInt>(size);
+
+    for (;;) {
+        int ret = deflate(&stream_, flush);
+
+        if (ret == Z_STREAM_ERROR) {
+            throw std::runtime_error("Failed to compress data with zlib");
+        }
+
+        if (stream_.avail_out == 0) {
+            WriteIDAT(idat_buffer_.size());
+            continue;
+        }
+
+        if (flush == Z_FINISH ? ret == Z_STREAM_END : stream_.avail_in == 0) {
+            timer.AddBytesOut(stream_.total_out - total_out);
+            return;
+        }
+    }
+}
+
+void PNGStreamEncoder::WriteIDAT(size_t size) {
+    writer_.WriteIDAT(*sink_, PixelView(idat_buffer_.data(), size));
+
+    stream_.next_out = idat_buffer_.data();
+    stream_.avail_out = static_cast<uInt>(idat_buffer_.size());
+}
+
+void PNGStreamEncoder::EncodeFile(const std::string& input_path, OutputSink& sink,
+                                  uint64_t width, uint64_t height, ColorFilterType color_filter,
+                                  float perlin_noise_scale, PNGFilterStrategy png_filter,
+                                  const CompressionProfile& compression, size_t idat_size) {
+    RawImageReader reader(input_path, width, height);
+
+    PNGStreamEncoder encoder(png_filter, compression, idat_size);
+    encoder.BeginImage(sink, width, height, color_filter, perlin_noise_scale);
+
+    std::vector<uint8_t> row(width * 3);
+    while (reader.ReadRows(row.data(), 1) == 1) {
+        encoder.WriteRows(row.data(), 1);
+    }
+
+    encoder.Finish();
+}
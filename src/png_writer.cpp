@@ -1,111 +1,195 @@
 // png_writer.cpp
 #include "../include/png_writer.h"
-#include <fstream>
+#include "../include/crc32.h"
+#include "../include/encode_stats.h"
 #include <stdexcept>
 #include <cstring>
 
-PNGWriter::PNGWriter() : crc_table_computed_(false) {
-    InitializeCRCTable();
+namespace {
+
+// Hands the pieces to the sink in one call, timed as the write stage
+void WritePieces(OutputSink& sink, const std::vector<PixelView>& pieces) {
+    StageTimer timer(EncodeStage::Write);
+    for (const PixelView& piece : pieces) {
+        timer.AddBytesIn(piece.size());
+        timer.AddBytesOut(piece.size());
+    }
+
+    sink.Write(pieces.data(), pieces.size());
 }
 
-void PNGWriter::InitializeCRCTable() {
-    for (int n = 0; n < 256; ++n) {
-        uint32_t c = static_cast<uint32_t>(n);
+}  // namespace
+
+PNGWriter::PNGWriter(size_t max_idat_size) {
+    SetMaxIDATSize(max_idat_size);
+}
 
-        for (int k = 0; k < 8; ++k) {
-            if (c & 1) {
-                c = 0xEDB88320L ^ (c >> 1);
-            } else {
-                c = c >> 1;
-            }
-        }
+size_t PNGWriter::MaxIDATSize() const {
+    return max_idat_size_;
+}
 
-        crc_table_[n] = c;
+void PNGWriter::SetMaxIDATSize(size_t max_idat_size) {
+    if (max_idat_size == 0 || max_idat_size > kMaxChunkSize) {
+        throw std::runtime_error("IDAT chunk size must be in [1, 2^31 - 1] bytes");
     }
 
-    crc_table_computed_ = true;
+    max_idat_size_ = max_idat_size;
 }
 
-uint32_t PNGWriter::CalculateCRC(const uint8_t* buffer, size_t length) const {
-    uint32_t crc = 0xFFFFFFFF;
+void PNGWriter::PutUInt32(uint8_t* out, uint32_t value) {
+    out[0] = (value >> 24) & 0xFF;
+    out[1] = (value >> 16) & 0xFF;
+    out[2] = (value >> 8) & 0xFF;
+    out[3] = value & 0xFF;
+}
 
-    for (size_t i = 0; i < length; ++i) {
-        uint8_t index = (crc ^ buffer[i]) & 0xFF;
-        crc = crc_table_[index] ^ (crc >> 8);
+void PNGWriter::FrameChunk(const char* type, PixelView data, ChunkFrame& frame) {
+    if (data.size() > kMaxChunkSize) {
+        throw std::runtime_error("PNG chunk is larger than 2^31 - 1 bytes");
     }
 
-    return crc ^ 0xFFFFFFFF;
+    PutUInt32(frame.header, static_cast<uint32_t>(data.size()));
+    std::memcpy(frame.header + 4, type, 4);
+
+    // CRC covers the chunk type and data, hashed in place without joining them
+    StageTimer timer(EncodeStage::CRC, 4 + data.size());
+    CRC32 crc;
+    crc.Update(frame.header + 4, 4);
+    crc.Update(data.data(), data.size());
+
+    PutUInt32(frame.crc, crc.Value());
+    timer.AddBytesOut(sizeof(frame.crc));
+}
+
+void PNGWriter::AppendChunk(const ChunkFrame& frame, PixelView data,
+                            std::vector<PixelView>& pieces) {
+    pieces.emplace_back(frame.header, sizeof(frame.header));
+    pieces.push_back(data);
+    pieces.emplace_back(frame.crc, sizeof(frame.crc));
 }
 
-void PNGWriter::WriteUInt32(std::ofstream& out, uint32_t value) const {
-    uint8_t bytes[4];
+std::array<uint8_t, 13> PNGWriter::MakeIHDR(uint64_t width, uint64_t height,
+                                            const PixelFormat& format) {
+    if (width > kMaxChunkSize || height > kMaxChunkSize) {
+        throw std::runtime_error("PNG dimensions must not exceed 2^31 - 1");
+    }
+
+    const size_t palette_size = format.palette.size() / 3;
+    if (format.color_type == PNGColorType::Indexed &&
+        (palette_size == 0 || palette_size > (size_t{1} << format.bit_depth))) {
+        throw std::runtime_error("Palette size does not match the bit depth");
+    }
+
+    std::array<uint8_t, 13> ihdr{};
 
-    bytes[0] = (value >> 24) & 0xFF;
-    bytes[1] = (value >> 16) & 0xFF;
-    bytes[2] = (value >> 8) & 0xFF;
-    bytes[3] = value & 0xFF;
+    // Ширина и высота (по 4 байта, big-endian)
+    PutUInt32(ihdr.data(), static_cast<uint32_t>(width));
+    PutUInt32(ihdr.data() + 4, static_cast<uint32_t>(height));
+
+    ihdr[8] = format.bit_depth;                        // Bit depth
+    ihdr[9] = static_cast<uint8_t>(format.color_type);  // Color type
+    ihdr[10] = 0;  // Compression method
+    ihdr[11] = 0;  // Filter method
+    ihdr[12] = static_cast<uint8_t>(format.interlace);  // Interlace method
+
+    return ihdr;
+}
 
-    out.write(reinterpret_cast<char*>(bytes), 4);
+size_t PNGWriter::CountIDATChunks(size_t size) const {
+    return size == 0 ? 1 : (size + max_idat_size_ - 1) / max_idat_size_;
 }
 
-void PNGWriter::WriteChunk(std::ofstream& out, const std::string& type,
-                           const std::vector<uint8_t>& data) const {
-    WriteUInt32(out, static_cast<uint32_t>(data.size()));
+void PNGWriter::WriteHeader(OutputSink& sink, uint64_t width, uint64_t height,
+                            const PixelFormat& format) const {
+    const std::array<uint8_t, 13> ihdr = MakeIHDR(width, height, format);
+    ChunkFrame frames[2];
+    FrameChunk(kIHDRChunkType, ihdr, frames[0]);
 
-    out.write(type.c_str(), 4);
+    std::vector<PixelView> pieces;
+    pieces.emplace_back(kPNGSignature, sizeof(kPNGSignature));
+    AppendChunk(frames[0], ihdr, pieces);
 
-    if (!data.empty()) {
-        out.write(reinterpret_cast<const char*>(data.data()), data.size());
+    if (format.color_type == PNGColorType::Indexed) {
+        FrameChunk(kPLTEChunkType, format.palette, frames[1]);
+        AppendChunk(frames[1], format.palette, pieces);
     }
 
-    std::vector<uint8_t> type_and_data;
-    type_and_data.reserve(4 + data.size());
-    type_and_data.insert(type_and_data.end(), type.begin(), type.end());
-    type_and_data.insert(type_and_data.end(), data.begin(), data.end());
+    WritePieces(sink, pieces);
+}
+
+void PNGWriter::WriteIDAT(OutputSink& sink, PixelView data) const {
+    const size_t chunk_count = CountIDATChunks(data.size());
+    std::vector<ChunkFrame> frames(chunk_count);
+    std::vector<PixelView> pieces;
+    pieces.reserve(chunk_count * 3);
 
-    uint32_t crc_val = CalculateCRC(type_and_data.data(), type_and_data.size());
+    for (size_t i = 0; i < chunk_count; ++i) {
+        PixelView chunk = data.subspan(std::min(i * max_idat_size_, data.size()));
+        chunk = chunk.first(std::min(chunk.size(), max_idat_size_));
 
-    WriteUInt32(out, crc_val);
+        FrameChunk(kIDATChunkType, chunk, frames[i]);
+        AppendChunk(frames[i], chunk, pieces);
+    }
+
+    WritePieces(sink, pieces);
 }
 
-void PNGWriter::WritePNG(const std::string& filename, uint64_t width, uint64_t height,
-                         const std::vector<uint8_t>& compressed_data) {
-    std::ofstream out(filename, std::ios::binary);
+void PNGWriter::WriteEnd(OutputSink& sink) const {
+    ChunkFrame frame;
+    FrameChunk(kIENDChunkType, {}, frame);
 
-    if (!out) {
-        throw std::runtime_error("Error with output PNG file!");
-    }
+    std::vector<PixelView> pieces;
+    AppendChunk(frame, {}, pieces);
+
+    WritePieces(sink, pieces);
+}
+
+void PNGWriter::WritePNG(OutputSink& sink, uint64_t width, uint64_t height,
+                         PixelView compressed_data, const PixelFormat& format) {
+    const size_t idat_count = CountIDATChunks(compressed_data.size());
+    const bool indexed = format.color_type == PNGColorType::Indexed;
+
+    // Frames must not move once the pieces point into them
+    std::vector<ChunkFrame>& frames = frames_;
+    std::vector<PixelView>& pieces = pieces_;
+    frames.resize(idat_count + 3);
+    pieces.clear();
+    pieces.reserve(1 + frames.size() * 3);
 
     // Записываем сигнатуру PNG
-    out.write(reinterpret_cast<const char*>(kPNGSignature), sizeof(kPNGSignature));
+    pieces.emplace_back(kPNGSignature, sizeof(kPNGSignature));
 
     // Создаем и записываем чанк IHDR
-    std::vector<uint8_t> ihdr(13, 0);
-
-    // Ширина (4 байта, big-endian)
-    ihdr[0] = (width >> 24) & 0xFF;
-    ihdr[1] = (width >> 16) & 0xFF;
-    ihdr[2] = (width >> 8) & 0xFF;
-    ihdr[3] = width & 0xFF;
-
-    // Высота (4 байта, big-endian)
-    ihdr[4] = (height >> 24) & 0xFF;
-    ihdr[5] = (height >> 16) & 0xFF;
-    ihdr[6] = (height >> 8) & 0xFF;
-    ihdr[7] = height & 0xFF;
-
-    ihdr[8] = 8;   // Bit depth
-    ihdr[9] = 2;   // Color type: Truecolor
-    ihdr[10] = 0;  // Compression method
-    ihdr[11] = 0;  // Filter method
-    ihdr[12] = 0;  // Interlace method
+    const std::array<uint8_t, 13> ihdr = MakeIHDR(width, height, format);
+    FrameChunk(kIHDRChunkType, ihdr, frames[0]);
+    AppendChunk(frames[0], ihdr, pieces);
+
+    // Палитра для индексированных изображений
+    if (indexed) {
+        FrameChunk(kPLTEChunkType, format.palette, frames[1]);
+        AppendChunk(frames[1], format.palette, pieces);
+    }
 
-    WriteChunk(out, std::string(kIHDRChunkType, 4), ihdr);
+    // Создаем и записываем чанки IDAT
+    for (size_t i = 0; i < idat_count; ++i) {
+        PixelView chunk = compressed_data.subspan(
+            std::min(i * max_idat_size_, compressed_data.size()));
+        chunk = chunk.first(std::min(chunk.size(), max_idat_size_));
 
-    // Создаем и записываем чанк IDAT
-    WriteChunk(out, std::string(kIDATChunkType, 4), compressed_data);
+        FrameChunk(kIDATChunkType, chunk, frames[2 + i]);
+        AppendChunk(frames[2 + i], chunk, pieces);
+    }
 
     // Создаем и записываем чанк IEND
-    std::vector<uint8_t> iend_data;
-    WriteChunk(out, std::string(kIENDChunkType, 4), iend_data);
-}
\ No newline at end of file
+    FrameChunk(kIENDChunkType, {}, frames.back());
+    AppendChunk(frames.back(), {}, pieces);
+
+    WritePieces(sink, pieces);
+}
+
+void PNGWriter::WritePNG(const std::string& filename, uint64_t width, uint64_t height,
+                         PixelView compressed_data, const PixelFormat& format) {
+    FileSink sink(filename);
+    WritePNG(sink, width, height, compressed_data, format);
+    sink.Close();
+}
@@ -0,0 +1,420 @@
+// sequence_encoder.cpp
+#include "../include/sequence_encoder.h"
+#include "../include/color_reduction.h"
+#include "../include/encode_stats.h"
+#include "../include/filter.h"
+#include "../include/image_loader.h"
+#include "../include/output_sink.h"
+#include "../include/png_writer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Everything one frame needs on its way through the stages. Frames go back to the free
+// list after writing, so their buffers and deflate stream serve the next frames.
+struct Frame {
+    uint64_t index = 0;
+    std::vector<uint8_t> pixels;
+    PixelFormat format;
+    PNGFilterBuffers filter_buffers;
+    ReusableDeflater deflater;
+    PixelView compressed;
+};
+
+class Stage {
+public:
+    Stage(const char* name, size_t threads) : name_(name), threads_(threads), running_(threads) {
+    }
+
+    // Adds the time since start to the busy time of the stage
+    void Done(Clock::time_point start) {
+        busy_ns_.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               Clock::now() - start)
+                               .count(),
+                           std::memory_order_relaxed);
+        frames_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // True for the last thread of the stage to finish
+    bool Leave() {
+        return running_.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+
+    size_t Threads() const {
+        return threads_;
+    }
+
+    StageStats Stats() const {
+        StageStats stats;
+        stats.name = name_;
+        stats.threads = threads_;
+        stats.frames = frames_.load();
+        stats.busy_seconds = static_cast<double>(busy_ns_.load()) / 1e9;
+        return stats;
+    }
+
+private:
+    const char* name_;
+    size_t threads_;
+    std::atomic<size_t> running_;
+    std::atomic<uint64_t> frames_{0};
+    std::atomic<uint64_t> busy_ns_{0};
+};
+
+class Pipeline {
+public:
+    Pipeline(const EncodeJob& job, const SequenceOptions& options)
+        : job_(job),
+          options_(options),
+          frame_bytes_(job.width * job.height * 3),
+          load_("load", 1),
+          filter_("filter", FilterThreads(job, options)),
+          compress_("compress", CompressThreads(job, options)),
+          write_("write", 1),
+          free_(FrameCount(options)),
+          loaded_(options.queue_depth),
+          filtered_(options.queue_depth),
+          compressed_(options.queue_depth) {
+        if (options.queue_depth == 0) {
+            throw std::runtime_error("Sequence queue depth must be positive");
+        }
+
+        for (size_t i = 0; i < FrameCount(options); ++i) {
+            frames_.push_back(std::make_unique<Frame>());
+            Frame* frame = frames_.back().get();
+            free_.Push(frame);
+        }
+    }
+
+    SequenceReport Run() {
+        const uint64_t file_size = std::filesystem::file_size(job_.input_path);
+        if (frame_bytes_ == 0 || file_size == 0 || file_size % frame_bytes_ != 0) {
+            throw std::runtime_error("Invalid file data! It must consist of N frames of HxWx3 bytes!");
+        }
+        frames_per_pass_ = file_size / frame_bytes_;
+
+        const auto start = Clock::now();
+        collector_ = StatsCollector::Current();
+
+        std::vector<std::thread> threads;
+        threads.emplace_back([this]() { Guard(load_, loaded_, [this]() { LoadLoop(); }); });
+        for (size_t i = 0; i < filter_.Threads(); ++i) {
+            threads.emplace_back(
+                [this]() { Guard(filter_, filtered_, [this]() { FilterLoop(); }); });
+        }
+        for (size_t i = 0; i < compress_.Threads(); ++i) {
+            threads.emplace_back(
+                [this]() { Guard(compress_, compressed_, [this]() { CompressLoop(); }); });
+        }
+        threads.emplace_back([this]() { Guard(write_, free_, [this]() { WriteLoop(); }); });
+
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+
+        SequenceReport report;
+        report.frames = write_.Stats().frames;
+        report.wall_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        report.input_bytes = report.frames * frame_bytes_;
+        report.output_bytes = output_bytes_;
+        report.stages = {load_.Stats(), filter_.Stats(), compress_.Stats(), write_.Stats()};
+        report.queues = {{"filter", loaded_.Capacity(), loaded_.Stats()},
+                         {"compress", filtered_.Capacity(), filtered_.Stats()},
+                         {"write", compressed_.Capacity(), compressed_.Stats()},
+                         {"load", free_.Capacity(), free_.Stats()}};
+        return report;
+    }
+
+private:
+    static size_t FilterThreads(const EncodeJob& job, const SequenceOptions& options) {
+        if (options.filter_threads != 0) {
+            return options.filter_threads;
+        }
+
+        // Load and write are mostly I/O; compression costs about twice the filtering
+        const size_t workers = job.options.threads > 2 ? job.options.threads - 2 : 1;
+        return std::max<size_t>(workers / 3, 1);
+    }
+
+    static size_t CompressThreads(const EncodeJob& job, const SequenceOptions& options) {
+        if (options.compress_threads != 0) {
+            return options.compress_threads;
+        }
+
+        const size_t workers = job.options.threads > 2 ? job.options.threads - 2 : 1;
+        const size_t filter_threads = FilterThreads(job, options);
+        return workers > filter_threads ? workers - filter_threads : 1;
+    }
+
+    // Enough frames for every queue to fill up and every worker to hold one
+    size_t FrameCount(const SequenceOptions& options) const {
+        return 3 * options.queue_depth + filter_.Threads() + compress_.Threads() + 2;
+    }
+
+    // Runs a stage thread; the last thread of a stage closes the queue it feeds, so the
+    // next stage drains it and stops. An error closes every queue.
+    template <typename Body>
+    void Guard(Stage& stage, BoundedQueue<Frame*>& output, Body body) {
+        ScopedStatsCollector scope(collector_);
+
+        try {
+            body();
+        } catch (...) {
+            {
+                std::lock_guard<std::mutex> lock(error_mutex_);
+                if (!error_) {
+                    error_ = std::current_exception();
+                }
+            }
+
+            failed_.store(true);
+            free_.Close();
+            loaded_.Close();
+            filtered_.Close();
+            compressed_.Close();
+        }
+
+        if (stage.Leave() && &output != &free_) {
+            output.Close();
+        }
+    }
+
+    void LoadLoop() {
+        uint64_t index = 0;
+
+        for (uint64_t pass = 0; pass < options_.repeat; ++pass) {
+            RawImageReader reader(job_.input_path, job_.width, job_.height * frames_per_pass_);
+
+            for (uint64_t i = 0; i < frames_per_pass_; ++i) {
+                Frame* frame = nullptr;
+                if (!free_.Pop(frame)) {
+                    return;
+                }
+
+                const auto start = Clock::now();
+                frame->index = index++;
+                frame->pixels.resize(frame_bytes_);
+                reader.ReadRows(frame->pixels.data(), job_.height);
+                load_.Done(start);
+
+                if (!loaded_.Push(frame)) {
+                    return;
+                }
+            }
+        }
+    }
+
+    void FilterLoop() {
+        const EncodeOptions& options = job_.options;
+        Frame* frame = nullptr;
+
+        while (loaded_.Pop(frame) && !failed_.load(std::memory_order_relaxed)) {
+            const auto start = Clock::now();
+            const ImageView image(frame->pixels, job_.width, job_.height);
+
+            frame->format = PixelFormat{};
+            if (options.reduce_colors) {
+                frame->format =
+                    ColorReducer::Analyze(image, options.color_filter, options.perlin_strength);
+            }
+            frame->format.interlace = options.interlace;
+
+            // Same choice as PNGEncoder::Encode: indexed rows stay unfiltered
+            PNGFilterStrategy png_filter = options.png_filter;
+            if (frame->format.color_type == PNGColorType::Indexed &&
+                (png_filter == PNGFilterStrategy::MinSum ||
+                 png_filter == PNGFilterStrategy::Entropy)) {
+                png_filter = PNGFilterStrategy::None;
+            }
+
+            PNGFilter::Apply(image, png_filter, options.color_filter, options.perlin_strength,
+                             frame->format, nullptr, frame->filter_buffers);
+            filter_.Done(start);
+
+            if (!filtered_.Push(frame)) {
+                return;
+            }
+        }
+    }
+
+    void CompressLoop() {
+        Frame* frame = nullptr;
+
+        while (filtered_.Pop(frame) && !failed_.load(std::memory_order_relaxed)) {
+            const auto start = Clock::now();
+            frame->compressed =
+                frame->deflater.Compress(frame->filter_buffers.scanlines, job_.options.compression);
+            compress_.Done(start);
+
+            if (!compressed_.Push(frame)) {
+                return;
+            }
+        }
+    }
+
+    void WriteLoop() {
+        PNGWriter writer(job_.options.idat_size);
+        Frame* frame = nullptr;
+
+        while (compressed_.Pop(frame) && !failed_.load(std::memory_order_relaxed)) {
+            const auto start = Clock::now();
+            const std::string path = SequenceEncoder::FramePath(job_.output_path, frame->index);
+
+            FileSink sink(path);
+            writer.WritePNG(sink, job_.width, job_.height, frame->compressed, frame->format);
+            sink.Close();
+            output_bytes_ += std::filesystem::file_size(path);
+            write_.Done(start);
+
+            if (!free_.Push(frame)) {
+                return;
+            }
+        }
+    }
+
+    const EncodeJob& job_;
+    const SequenceOptions& options_;
+    const uint64_t frame_bytes_;
+    uint64_t frames_per_pass_ = 0;
+
+    Stage load_;
+    Stage filter_;
+    Stage compress_;
+    Stage write_;
+
+    // free_ -> load -> loaded_ -> filter -> filtered_ -> compress -> compressed_ -> write -> free_
+    BoundedQueue<Frame*> free_;
+    BoundedQueue<Frame*> loaded_;
+    BoundedQueue<Frame*> filtered_;
+    BoundedQueue<Frame*> compressed_;
+    std::vector<std::unique_ptr<Frame>> frames_;
+
+    // Only the write thread adds to it
+    uint64_t output_bytes_ = 0;
+
+    // Stage threads report timings to the collector of the thread that runs the pipeline
+    StatsCollector* collector_ = nullptr;
+
+    std::atomic<bool> failed_{false};
+    std::mutex error_mutex_;
+    std::exception_ptr error_;
+};
+
+// Every frame depends on the one before, so frames are encoded in order on this thread;
+// the rows, bands and blocks of one frame spread over the pool
+SequenceReport EncodeIncremental(const EncodeJob& job, const SequenceOptions& options) {
+    const uint64_t frame_bytes = job.width * job.height * 3;
+    const uint64_t file_size = std::filesystem::file_size(job.input_path);
+    if (frame_bytes == 0 || file_size == 0 || file_size % frame_bytes != 0) {
+        throw std::runtime_error("Invalid file data! It must consist of N frames of HxWx3 bytes!");
+    }
+    const uint64_t frames_per_pass = file_size / frame_bytes;
+
+    const auto start = Clock::now();
+    ThreadPool pool(std::max<size_t>(job.options.threads, 1));
+    IncrementalEncoder encoder(job.options);
+    Stage load("load", 1);
+    // Writing happens while the PNG is produced, so it is part of the encode stage
+    Stage encode("encode", pool.Size());
+
+    SequenceReport report;
+    std::vector<uint8_t> pixels(frame_bytes);
+    uint64_t index = 0;
+
+    for (uint64_t pass = 0; pass < options.repeat; ++pass) {
+        RawImageReader reader(job.input_path, job.width, job.height * frames_per_pass);
+
+        for (uint64_t i = 0; i < frames_per_pass; ++i) {
+            auto stage_start = Clock::now();
+            reader.ReadRows(pixels.data(), job.height);
+            load.Done(stage_start);
+
+            stage_start = Clock::now();
+            const std::string path = SequenceEncoder::FramePath(job.output_path, index++);
+            FileSink sink(path);
+            encoder.Encode(ImageView(pixels, job.width, job.height), sink,
+                           pool.Size() > 1 ? &pool : nullptr);
+            sink.Close();
+            report.output_bytes += std::filesystem::file_size(path);
+            report.incremental += encoder.LastStats();
+            encode.Done(stage_start);
+        }
+    }
+
+    report.frames = encode.Stats().frames;
+    report.wall_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    report.input_bytes = report.frames * frame_bytes;
+    report.stages = {load.Stats(), encode.Stats()};
+    return report;
+}
+
+}  // namespace
+
+double SequenceReport::FramesPerSecond() const {
+    return wall_seconds > 0.0 ? frames / wall_seconds : 0.0;
+}
+
+SequenceReport SequenceEncoder::EncodeFile(const EncodeJob& job, const SequenceOptions& options) {
+    job.options.compression.Validate();
+
+    // Frames are encoded one way, once each, into whole-buffer PNGs
+    if (!job.options.sizes.empty()) {
+        throw std::runtime_error("--sizes cannot be combined with --sequence");
+    }
+    if (job.options.search) {
+        throw std::runtime_error("--search cannot be combined with --sequence");
+    }
+    if (job.options.streaming) {
+        throw std::runtime_error("--stream cannot be combined with --sequence");
+    }
+
+    if (options.incremental) {
+        return EncodeIncremental(job, options);
+    }
+
+    Pipeline pipeline(job, options);
+    return pipeline.Run();
+}
+
+std::string SequenceEncoder::FramePath(const std::string& pattern, uint64_t index) {
+    const size_t percent = pattern.find('%');
+    if (percent == std::string::npos) {
+        throw std::runtime_error("Output pattern needs a frame number (%d or %0<N>d): " + pattern);
+    }
+
+    size_t pos = percent + 1;
+    const bool zero_pad = pos < pattern.size() && pattern[pos] == '0';
+    size_t width = 0;
+    while (pos < pattern.size() && std::isdigit(static_cast<unsigned char>(pattern[pos]))) {
+        width = width * 10 + static_cast<size_t>(pattern[pos] - '0');
+        ++pos;
+    }
+
+    if (pos >= pattern.size() || pattern[pos] != 'd' ||
+        pattern.find('%', pos + 1) != std::string::npos) {
+        throw std::runtime_error("Output pattern needs exactly one %d or %0<N>d: " + pattern);
+    }
+
+    std::string number = std::to_string(index);
+    if (number.size() < width) {
+        number.insert(0, width - number.size(), zero_pad ? '0' : ' ');
+    }
+
+    return pattern.substr(0, percent) + number + pattern.substr(pos + 1);
+}
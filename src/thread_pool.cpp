@@ -0,0 +1,187 @@
+// thread_pool.cpp
+#include "../include/thread_pool.h"
+#include "../include/encode_stats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+namespace {
+
+struct ParallelForState {
+    explicit ParallelForState(size_t total, const std::function<void(size_t)>& fn)
+        : count(total), body(fn) {
+    }
+
+    const size_t count;
+    const std::function<void(size_t)> body;
+
+    std::atomic<size_t> next_index{0};
+    std::atomic<size_t> finished{0};
+
+    std::mutex mutex;
+    std::condition_variable done;
+    std::exception_ptr error;
+
+    // Claims indices until none are left; returns once this thread has nothing more to do
+    void Run() {
+        for (size_t i = next_index.fetch_add(1); i < count; i = next_index.fetch_add(1)) {
+            try {
+                body(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+
+            if (finished.fetch_add(1) + 1 == count) {
+                std::lock_guard<std::mutex> lock(mutex);
+                done.notify_all();
+            }
+        }
+    }
+};
+
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local size_t current_worker = 0;
+
+}  // namespace
+
+ThreadPool::ThreadPool(size_t thread_count) : pending_(0), next_queue_(0), stopping_(false) {
+    thread_count = std::max<size_t>(thread_count, 1);
+    queues_.reserve(thread_count);
+    workers_.reserve(thread_count);
+
+    for (size_t i = 0; i < thread_count; ++i) {
+        queues_.push_back(std::make_unique<WorkerQueue>());
+    }
+
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers_.emplace_back([this, i]() { WorkerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        stopping_ = true;
+    }
+
+    task_available_.notify_all();
+
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+size_t ThreadPool::Size() const {
+    return workers_.size();
+}
+
+size_t ThreadPool::DefaultThreadCount() {
+    return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+}
+
+ThreadPool& ThreadPool::Shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::Enqueue(std::function<void()> task) {
+    size_t index = next_queue_.fetch_add(1) % queues_.size();
+    if (current_pool == this) {
+        index = current_worker;
+    }
+
+    {
+        // Counted under the sleep mutex so a worker about to sleep cannot miss the task,
+        // and before the task is visible so a TryPop never decrements below zero
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        ++pending_;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+        queues_[index]->tasks.push_back(std::move(task));
+    }
+
+    task_available_.notify_one();
+}
+
+bool ThreadPool::TryPop(size_t worker_index, std::function<void()>& task) {
+    {
+        WorkerQueue& own = *queues_[worker_index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            --pending_;
+            return true;
+        }
+    }
+
+    for (size_t offset = 1; offset < queues_.size(); ++offset) {
+        WorkerQueue& victim = *queues_[(worker_index + offset) % queues_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            --pending_;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::WorkerLoop(size_t worker_index) {
+    current_pool = this;
+    current_worker = worker_index;
+
+    for (;;) {
+        std::function<void()> task;
+
+        if (TryPop(worker_index, task)) {
+            task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        task_available_.wait(lock, [this]() { return stopping_ || pending_.load() != 0; });
+
+        if (stopping_ && pending_.load() == 0) {
+            return;
+        }
+    }
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& body) {
+    if (count == 0) {
+        return;
+    }
+
+    auto state = std::make_shared<ParallelForState>(count, body);
+
+    // Helpers report their stage timings to the caller's collector
+    StatsCollector* collector = StatsCollector::Current();
+
+    const size_t helpers = std::min(count - 1, workers_.size());
+    for (size_t i = 0; i < helpers; ++i) {
+        Enqueue([state, collector]() {
+            ScopedStatsCollector scope(collector);
+            state->Run();
+        });
+    }
+
+    state->Run();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done.wait(lock, [&state]() { return state->finished.load() == state->count; });
+
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+}
@@ -0,0 +1,151 @@
+// xxhash64.cpp
+#include "../include/xxhash64.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace {
+
+constexpr uint64_t kPrime1 = 11400714785074694791ull;
+constexpr uint64_t kPrime2 = 14029467366897019727ull;
+constexpr uint64_t kPrime3 = 1609587929392839161ull;
+constexpr uint64_t kPrime4 = 9650029242287828579ull;
+constexpr uint64_t kPrime5 = 2870177450012600261ull;
+
+// The format is little endian
+uint64_t Read64(const uint8_t* data) {
+    uint64_t value;
+    std::memcpy(&value, data, 8);
+    if constexpr (std::endian::native == std::endian::big) {
+        value = __builtin_bswap64(value);
+    }
+    return value;
+}
+
+uint32_t Read32(const uint8_t* data) {
+    uint32_t value;
+    std::memcpy(&value, data, 4);
+    if constexpr (std::endian::native == std::endian::big) {
+        value = __builtin_bswap32(value);
+    }
+    return value;
+}
+
+uint64_t Round(uint64_t accumulator, uint64_t input) {
+    accumulator += input * kPrime2;
+    accumulator = std::rotl(accumulator, 31);
+    return accumulator * kPrime1;
+}
+
+uint64_t MergeRound(uint64_t hash, uint64_t accumulator) {
+    hash ^= Round(0, accumulator);
+    return hash * kPrime1 + kPrime4;
+}
+
+// Consumes whole 32-byte stripes of data, returns the bytes consumed
+size_t ConsumeStripes(uint64_t* accumulators, const uint8_t* data, size_t size) {
+    uint64_t v1 = accumulators[0];
+    uint64_t v2 = accumulators[1];
+    uint64_t v3 = accumulators[2];
+    uint64_t v4 = accumulators[3];
+    size_t offset = 0;
+
+    for (; offset + 32 <= size; offset += 32) {
+        v1 = Round(v1, Read64(data + offset));
+        v2 = Round(v2, Read64(data + offset + 8));
+        v3 = Round(v3, Read64(data + offset + 16));
+        v4 = Round(v4, Read64(data + offset + 24));
+    }
+
+    accumulators[0] = v1;
+    accumulators[1] = v2;
+    accumulators[2] = v3;
+    accumulators[3] = v4;
+    return offset;
+}
+
+}  // namespace
+
+XXHash64::XXHash64(uint64_t seed) {
+    Reset(seed);
+}
+
+void XXHash64::Reset(uint64_t seed) {
+    seed_ = seed;
+    accumulators_[0] = seed + kPrime1 + kPrime2;
+    accumulators_[1] = seed + kPrime2;
+    accumulators_[2] = seed;
+    accumulators_[3] = seed - kPrime1;
+    total_size_ = 0;
+    buffered_ = 0;
+}
+
+void XXHash64::Update(const uint8_t* data, size_t size) {
+    total_size_ += size;
+
+    if (buffered_ != 0) {
+        const size_t take = std::min(size, sizeof(buffer_) - buffered_);
+        std::memcpy(buffer_ + buffered_, data, take);
+        buffered_ += take;
+        data += take;
+        size -= take;
+
+        if (buffered_ < sizeof(buffer_)) {
+            return;
+        }
+
+        ConsumeStripes(accumulators_, buffer_, sizeof(buffer_));
+        buffered_ = 0;
+    }
+
+    const size_t consumed = ConsumeStripes(accumulators_, data, size);
+    buffered_ = size - consumed;
+    std::memcpy(buffer_, data + consumed, buffered_);
+}
+
+uint64_t XXHash64::Digest() const {
+    uint64_t hash;
+
+    if (total_size_ >= 32) {
+        hash = std::rotl(accumulators_[0], 1) + std::rotl(accumulators_[1], 7) +
+               std::rotl(accumulators_[2], 12) + std::rotl(accumulators_[3], 18);
+        for (uint64_t accumulator : accumulators_) {
+            hash = MergeRound(hash, accumulator);
+        }
+    } else {
+        hash = seed_ + kPrime5;
+    }
+
+    hash += total_size_;
+
+    size_t offset = 0;
+    for (; offset + 8 <= buffered_; offset += 8) {
+        hash ^= Round(0, Read64(buffer_ + offset));
+        hash = std::rotl(hash, 27) * kPrime1 + kPrime4;
+    }
+
+    if (offset + 4 <= buffered_) {
+        hash ^= static_cast<uint64_t>(Read32(buffer_ + offset)) * kPrime1;
+        hash = std::rotl(hash, 23) * kPrime2 + kPrime3;
+        offset += 4;
+    }
+
+    for (; offset < buffered_; ++offset) {
+        hash ^= buffer_[offset] * kPrime5;
+        hash = std::rotl(hash, 11) * kPrime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= kPrime2;
+    hash ^= hash >> 29;
+    hash *= kPrime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+uint64_t XXHash64::Compute(const uint8_t* data, size_t size, uint64_t seed) {
+    XXHash64 hasher(seed);
+    hasher.Update(data, size);
+    return hasher.Digest();
+}
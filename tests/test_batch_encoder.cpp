@@ -0,0 +1,94 @@
+// test_batch_encoder.cpp
+#include <gtest/gtest.h>
+#include "batch_encoder.h"
+#include "test_util.h"
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+namespace fs = std::filesystem;
+
+bool IsPNG(const fs::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    char signature[8] = {};
+    in.read(signature, 8);
+    return in.gcount() == 8 && std::string(signature + 1, 3) == "PNG";
+}
+
+}  // namespace
+
+// Manifest lines follow the command line syntax; comments and blank lines are skipped
+// and the default arguments are overridden by the line's own options
+TEST(BatchEncoderTest, ReadsManifest) {
+    const std::string manifest = "batch_manifest.txt";
+    {
+        std::ofstream f(manifest);
+        f << "# comment\n"
+             "\n"
+             "a.raw a.png 4 2\n"
+             "b.raw b.png 8 6 negative --png-filter=up\n";
+    }
+
+    auto jobs = BatchEncoder::ReadManifest(manifest, {"--png-filter=paeth"});
+
+    ASSERT_EQ(jobs.size(), 2u);
+    EXPECT_EQ(jobs[0].input_path, "a.raw");
+    EXPECT_EQ(jobs[0].options.png_filter, PNGFilterStrategy::Paeth);
+    EXPECT_EQ(jobs[1].height, 6u);
+    EXPECT_EQ(jobs[1].options.color_filter, ColorFilterType::Negative);
+    EXPECT_EQ(jobs[1].options.png_filter, PNGFilterStrategy::Up);
+
+    std::remove(manifest.c_str());
+}
+
+// Directory batches take the dimensions from the file name, encode every file
+// and report per-file failures without stopping the batch
+TEST(BatchEncoderTest, EncodesDirectory) {
+    const fs::path input_dir = "batch_in";
+    const fs::path output_dir = "batch_out";
+    fs::remove_all(input_dir);
+    fs::remove_all(output_dir);
+    fs::create_directories(input_dir);
+
+    WriteRaw(input_dir / "one-8x4.raw", 8, 4);
+    WriteRaw(input_dir / "two-5x7.raw", 5, 7);
+    WriteRaw(input_dir / "short-9x9.raw", 2, 2);
+    WriteRaw(input_dir / "nosize.raw", 2, 2);
+
+    std::vector<std::string> skipped;
+    auto jobs = BatchEncoder::ScanDirectory(input_dir.string(), output_dir.string(), {}, &skipped);
+
+    ASSERT_EQ(jobs.size(), 3u);
+    ASSERT_EQ(skipped.size(), 1u);
+
+    // A tiny budget forces the jobs to run one at a time
+    BatchEncoder batch(2, 1);
+    BatchReport report = batch.Run(jobs);
+
+    ASSERT_EQ(report.results.size(), 3u);
+    EXPECT_EQ(report.failed, 1u);
+    EXPECT_TRUE(IsPNG(output_dir / "one-8x4.png"));
+    EXPECT_TRUE(IsPNG(output_dir / "two-5x7.png"));
+    EXPECT_EQ(report.input_bytes, (8u * 4u + 5u * 7u) * 3u);
+    EXPECT_GT(report.output_bytes, 0u);
+
+    fs::remove_all(input_dir);
+    fs::remove_all(output_dir);
+}
+
+// Every --sizes variant adds its own buffers to the job's memory estimate
+TEST(BatchEncoderTest, EstimateCountsSizeVariants) {
+    const EncodeJob plain = PNGEncoder::ParseJob({"a.raw", "a.png", "64", "32"});
+    const EncodeJob sized =
+        PNGEncoder::ParseJob({"a.raw", "a.png", "64", "32", "--sizes=1/2,1/4"});
+
+    const uint64_t half = 32 * 16 * 3 * 3 + 16 * (32 * 3 + 1);
+    const uint64_t quarter = 16 * 8 * 3 * 3 + 8 * (16 * 3 + 1);
+    EXPECT_EQ(BatchEncoder::EstimateJobBytes(sized),
+              BatchEncoder::EstimateJobBytes(plain) + half + quarter);
+}
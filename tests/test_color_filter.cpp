@@ -3,7 +3,10 @@
 #include "negative_filter.h"
 #include "grayscale_filter.h"
 #include "perlin_noise_filter.h"
+#include "color_filter.h"
+#include "test_util.h"
 #include <cstdint>
+#include <cstdlib>
 #include <vector>
 #include <algorithm>
 
@@ -100,4 +103,107 @@ TEST(PerlinNoiseFilterTest, DeterministicAndInRange) {
     }
 
     EXPECT_NE(out1, base);
-}
\ No newline at end of file
+}
+
+// PerlinNoiseFilter
+// Applying the noise band by band gives the same result as the whole image
+TEST(PerlinNoiseFilterTest, RowBandsMatchWholeImage) {
+    uint64_t width = 13;
+    uint64_t height = 9;
+    std::vector<uint8_t> whole(width * height * 3);
+    for (size_t i = 0; i < whole.size(); ++i) {
+        whole[i] = static_cast<uint8_t>(i * 5);
+    }
+    std::vector<uint8_t> banded = whole;
+
+    PerlinNoiseFilter::Apply(whole, width, height, 40.0f);
+
+    for (uint64_t y = 0; y < height; y += 4) {
+        uint64_t rows = std::min<uint64_t>(4, height - y);
+        PerlinNoiseFilter::ApplyRows(banded.data() + y * width * 3, width, y, rows, 40.0f);
+    }
+
+    EXPECT_EQ(banded, whole);
+}
+
+// GrayscaleFilter
+// The fixed-point weights stay within 1 of the float formula over a grid of colors
+TEST(GrayscaleFilterTest, FixedPointMatchesFloatWithinOne) {
+    std::vector<uint8_t> data;
+    for (int red = 0; red < 256; red += 3) {
+        for (int green = 0; green < 256; green += 5) {
+            for (int blue = 0; blue < 256; blue += 7) {
+                data.insert(data.end(), {static_cast<uint8_t>(red), static_cast<uint8_t>(green),
+                                         static_cast<uint8_t>(blue)});
+            }
+        }
+    }
+    std::vector<uint8_t> gray = data;
+
+    GrayscaleFilter::Apply(gray);
+
+    for (size_t i = 0; i < data.size(); i += 3) {
+        const float expected = 0.299f * data[i] + 0.587f * data[i + 1] + 0.114f * data[i + 2];
+        EXPECT_LE(std::abs(gray[i] - static_cast<int>(expected)), 1) << i;
+        EXPECT_EQ(gray[i], gray[i + 1]);
+        EXPECT_EQ(gray[i], gray[i + 2]);
+    }
+}
+
+// Every filter gives the same bytes on every instruction set, including row tails that
+// do not fill a vector
+TEST(ColorFilterTest, SIMDLevelsMatchScalar) {
+    const uint64_t width = 101;
+    const uint64_t height = 7;
+    const std::vector<uint8_t> original = MakeImage(width, height);
+
+    auto filtered = [&](auto filter) {
+        std::vector<uint8_t> data(original);
+        filter(data.data(), data.size());
+        return data;
+    };
+
+    for (SIMDLevel level : {SIMDLevel::SSE41, SIMDLevel::AVX2}) {
+        if (!PNGFilterKernels::IsSupported(level)) {
+            continue;
+        }
+
+        EXPECT_EQ(filtered([&](uint8_t* data, size_t size) {
+                      NegativeFilter::Apply(data, size, level);
+                  }),
+                  filtered([&](uint8_t* data, size_t size) {
+                      NegativeFilter::Apply(data, size, SIMDLevel::Scalar);
+                  }));
+        EXPECT_EQ(filtered([&](uint8_t* data, size_t size) {
+                      GrayscaleFilter::Apply(data, size, level);
+                  }),
+                  filtered([&](uint8_t* data, size_t size) {
+                      GrayscaleFilter::Apply(data, size, SIMDLevel::Scalar);
+                  }));
+
+        for (float percent : {5.0f, 50.0f, 100.0f}) {
+            EXPECT_EQ(filtered([&](uint8_t* data, size_t) {
+                          PerlinNoiseFilter::ApplyRows(data, width, 250, height, percent, level);
+                      }),
+                      filtered([&](uint8_t* data, size_t) {
+                          PerlinNoiseFilter::ApplyRows(data, width, 250, height, percent,
+                                                       SIMDLevel::Scalar);
+                      }))
+                << percent;
+        }
+    }
+}
+
+// Filtering row bands on a pool gives the same image as one pass
+TEST(ColorFilterTest, ParallelApplyMatchesSerial) {
+    const uint64_t width = 67;
+    const uint64_t height = 203;
+    const std::vector<uint8_t> pixels = MakeImage(width, height);
+    ThreadPool pool(4);
+
+    for (ColorFilterType type : {ColorFilterType::Negative, ColorFilterType::Grayscale,
+                                 ColorFilterType::PerlinNoise}) {
+        EXPECT_EQ(ColorFilter::Apply(pixels, width, height, type, 70.0f, &pool),
+                  ColorFilter::Apply(pixels, width, height, type, 70.0f));
+    }
+}
@@ -0,0 +1,148 @@
+// test_color_reduction.cpp
+#include <gtest/gtest.h>
+#include "color_reduction.h"
+#include "filter.h"
+#include "png_writer.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<uint8_t> MakeGray(const std::vector<uint8_t>& levels) {
+    std::vector<uint8_t> rgb;
+    for (uint8_t level : levels) {
+        rgb.insert(rgb.end(), {level, level, level});
+    }
+    return rgb;
+}
+
+PixelFormat AnalyzeRow(const std::vector<uint8_t>& rgb) {
+    return ColorReducer::Analyze({rgb, rgb.size() / 3, 1});
+}
+
+}  // namespace
+
+// Gray images take the smallest bit depth whose levels contain every value
+TEST(ColorReductionTest, DetectsGrayscaleDepth) {
+    auto format = AnalyzeRow(MakeGray({0, 255, 255, 0}));
+    EXPECT_EQ(format.color_type, PNGColorType::Grayscale);
+    EXPECT_EQ(format.bit_depth, 1);
+
+    format = AnalyzeRow(MakeGray({0, 85, 170, 255}));
+    EXPECT_EQ(format.color_type, PNGColorType::Grayscale);
+    EXPECT_EQ(format.bit_depth, 2);
+
+    format = AnalyzeRow(MakeGray({0, 17, 34, 51, 68, 85, 102, 119, 136, 153, 170}));
+    EXPECT_EQ(format.color_type, PNGColorType::Grayscale);
+    EXPECT_EQ(format.bit_depth, 4);
+
+    std::vector<uint8_t> ramp(256);
+    for (size_t i = 0; i < ramp.size(); ++i) {
+        ramp[i] = static_cast<uint8_t>(i);
+    }
+    format = AnalyzeRow(MakeGray(ramp));
+    EXPECT_EQ(format.color_type, PNGColorType::Grayscale);
+    EXPECT_EQ(format.bit_depth, 8);
+    EXPECT_TRUE(format.palette.empty());
+}
+
+// A few arbitrary gray levels are cheaper as a small palette than as 8-bit gray
+TEST(ColorReductionTest, PrefersSmallPaletteOverDeepGray) {
+    auto format = AnalyzeRow(MakeGray({3, 77, 200, 3}));
+    EXPECT_EQ(format.color_type, PNGColorType::Indexed);
+    EXPECT_EQ(format.bit_depth, 2);
+    EXPECT_EQ(format.palette, (std::vector<uint8_t>{3, 3, 3, 77, 77, 77, 200, 200, 200}));
+}
+
+// Palette depth follows the color count, more than 256 colors stay RGB
+TEST(ColorReductionTest, DetectsPaletteAndTruecolor) {
+    std::vector<uint8_t> rgb;
+    for (int i = 0; i < 5; ++i) {
+        rgb.push_back(static_cast<uint8_t>(i * 40));
+        rgb.push_back(10);
+        rgb.push_back(200);
+    }
+    auto format = AnalyzeRow(rgb);
+    EXPECT_EQ(format.color_type, PNGColorType::Indexed);
+    EXPECT_EQ(format.bit_depth, 4);
+    EXPECT_EQ(format.palette.size(), 15u);
+
+    rgb.clear();
+    for (int i = 0; i < 256; ++i) {
+        rgb.push_back(static_cast<uint8_t>(i));
+        rgb.push_back(1);
+        rgb.push_back(2);
+    }
+    format = AnalyzeRow(rgb);
+    EXPECT_EQ(format.color_type, PNGColorType::Indexed);
+    EXPECT_EQ(format.bit_depth, 8);
+
+    rgb.push_back(0);
+    rgb.push_back(2);
+    rgb.push_back(2);
+    format = AnalyzeRow(rgb);
+    EXPECT_TRUE(format.IsRGB8());
+    EXPECT_TRUE(format.palette.empty());
+}
+
+// Samples are packed MSB first and rows are padded to whole bytes
+TEST(ColorReductionTest, PacksSubByteSamples) {
+    PixelFormat gray;
+    gray.color_type = PNGColorType::Grayscale;
+    gray.bit_depth = 1;
+
+    auto packed = ColorReducer::Pack(MakeGray({255, 0, 255, 255, 0, 0, 0, 0, 255, 255}), 10, 1,
+                                     gray);
+    EXPECT_EQ(packed, (std::vector<uint8_t>{0b10110000, 0b11000000}));
+
+    PixelFormat indexed;
+    indexed.color_type = PNGColorType::Indexed;
+    indexed.bit_depth = 4;
+    indexed.palette = {0, 0, 0, 9, 9, 9, 200, 0, 0};
+
+    packed = ColorReducer::Pack(std::vector<uint8_t>{200, 0, 0, 9, 9, 9, 0, 0, 0}, 3, 1, indexed);
+    EXPECT_EQ(packed, (std::vector<uint8_t>{0x21, 0x00}));
+}
+
+// The color filter runs before the analysis: grayscale output is stored as gray
+TEST(ColorReductionTest, AnalyzesAfterColorFilter) {
+    std::vector<uint8_t> rgb;
+    for (int i = 0; i < 300; ++i) {
+        rgb.insert(rgb.end(), {static_cast<uint8_t>(i), static_cast<uint8_t>(i >> 8),
+                               static_cast<uint8_t>(i * 13)});
+    }
+
+    EXPECT_TRUE(ColorReducer::Analyze({rgb, 30, 10}).IsRGB8());
+
+    auto format = ColorReducer::Analyze({rgb, 30, 10}, ColorFilterType::Grayscale);
+    EXPECT_EQ(format.color_type, PNGColorType::Grayscale);
+
+    auto scanlines = PNGFilter::Apply(rgb, 30, 10, PNGFilterStrategy::Paeth,
+                                      ColorFilterType::Grayscale, -1.0f, format);
+    EXPECT_EQ(scanlines.size(), (format.RowBytes(30) + 1) * 10);
+}
+
+// Indexed images get a PLTE chunk between IHDR and IDAT
+TEST(ColorReductionTest, WriterEmitsPalette) {
+    PixelFormat format;
+    format.color_type = PNGColorType::Indexed;
+    format.bit_depth = 2;
+    format.palette = {1, 2, 3, 4, 5, 6};
+
+    MemorySink sink;
+    PNGWriter writer;
+    writer.WritePNG(sink, 4, 4, std::vector<uint8_t>(10), format);
+
+    const std::vector<uint8_t>& png = sink.Data();
+    EXPECT_EQ(png[8 + 8 + 8], 2);   // bit depth
+    EXPECT_EQ(png[8 + 8 + 9], 3);   // color type
+    EXPECT_EQ(std::string(png.begin() + 33 + 4, png.begin() + 33 + 8), "PLTE");
+    EXPECT_EQ(png[33 + 3], 6);
+
+    // More entries than the bit depth can address are rejected
+    format.palette.resize(5 * 3);
+    EXPECT_THROW(writer.WritePNG(sink, 4, 4, std::vector<uint8_t>(10), format),
+                 std::runtime_error);
+}
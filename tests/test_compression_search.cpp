@@ -0,0 +1,92 @@
+// test_compression_search.cpp
+#include <gtest/gtest.h>
+#include "compression_search.h"
+#include "encoder.h"
+#include "test_util.h"
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// The search keeps the smallest stream of the matrix, byte for byte what the chosen
+// filter and profile give when applied directly; the first trial wins ties
+TEST(CompressionSearchTest, KeepsSmallestTrial) {
+    const uint64_t width = 80;
+    const uint64_t height = 60;
+    auto pixels = MakeNoisyGradient(width, height);
+
+    auto trials = CompressionSearch::Matrix(
+        {PNGFilterStrategy::None, PNGFilterStrategy::Paeth, PNGFilterStrategy::MinSum}, {1, 9},
+        {DeflateStrategy::Default, DeflateStrategy::RLE}, {8});
+    ASSERT_EQ(trials.size(), 12u);
+
+    PNGFilterBuffers buffers;
+    SearchResult result = CompressionSearch::Run({pixels, width, height}, ColorFilterType::None,
+                                                 -1.0f, {}, trials, nullptr, buffers);
+
+    std::vector<uint8_t> smallest;
+    SearchTrial smallest_trial;
+    for (const SearchTrial& trial : trials) {
+        auto scanlines = PNGFilter::Apply(pixels, width, height, trial.png_filter,
+                                          ColorFilterType::None);
+        auto compressed = DeflateCompressor::Compress(scanlines, trial.compression);
+
+        if (smallest.empty() || compressed.size() < smallest.size()) {
+            smallest = compressed;
+            smallest_trial = trial;
+        }
+    }
+
+    EXPECT_EQ(result.trials, trials.size());
+    EXPECT_EQ(result.best, smallest_trial);
+    EXPECT_EQ(result.compressed, smallest);
+    // Run serially in matrix order, some later trial loses before it finishes
+    EXPECT_GT(result.stopped, 0u);
+}
+
+// Trials running concurrently on the pool pick the same winner as the serial search
+TEST(CompressionSearchTest, PoolMatchesSerial) {
+    const uint64_t width = 64;
+    const uint64_t height = 48;
+    auto pixels = MakeNoisyGradient(width, height);
+    ThreadPool pool(4);
+
+    auto trials = CompressionSearch::DefaultTrials();
+    EXPECT_EQ(trials.size(), 42u);
+
+    PNGFilterBuffers buffers;
+    SearchResult serial = CompressionSearch::Run({pixels, width, height}, ColorFilterType::None,
+                                                 -1.0f, {}, trials, nullptr, buffers);
+    SearchResult parallel = CompressionSearch::Run({pixels, width, height},
+                                                   ColorFilterType::None, -1.0f, {}, trials,
+                                                   &pool, buffers);
+
+    EXPECT_EQ(parallel.best, serial.best);
+    EXPECT_EQ(parallel.compressed, serial.compressed);
+}
+
+// --search writes a PNG no larger than the default settings; other backends, streaming
+// and an empty matrix are rejected
+TEST(CompressionSearchTest, EncoderOptionAndErrors) {
+    const uint64_t width = 40;
+    const uint64_t height = 30;
+    auto pixels = MakeNoisyGradient(width, height);
+
+    std::vector<std::string> positional;
+    EncodeOptions options = PNGEncoder::ParseOptions({"--search"}, positional);
+    EXPECT_TRUE(options.search);
+
+    auto searched = PNGEncoder::EncodeToMemory({pixels, width, height}, options);
+    auto plain = PNGEncoder::EncodeToMemory({pixels, width, height});
+    EXPECT_LE(searched.size(), plain.size());
+
+    EXPECT_THROW(PNGEncoder::ParseOptions({"--search", "--stream"}, positional),
+                 std::runtime_error);
+    EXPECT_THROW(PNGEncoder::ParseOptions({"--search", "--deflate=archival"}, positional),
+                 std::runtime_error);
+
+    PNGFilterBuffers buffers;
+    EXPECT_THROW(CompressionSearch::Run({pixels, width, height}, ColorFilterType::None, -1.0f,
+                                        {}, {}, nullptr, buffers),
+                 std::runtime_error);
+}
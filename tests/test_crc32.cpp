@@ -0,0 +1,72 @@
+// test_crc32.cpp
+#include <gtest/gtest.h>
+#include "crc32.h"
+#include "test_util.h"
+#include <zlib.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The well-known check value of CRC-32/ISO-HDLC and the CRC of an IEND chunk
+TEST(CRC32Test, KnownValues) {
+    const std::string check = "123456789";
+    EXPECT_EQ(CRC32::Compute(reinterpret_cast<const uint8_t*>(check.data()), check.size()),
+              0xCBF43926u);
+
+    const std::string iend = "IEND";
+    EXPECT_EQ(CRC32::Compute(reinterpret_cast<const uint8_t*>(iend.data()), iend.size()),
+              0xAE426082u);
+}
+
+// Every supported engine agrees with zlib for all lengths and misalignments
+TEST(CRC32Test, EnginesMatchZlib) {
+    auto data = RandomBytes(4096 + 64);
+
+    for (CRC32Engine engine :
+         {CRC32Engine::Bytewise, CRC32Engine::SliceBy8, CRC32Engine::PCLMUL}) {
+        if (!CRC32::IsSupported(engine)) {
+            continue;
+        }
+
+        for (size_t offset : {0u, 1u, 3u, 7u}) {
+            for (size_t size = 0; size <= 300; ++size) {
+                uint32_t expected = static_cast<uint32_t>(
+                    crc32(0L, data.data() + offset, static_cast<uInt>(size)));
+                ASSERT_EQ(CRC32::Compute(engine, data.data() + offset, size), expected)
+                    << "engine " << static_cast<int>(engine) << ", size " << size;
+            }
+
+            uint32_t expected = static_cast<uint32_t>(crc32(0L, data.data() + offset, 4096));
+            EXPECT_EQ(CRC32::Compute(engine, data.data() + offset, 4096), expected);
+        }
+    }
+}
+
+// Hashing in pieces gives the same value as hashing the concatenation
+TEST(CRC32Test, IncrementalUpdate) {
+    auto data = RandomBytes(1000);
+
+    CRC32 crc;
+    crc.Update(data.data(), 4);
+    crc.Update(data.data() + 4, 555);
+    crc.Update(data.data() + 559, 441);
+
+    EXPECT_EQ(crc.Value(), CRC32::Compute(data.data(), data.size()));
+
+    crc.Reset();
+    EXPECT_EQ(crc.Value(), 0u);
+}
+
+// Combine joins the CRCs of two independently hashed pieces
+TEST(CRC32Test, Combine) {
+    auto data = RandomBytes(70000);
+
+    for (size_t split : {0u, 1u, 17u, 4096u, 65536u, 70000u}) {
+        uint32_t first = CRC32::Compute(data.data(), split);
+        uint32_t second = CRC32::Compute(data.data() + split, data.size() - split);
+
+        EXPECT_EQ(CRC32::Combine(first, second, data.size() - split),
+                  CRC32::Compute(data.data(), data.size()))
+            << "split " << split;
+    }
+}
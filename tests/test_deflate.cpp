@@ -0,0 +1,209 @@
+// test_deflate.cpp
+#include <gtest/gtest.h>
+#include "archival_deflate.h"
+#include "deflate.h"
+#include "deflate_backend.h"
+#include "parallel_deflate.h"
+#include "thread_pool.h"
+#include "test_util.h"
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace {
+
+// Compressible scanline-like data: repeated rows with a little noise
+std::vector<uint8_t> MakeScanlines(size_t row_size, size_t rows) {
+    std::mt19937 gen(42);
+    std::vector<uint8_t> data(row_size * rows);
+
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<uint8_t>((i % row_size) / 5 + (gen() % 4));
+    }
+
+    return data;
+}
+
+}  // namespace
+
+// Single-threaded compressor output decodes back to the input
+TEST(DeflateTest, CompressRoundTrip) {
+    auto data = MakeScanlines(301, 50);
+
+    auto compressed = DeflateCompressor::Compress(data);
+
+    EXPECT_LT(compressed.size(), data.size());
+    EXPECT_EQ(Inflate(compressed, data.size()), data);
+}
+
+// Parallel output is a single valid zlib stream for various block counts,
+// including blocks smaller than a row and an empty input
+TEST(DeflateTest, ParallelCompressRoundTrip) {
+    ThreadPool pool(4);
+    const size_t row_size = 1280 * 3 + 1;
+    auto data = MakeScanlines(row_size, 120);
+
+    for (size_t block_size : {size_t{1}, row_size * 7, size_t{64 * 1024}, data.size() * 2}) {
+        auto compressed = ParallelDeflateCompressor::Compress(data, row_size, pool, {}, block_size);
+        EXPECT_EQ(Inflate(compressed, data.size()), data) << "block size " << block_size;
+    }
+
+    std::vector<uint8_t> empty;
+    auto compressed = ParallelDeflateCompressor::Compress(empty, row_size, pool);
+    EXPECT_TRUE(Inflate(compressed, 0).empty());
+}
+
+// Preset dictionaries keep the parallel ratio close to the single-stream one
+TEST(DeflateTest, ParallelRatioCloseToSerial) {
+    ThreadPool pool(4);
+    const size_t row_size = 640 * 3 + 1;
+    auto data = MakeScanlines(row_size, 400);
+
+    auto serial = DeflateCompressor::Compress(data);
+    auto parallel = ParallelDeflateCompressor::Compress(data, row_size, pool);
+
+    EXPECT_LT(parallel.size(), serial.size() * 102 / 100);
+}
+
+// Every preset and strategy produces a decodable stream, also when compressed in parallel
+TEST(DeflateTest, ProfilesRoundTrip) {
+    ThreadPool pool(3);
+    const size_t row_size = 200 * 3 + 1;
+    auto data = MakeScanlines(row_size, 300);
+
+    std::vector<CompressionProfile> profiles = {CompressionProfile::Fast(),
+                                                CompressionProfile::Balanced(),
+                                                CompressionProfile::Max()};
+    profiles.push_back({0, DeflateStrategy::Default, 15, 8});
+    profiles.push_back({4, DeflateStrategy::HuffmanOnly, 12, 5});
+    profiles.push_back({7, DeflateStrategy::Fixed, 9, 1});
+
+    for (const auto& profile : profiles) {
+        EXPECT_EQ(Inflate(DeflateCompressor::Compress(data, profile), data.size()), data)
+            << "level " << profile.level;
+        EXPECT_EQ(Inflate(ParallelDeflateCompressor::Compress(data, row_size, pool, profile,
+                                                              16 * 1024),
+                          data.size()),
+                  data)
+            << "level " << profile.level;
+    }
+}
+
+// Preset and strategy names are parsed case-insensitively, bad parameters are rejected
+TEST(DeflateTest, ParseAndValidateProfile) {
+    EXPECT_EQ(CompressionProfile::Parse("FAST").strategy, DeflateStrategy::RLE);
+    EXPECT_EQ(CompressionProfile::Parse("balanced").level, 6);
+    EXPECT_EQ(CompressionProfile::Parse("max").level, 9);
+    EXPECT_EQ(CompressionProfile::ParseStrategy("huffman"), DeflateStrategy::HuffmanOnly);
+    EXPECT_THROW(CompressionProfile::Parse("ultra"), std::runtime_error);
+    EXPECT_THROW(CompressionProfile::ParseStrategy("lz4"), std::runtime_error);
+
+    std::vector<uint8_t> data(10, 1);
+    EXPECT_THROW(DeflateCompressor::Compress(data, {10, DeflateStrategy::Default, 15, 8}),
+                 std::runtime_error);
+    EXPECT_THROW(DeflateCompressor::Compress(data, {9, DeflateStrategy::Default, 16, 8}),
+                 std::runtime_error);
+    EXPECT_THROW(DeflateCompressor::Compress(data, {9, DeflateStrategy::Default, 15, 0}),
+                 std::runtime_error);
+}
+
+// A reused deflater gives the same bytes as a fresh compressor, across inputs of
+// different sizes and after the profile changes
+TEST(DeflateTest, ReusableDeflaterMatchesCompress) {
+    ReusableDeflater deflater;
+
+    for (const auto& profile : {CompressionProfile::Max(), CompressionProfile::Max(),
+                                CompressionProfile::Fast(), CompressionProfile::Balanced()}) {
+        for (size_t rows : {64, 3, 200}) {
+            auto data = MakeScanlines(301, rows);
+            PixelView reused = deflater.Compress(data, profile);
+
+            EXPECT_EQ(std::vector<uint8_t>(reused.begin(), reused.end()),
+                      DeflateCompressor::Compress(data, profile));
+        }
+    }
+}
+
+// Every built-in backend writes a decodable zlib stream through both compressors, one
+// deflater switches between backends, and missing backends are rejected up front
+TEST(DeflateTest, BackendsRoundTrip) {
+    auto data = MakeScanlines(301, 80);
+    ReusableDeflater deflater;
+
+    for (DeflateBackendType type : {DeflateBackendType::Zlib,
+                                    DeflateBackendType::Libdeflate}) {
+        CompressionProfile profile;
+        profile.backend = type;
+
+        if (!DeflateBackend::IsAvailable(type)) {
+            EXPECT_THROW(DeflateCompressor::Compress(data, profile), std::runtime_error);
+            continue;
+        }
+
+        for (int level : {1, 6, 9}) {
+            profile.level = level;
+            PixelView reused = deflater.Compress(data, profile);
+
+            EXPECT_EQ(Inflate(std::vector<uint8_t>(reused.begin(), reused.end()), data.size()),
+                      data)
+                << DeflateBackend::Name(type) << " level " << level;
+            EXPECT_EQ(Inflate(DeflateCompressor::Compress(data, profile), data.size()), data)
+                << DeflateBackend::Name(type) << " level " << level;
+        }
+    }
+
+    EXPECT_EQ(CompressionProfile::ParseBackend("LibDeflate"), DeflateBackendType::Libdeflate);
+    EXPECT_THROW(CompressionProfile::ParseBackend("zlib-ng"), std::runtime_error);
+    EXPECT_THROW(CompressionProfile::ParseBackend("brotli"), std::runtime_error);
+}
+
+// The archival compressor decodes back to the input for edge cases, long runs across master
+// blocks and incompressible data, also through the backend interface
+TEST(DeflateTest, ArchivalRoundTrip) {
+    CompressionProfile profile;
+    profile.backend = DeflateBackendType::Archival;
+    profile.iterations = 2;
+
+    std::mt19937 gen(7);
+    std::vector<uint8_t> random(20000);
+    for (uint8_t& byte : random) {
+        byte = static_cast<uint8_t>(gen());
+    }
+
+    const std::vector<std::vector<uint8_t>> inputs = {
+        {},
+        {42},
+        std::vector<uint8_t>(ArchivalDeflateCompressor::kMasterBlockSize * 3 / 2, 0),
+        random,
+        MakeScanlines(301, 40),
+    };
+
+    for (const std::vector<uint8_t>& data : inputs) {
+        auto compressed = ArchivalDeflateCompressor::Compress(data, profile);
+
+        EXPECT_LE(compressed.size(), ArchivalDeflateCompressor::Bound(data.size()));
+        EXPECT_EQ(Inflate(compressed, data.size()), data) << "size " << data.size();
+        EXPECT_EQ(Inflate(DeflateCompressor::Compress(data, profile), data.size()), data)
+            << "size " << data.size();
+    }
+
+    profile.iterations = 0;
+    EXPECT_THROW(profile.Validate(), std::runtime_error);
+    EXPECT_EQ(CompressionProfile::ParseBackend("archival"), DeflateBackendType::Archival);
+}
+
+// Optimal parsing beats zlib level 9, and the pool changes only the speed, not the bytes
+TEST(DeflateTest, ArchivalSmallerThanZlibAndThreadIndependent) {
+    ThreadPool pool(4);
+    auto data = MakeScanlines(641, 60);
+
+    CompressionProfile profile;
+    profile.iterations = 3;
+
+    auto serial = ArchivalDeflateCompressor::Compress(data, profile);
+    auto parallel = ArchivalDeflateCompressor::Compress(data, profile, &pool);
+
+    EXPECT_LT(serial.size(), DeflateCompressor::Compress(data).size());
+    EXPECT_EQ(serial, parallel);
+    EXPECT_EQ(Inflate(serial, data.size()), data);
+}
@@ -0,0 +1,199 @@
+// test_encode_cache.cpp
+#include <gtest/gtest.h>
+#include "batch_encoder.h"
+#include "encode_cache.h"
+#include "encoder_context.h"
+#include "test_util.h"
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace {
+
+namespace fs = std::filesystem;
+
+EncodeJob MakeJob(const fs::path& input, const fs::path& output, uint64_t width,
+                  uint64_t height) {
+    EncodeJob job;
+    job.input_path = input.string();
+    job.output_path = output.string();
+    job.width = width;
+    job.height = height;
+    return job;
+}
+
+size_t CountEntries(const fs::path& dir) {
+    size_t count = 0;
+    for (const auto& entry : fs::directory_iterator(dir)) {
+        count += entry.path().extension() == ".png";
+    }
+    return count;
+}
+
+}  // namespace
+
+// The second encode of the same input and options is served from the cache and equals
+// the first; re-encoding over an output linked to an entry leaves the entry intact
+TEST(EncodeCacheTest, HitReproducesOutput) {
+    const fs::path dir = fs::temp_directory_path() / "png_encoder_cache_test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    WriteRaw(dir / "in.raw", 24, 16, 0);
+
+    EncodeCache cache((dir / "cache").string());
+    ThreadPool pool(2);
+    EncoderContext context;
+
+    EncodeJob job = MakeJob(dir / "in.raw", dir / "first.png", 24, 16);
+    PNGEncoder::EncodeFile(job, pool, context, &cache);
+    EXPECT_EQ(cache.Stats().misses, 1u);
+    EXPECT_EQ(cache.Stats().stores, 1u);
+
+    job.output_path = (dir / "second.png").string();
+    PNGEncoder::EncodeFile(job, pool, context, &cache);
+    EXPECT_EQ(cache.Stats().hits, 1u);
+    EXPECT_EQ(cache.Stats().stores, 1u);
+    EXPECT_EQ(ReadFile(dir / "first.png"), ReadFile(dir / "second.png"));
+    EXPECT_EQ(cache.Stats().bytes, fs::file_size(dir / "first.png"));
+
+    // New pixels under the same output path: a miss that must not write through the link
+    const std::vector<uint8_t> cached = ReadFile(dir / "second.png");
+    WriteRaw(dir / "in.raw", 24, 16, 7);
+    PNGEncoder::EncodeFile(job, pool, context, &cache);
+    EXPECT_EQ(cache.Stats().misses, 2u);
+    EXPECT_NE(ReadFile(dir / "second.png"), cached);
+    EXPECT_EQ(ReadFile(dir / "first.png"), cached);
+    EXPECT_EQ(CountEntries(dir / "cache"), 2u);
+
+    // Batch jobs share the cache
+    BatchEncoder batch(2);
+    batch.SetCache(&cache);
+    job.output_path = (dir / "third.png").string();
+    EXPECT_EQ(batch.Run({job}).failed, 0u);
+    EXPECT_EQ(cache.Stats().hits, 2u);
+    EXPECT_EQ(ReadFile(dir / "third.png"), ReadFile(dir / "second.png"));
+
+    fs::remove_all(dir);
+}
+
+// Outputs written without the cache, here by --sizes, replace a file linked to an entry
+// instead of writing through it; an unshared output is rewritten in place, keeping its mode
+TEST(EncodeCacheTest, OtherWritersLeaveEntriesIntact) {
+    const fs::path dir = fs::temp_directory_path() / "png_encoder_cache_writers_test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    WriteRaw(dir / "in.raw", 20, 12, 0);
+
+    EncodeCache cache((dir / "cache").string());
+    ThreadPool pool(2);
+    EncoderContext context;
+
+    EncodeJob job = MakeJob(dir / "in.raw", dir / "out.png", 20, 12);
+    PNGEncoder::EncodeFile(job, pool, context, &cache);
+    PNGEncoder::EncodeFile(job, pool, context, &cache);
+    ASSERT_EQ(cache.Stats().hits, 1u);
+    ASSERT_EQ(fs::hard_link_count(dir / "out.png"), 2u);
+    const std::vector<uint8_t> cached = ReadFile(dir / "out.png");
+
+    EncodeJob sized = job;
+    sized.options.color_filter = ColorFilterType::Negative;
+    sized.options.sizes = OutputSize::ParseList("1/2");
+    PNGEncoder::EncodeFile(sized, pool, context);
+    EXPECT_NE(ReadFile(dir / "out.png"), cached);
+    EXPECT_EQ(fs::hard_link_count(dir / "out.png"), 1u);
+
+    fs::permissions(dir / "out.png", fs::perms::owner_read | fs::perms::owner_write);
+    PNGEncoder::EncodeFile(job, pool, context);
+    EXPECT_EQ(ReadFile(dir / "out.png"), cached);
+    EXPECT_EQ(fs::status(dir / "out.png").permissions(),
+              fs::perms::owner_read | fs::perms::owner_write);
+
+    job.output_path = (dir / "again.png").string();
+    PNGEncoder::EncodeFile(job, pool, context, &cache);
+    EXPECT_EQ(cache.Stats().hits, 2u);
+    EXPECT_EQ(ReadFile(dir / "again.png"), cached);
+
+    fs::remove_all(dir);
+}
+
+// Options that change the PNG change the key, the thread count beyond one does not
+TEST(EncodeCacheTest, KeyCoversOptions) {
+    std::vector<uint8_t> pixels(4 * 4 * 3, 9);
+    EncodeJob job = MakeJob("in.raw", "out.png", 4, 4);
+    job.options.threads = 2;
+    const std::string key = EncodeCache::Key(job, pixels);
+    EXPECT_EQ(key.size(), 32u);
+
+    EncodeJob other = job;
+    other.options.threads = 8;
+    other.output_path = "elsewhere.png";
+    EXPECT_EQ(EncodeCache::Key(other, pixels), key);
+
+    other = job;
+    other.options.png_filter = PNGFilterStrategy::Paeth;
+    EXPECT_NE(EncodeCache::Key(other, pixels), key);
+
+    other = job;
+    other.options.compression.level = 1;
+    EXPECT_NE(EncodeCache::Key(other, pixels), key);
+
+    other = job;
+    other.width = 2;
+    other.height = 8;
+    EXPECT_NE(EncodeCache::Key(other, pixels), key);
+
+    pixels[5] = 10;
+    EXPECT_NE(EncodeCache::Key(job, pixels).substr(0, 16), key.substr(0, 16));
+    EXPECT_EQ(EncodeCache::Key(job, pixels).substr(16), key.substr(16));
+
+    other = job;
+    other.output_path = "-";
+    EXPECT_FALSE(EncodeCache::IsCacheable(other));
+    other = job;
+    other.options.streaming = true;
+    EXPECT_FALSE(EncodeCache::IsCacheable(other));
+    EXPECT_TRUE(EncodeCache::IsCacheable(job));
+}
+
+// Above its limit the cache evicts the least recently used entries, a hit counting as a use
+TEST(EncodeCacheTest, EvictsLeastRecentlyUsed) {
+    const fs::path dir = fs::temp_directory_path() / "png_encoder_cache_evict_test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    std::vector<EncodeJob> jobs;
+    for (uint8_t i = 0; i < 3; ++i) {
+        const std::string name = "img" + std::to_string(i);
+        WriteRaw(dir / (name + ".raw"), 32, 32, i * 50);
+        jobs.push_back(MakeJob(dir / (name + ".raw"), dir / (name + ".png"), 32, 32));
+    }
+
+    ThreadPool pool(1);
+    EncoderContext context;
+    PNGEncoder::EncodeFile(jobs[0], pool, context);
+    const uint64_t entry_bytes = fs::file_size(jobs[0].output_path);
+
+    // Room for two entries
+    EncodeCache cache((dir / "cache").string(), entry_bytes * 5 / 2);
+    PNGEncoder::EncodeFile(jobs[0], pool, context, &cache);
+    PNGEncoder::EncodeFile(jobs[1], pool, context, &cache);
+    PNGEncoder::EncodeFile(jobs[0], pool, context, &cache);
+    EXPECT_EQ(cache.Stats().hits, 1u);
+    EXPECT_EQ(cache.Stats().evictions, 0u);
+
+    PNGEncoder::EncodeFile(jobs[2], pool, context, &cache);
+    EXPECT_EQ(cache.Stats().stores, 3u);
+    EXPECT_EQ(cache.Stats().evictions, 1u);
+    EXPECT_LE(cache.Stats().bytes, entry_bytes * 5 / 2);
+    EXPECT_EQ(CountEntries(dir / "cache"), 2u);
+
+    // jobs[1] was the least recently used
+    PNGEncoder::EncodeFile(jobs[0], pool, context, &cache);
+    PNGEncoder::EncodeFile(jobs[2], pool, context, &cache);
+    EXPECT_EQ(cache.Stats().hits, 3u);
+    PNGEncoder::EncodeFile(jobs[1], pool, context, &cache);
+    EXPECT_EQ(cache.Stats().misses, 4u);
+
+    fs::remove_all(dir);
+}
@@ -0,0 +1,71 @@
+// test_encode_stats.cpp
+#include <gtest/gtest.h>
+#include "encode_stats.h"
+#include "encoder.h"
+#include "thread_pool.h"
+#include "test_util.h"
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Every stage of an in-memory encode reports to the installed collector, also from the
+// pool workers, and the byte counts line up between neighbouring stages
+TEST(EncodeStatsTest, CollectsEncodeStages) {
+    if (!StatsCollector::kEnabled) {
+        GTEST_SKIP() << "built without PNG_ENCODER_ENABLE_STATS";
+    }
+
+    const uint64_t width = 160;
+    const uint64_t height = 120;
+    auto pixels = MakeImage(width, height);
+
+    EncodeOptions options;
+    options.color_filter = ColorFilterType::Negative;
+    options.threads = 4;
+    ThreadPool pool(4);
+
+    StatsCollector collector;
+    std::vector<uint8_t> png;
+    {
+        ScopedStatsCollector scope(&collector);
+        MemorySink sink;
+        PNGEncoder::Encode(ImageView(pixels, width, height), options, sink, pool);
+        png = sink.TakeData();
+    }
+    EncodeStats stats = collector.Snapshot();
+
+    const EncodeStageStats& filter = stats.Stage(EncodeStage::PNGFilter);
+    const EncodeStageStats& deflate = stats.Stage(EncodeStage::Deflate);
+    const EncodeStageStats& write = stats.Stage(EncodeStage::Write);
+
+    EXPECT_EQ(filter.bytes_in, pixels.size());
+    EXPECT_GT(filter.calls, 1u);
+    EXPECT_GE(stats.Stage(EncodeStage::ColorFilter).calls, height);
+    EXPECT_EQ(deflate.bytes_in, filter.bytes_out);
+    EXPECT_EQ(write.bytes_out, png.size());
+    EXPECT_GT(stats.Stage(EncodeStage::CRC).calls, 2u);
+    EXPECT_NE(stats.ToJSON().find("\"deflate\":{\"calls\":"), std::string::npos);
+
+    // Nothing is collected outside the scope
+    PNGEncoder::EncodeToMemory(ImageView(pixels, width, height), options, pool);
+    EXPECT_EQ(collector.Snapshot().Stage(EncodeStage::Write).calls, write.calls);
+}
+
+// A nested timer's time is taken out of the enclosing stage
+TEST(EncodeStatsTest, NestedTimersCountOwnTime) {
+    if (!StatsCollector::kEnabled) {
+        GTEST_SKIP() << "built without PNG_ENCODER_ENABLE_STATS";
+    }
+
+    StatsCollector collector;
+    {
+        ScopedStatsCollector scope(&collector);
+        StageTimer outer(EncodeStage::PNGFilter);
+        StageTimer inner(EncodeStage::ColorFilter);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    EncodeStats stats = collector.Snapshot();
+
+    EXPECT_GE(stats.Stage(EncodeStage::ColorFilter).nanoseconds, 20'000'000u);
+    EXPECT_LT(stats.Stage(EncodeStage::PNGFilter).nanoseconds, 10'000'000u);
+}
@@ -0,0 +1,185 @@
+// test_encoder.cpp
+#include <gtest/gtest.h>
+#include "encoder.h"
+#include "encoder_context.h"
+#include "image_loader.h"
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Positional arguments and options are parsed the way the command line expects
+TEST(EncoderTest, ParsesJobArguments) {
+    EncodeJob job = PNGEncoder::ParseJob(
+        {"in.raw", "--png-filter=paeth", "out.png", "640", "480", "Perlin", "75", "--stream"});
+
+    EXPECT_EQ(job.input_path, "in.raw");
+    EXPECT_EQ(job.output_path, "out.png");
+    EXPECT_EQ(job.width, 640u);
+    EXPECT_EQ(job.height, 480u);
+    EXPECT_EQ(job.options.color_filter, ColorFilterType::PerlinNoise);
+    EXPECT_FLOAT_EQ(job.options.perlin_strength, 75.0f);
+    EXPECT_EQ(job.options.png_filter, PNGFilterStrategy::Paeth);
+    EXPECT_TRUE(job.options.streaming);
+}
+
+// Explicit zlib parameters override the preset whatever their position
+TEST(EncoderTest, CompressionOverridesPreset) {
+    EncodeJob job = PNGEncoder::ParseJob(
+        {"in.raw", "out.png", "1", "1", "--level=3", "--compression=fast", "--mem-level=4"});
+
+    EXPECT_EQ(job.options.compression.level, 3);
+    EXPECT_EQ(job.options.compression.strategy, DeflateStrategy::RLE);
+    EXPECT_EQ(job.options.compression.mem_level, 4);
+}
+
+// Malformed argument lists are rejected
+TEST(EncoderTest, RejectsBadArguments) {
+    EXPECT_THROW(PNGEncoder::ParseJob({"in.raw", "out.png", "1"}), std::runtime_error);
+    EXPECT_THROW(PNGEncoder::ParseJob({"in.raw", "out.png", "1", "1", "negative", "5"}),
+                 std::runtime_error);
+    EXPECT_THROW(PNGEncoder::ParseJob({"in.raw", "out.png", "1", "1", "--bogus=1"}),
+                 std::runtime_error);
+}
+
+// Encoding into a reused context gives the same file as a fresh one, and a second
+// image of the same size reuses the buffers instead of reallocating them
+TEST(EncoderTest, ReusedContextKeepsBuffers) {
+    const std::string input = "context_in.raw";
+    std::vector<uint8_t> pixels(64 * 48 * 3);
+    for (size_t i = 0; i < pixels.size(); ++i) {
+        pixels[i] = static_cast<uint8_t>(i * 7 + i / 193);
+    }
+    std::ofstream(input, std::ios::binary)
+        .write(reinterpret_cast<const char*>(pixels.data()), pixels.size());
+
+    EncodeJob job = PNGEncoder::ParseJob({input, "context_fresh.png", "64", "48"});
+    PNGEncoder::EncodeFile(job);
+
+    EncoderContext context;
+    job.output_path = "context_reused.png";
+    PNGEncoder::EncodeFile(job, ThreadPool::Shared(), context);
+
+    const uint8_t* scanlines = context.FilterBuffers().scanlines.data();
+    const size_t retained = context.RetainedBytes();
+
+    PNGEncoder::EncodeFile(job, ThreadPool::Shared(), context);
+    EXPECT_EQ(context.FilterBuffers().scanlines.data(), scanlines);
+    EXPECT_EQ(context.RetainedBytes(), retained);
+
+    auto read = [](const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        return std::vector<char>(std::istreambuf_iterator<char>(in), {});
+    };
+    EXPECT_EQ(read("context_fresh.png"), read("context_reused.png"));
+
+    context.Trim(0);
+    EXPECT_EQ(context.RetainedBytes(), 0u);
+
+    for (const char* path : {"context_in.raw", "context_fresh.png", "context_reused.png"}) {
+        std::remove(path);
+    }
+}
+
+// The in-memory API produces the same PNG as the file pipeline, reads rows at any
+// stride and can write into a fixed caller buffer
+TEST(EncoderTest, EncodesFromAndToMemory) {
+    const uint64_t width = 37;
+    const uint64_t height = 21;
+    const size_t stride = width * 3 + 13;
+
+    std::vector<uint8_t> packed(width * height * 3);
+    std::vector<uint8_t> padded(stride * height, 0xEE);
+    for (uint64_t y = 0; y < height; ++y) {
+        for (size_t i = 0; i < width * 3; ++i) {
+            packed[y * width * 3 + i] = static_cast<uint8_t>(y * 11 + i * 5);
+            padded[y * stride + i] = packed[y * width * 3 + i];
+        }
+    }
+
+    const std::string input = "memory_in.raw";
+    const std::string output = "memory_out.png";
+    std::ofstream(input, std::ios::binary)
+        .write(reinterpret_cast<const char*>(packed.data()), packed.size());
+
+    EncodeJob job = PNGEncoder::ParseJob({input, output, "37", "21", "negative"});
+    PNGEncoder::EncodeFile(job);
+
+    std::ifstream in(output, std::ios::binary);
+    std::vector<uint8_t> from_file((std::istreambuf_iterator<char>(in)),
+                                   std::istreambuf_iterator<char>());
+    in.close();
+
+    auto from_memory = PNGEncoder::EncodeToMemory(
+        ImageLoader::FromMemory(padded.data(), width, height, stride), job.options);
+    EXPECT_EQ(from_memory, from_file);
+
+    std::vector<uint8_t> buffer(from_file.size());
+    BufferSink exact(buffer.data(), buffer.size());
+    PNGEncoder::Encode({packed, width, height}, job.options, exact);
+    EXPECT_EQ(exact.Size(), from_file.size());
+    EXPECT_EQ(buffer, from_file);
+
+    BufferSink too_small(buffer.data(), buffer.size() - 1);
+    EXPECT_THROW(PNGEncoder::Encode({packed, width, height}, job.options, too_small),
+                 std::runtime_error);
+
+    std::remove(input.c_str());
+    std::remove(output.c_str());
+}
+
+// Caller buffers too short for the image, short strides and empty images are rejected
+// before any pixel is read
+TEST(EncoderTest, RejectsBadMemoryImages) {
+    std::vector<uint8_t> pixels(8 * 4 * 3 - 1);
+    EXPECT_THROW(ImageView(pixels, 8, 4), std::runtime_error);
+    EXPECT_NO_THROW(ImageView(pixels, 8, 3));
+
+    EncodeOptions options;
+    EXPECT_THROW(PNGEncoder::EncodeToMemory(ImageView(pixels.data(), 8, 3, 8 * 3 - 1), options),
+                 std::runtime_error);
+    EXPECT_THROW(PNGEncoder::EncodeToMemory(ImageView(nullptr, 8, 3), options),
+                 std::runtime_error);
+    EXPECT_THROW(PNGEncoder::EncodeToMemory(ImageView(pixels.data(), 0, 3), options),
+                 std::runtime_error);
+}
+
+// --sizes writes the full image plus one file per extra size next to it, all from one
+// read of the input, serially and on the pool alike
+TEST(EncoderTest, WritesDownscaledSizes) {
+    const std::string input = "sizes_in.raw";
+    std::vector<uint8_t> pixels(120 * 80 * 3);
+    for (size_t i = 0; i < pixels.size(); ++i) {
+        pixels[i] = static_cast<uint8_t>(i * 5 + i / 360);
+    }
+    std::ofstream(input, std::ios::binary)
+        .write(reinterpret_cast<const char*>(pixels.data()), pixels.size());
+
+    for (const char* threads : {"--threads=1", "--threads=3"}) {
+        EncodeJob job = PNGEncoder::ParseJob(
+            {input, "sizes.png", "120", "80", "--sizes=1/2,50w", "--resize=bilinear", threads});
+        PNGEncoder::EncodeFile(job);
+
+        for (auto [path, width, height] :
+             {std::tuple<std::string, uint32_t, uint32_t>{"sizes.png", 120, 80},
+              {"sizes-60x40.png", 60, 40},
+              {"sizes-50x33.png", 50, 33}}) {
+            std::ifstream in(path, std::ios::binary);
+            std::vector<uint8_t> png((std::istreambuf_iterator<char>(in)), {});
+
+            ASSERT_GT(png.size(), 24u) << path;
+            // IHDR width and height, big endian
+            EXPECT_EQ(png[18] << 8 | png[19], width) << path;
+            EXPECT_EQ(png[22] << 8 | png[23], height) << path;
+            std::remove(path.c_str());
+        }
+    }
+
+    EXPECT_EQ(PNGEncoder::SizedOutputPath("out.d/a", 2, 1), "out.d/a-2x1");
+    EXPECT_THROW(PNGEncoder::ParseJob({input, "o.png", "1", "1", "--sizes=1/2", "--stream"}),
+                 std::runtime_error);
+    std::remove(input.c_str());
+}
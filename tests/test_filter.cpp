@@ -1,6 +1,7 @@
 // test_filter.cpp
 #include <gtest/gtest.h>
 #include "filter.h"
+#include "test_util.h"
 #include <cstdint>
 #include <vector>
 
@@ -98,4 +99,150 @@ TEST(FilterTest, ApplyPaethFilterWrapAround) {
     EXPECT_EQ(filtered[0], static_cast<uint8_t>(PNGFilterType::Paeth));
 
     EXPECT_EQ(filtered[1], 5u);
-}
\ No newline at end of file
+}
+
+namespace {
+
+// Reverses PNG filtering of a 3-bytes-per-pixel image, as a decoder would
+std::vector<uint8_t> Unfilter(const std::vector<uint8_t>& filtered, uint64_t width,
+                              uint64_t height) {
+    const size_t row_bytes = width * 3;
+    std::vector<uint8_t> out(row_bytes * height);
+
+    for (uint64_t y = 0; y < height; ++y) {
+        const uint8_t* line = filtered.data() + y * (row_bytes + 1);
+        uint8_t* row = out.data() + y * row_bytes;
+        const uint8_t* prev = y > 0 ? row - row_bytes : nullptr;
+
+        for (size_t i = 0; i < row_bytes; ++i) {
+            int a = i >= 3 ? row[i - 3] : 0;
+            int b = prev ? prev[i] : 0;
+            int c = (i >= 3 && prev) ? prev[i - 3] : 0;
+            int pred = 0;
+
+            switch (line[0]) {
+                case 1:
+                    pred = a;
+                    break;
+                case 2:
+                    pred = b;
+                    break;
+                case 3:
+                    pred = (a + b) / 2;
+                    break;
+                case 4: {
+                    int p = a + b - c;
+                    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+                    pred = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+                    break;
+                }
+                default:
+                    break;
+            }
+
+            row[i] = static_cast<uint8_t>(line[1 + i] + pred);
+        }
+    }
+
+    return out;
+}
+
+}  // namespace
+
+// Every strategy must produce scanlines that decode back to the original pixels
+TEST(FilterTest, AllStrategiesRoundTrip) {
+    uint64_t width = 17;
+    uint64_t height = 9;
+    auto data = MakeNoisyGradient(width, height);
+
+    for (auto strategy : {PNGFilterStrategy::None, PNGFilterStrategy::Sub, PNGFilterStrategy::Up,
+                          PNGFilterStrategy::Average, PNGFilterStrategy::Paeth,
+                          PNGFilterStrategy::MinSum, PNGFilterStrategy::Entropy}) {
+        auto filtered = PNGFilter::Apply(data, width, height, strategy);
+
+        ASSERT_EQ(filtered.size(), static_cast<size_t>((width * 3 + 1) * height));
+        EXPECT_EQ(Unfilter(filtered, width, height), data)
+            << "strategy " << static_cast<int>(strategy);
+    }
+}
+
+// The fused color + PNG filter pass matches a color filtered copy filtered afterwards
+TEST(FilterTest, FusedColorFilterMatchesTwoPasses) {
+    uint64_t width = 33;
+    uint64_t height = 12;
+    auto data = MakeNoisyGradient(width, height);
+
+    for (auto color_filter : {ColorFilterType::None, ColorFilterType::Negative,
+                              ColorFilterType::Grayscale, ColorFilterType::PerlinNoise}) {
+        auto colored = ColorFilter::Apply(data, width, height, color_filter, 60.0f);
+
+        for (auto strategy : {PNGFilterStrategy::Paeth, PNGFilterStrategy::MinSum}) {
+            EXPECT_EQ(PNGFilter::Apply(data, width, height, strategy, color_filter, 60.0f),
+                      PNGFilter::Apply(colored, width, height, strategy))
+                << "color filter " << static_cast<int>(color_filter) << ", strategy "
+                << static_cast<int>(strategy);
+        }
+    }
+}
+
+// Row bands filtered on a pool give byte-identical scanlines for every combination of
+// color filter, packed format and strategy, including bands that split mid-image
+TEST(FilterTest, ParallelBandsMatchSerial) {
+    uint64_t width = 29;
+    uint64_t height = 203;
+    auto data = MakeNoisyGradient(width, height);
+    ThreadPool pool(4);
+
+    PixelFormat gray;
+    gray.color_type = PNGColorType::Grayscale;
+
+    for (auto color_filter : {ColorFilterType::None, ColorFilterType::Grayscale,
+                              ColorFilterType::PerlinNoise}) {
+        for (const PixelFormat& format : {PixelFormat{}, gray}) {
+            if (!format.IsRGB8() && color_filter != ColorFilterType::Grayscale) {
+                continue;
+            }
+
+            for (auto strategy : {PNGFilterStrategy::Paeth, PNGFilterStrategy::MinSum,
+                                  PNGFilterStrategy::Entropy}) {
+                auto serial = PNGFilter::Apply(data, width, height, strategy, color_filter,
+                                               40.0f, format);
+                auto parallel = PNGFilter::Apply(data, width, height, strategy, color_filter,
+                                                 40.0f, format, &pool);
+                EXPECT_EQ(parallel, serial) << "color filter " << static_cast<int>(color_filter)
+                                            << ", strategy " << static_cast<int>(strategy);
+            }
+        }
+    }
+}
+
+// Rows that repeat the previous one are best encoded with Up,
+// a horizontal ramp on the first row is best encoded with Sub
+TEST(FilterTest, MinSumPicksCheapestFilter) {
+    uint64_t width = 8;
+    uint64_t height = 3;
+    std::vector<uint8_t> data(width * height * 3);
+
+    for (uint64_t y = 0; y < height; ++y) {
+        for (uint64_t x = 0; x < width * 3; ++x) {
+            data[y * width * 3 + x] = static_cast<uint8_t>(x * 11 % 256 ^ 0x5A);
+        }
+    }
+
+    for (size_t i = 0; i < width * 3; ++i) {
+        data[i] = static_cast<uint8_t>(40 + (i / 3) * 2);
+    }
+
+    auto filtered = PNGFilter::Apply(data, width, height, PNGFilterStrategy::MinSum);
+
+    EXPECT_EQ(filtered[0], static_cast<uint8_t>(PNGFilterType::Sub));
+    EXPECT_EQ(filtered[2 * (width * 3 + 1)], static_cast<uint8_t>(PNGFilterType::Up));
+}
+
+// Strategy names are case-insensitive, unknown ones throw
+TEST(FilterTest, ParseStrategy) {
+    EXPECT_EQ(PNGFilter::Parse("MinSum"), PNGFilterStrategy::MinSum);
+    EXPECT_EQ(PNGFilter::Parse("entropy"), PNGFilterStrategy::Entropy);
+    EXPECT_EQ(PNGFilter::Parse("paeth"), PNGFilterStrategy::Paeth);
+    EXPECT_THROW(PNGFilter::Parse("bogus"), std::runtime_error);
+}
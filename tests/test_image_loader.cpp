@@ -89,4 +89,77 @@ TEST(ImageLoaderTest, IgnoresExtraBytes) {
     EXPECT_EQ(img.data.size(), 3u);
     EXPECT_EQ(img.data[0], 42u);
     std::remove(file_name);
-}
\ No newline at end of file
+}
+
+// RawImageReader hands out rows in order and stops after the last row
+TEST(ImageLoaderTest, ReaderReadsRowsInBatches) {
+    const char* file_name = "rows.raw";
+    std::vector<uint8_t> bytes(2 * 5 * 3);
+    for (size_t i = 0; i < bytes.size(); ++i) {
+        bytes[i] = static_cast<uint8_t>(i);
+    }
+
+    {
+        std::ofstream f(file_name, std::ios::binary);
+        f.write(reinterpret_cast<char*>(bytes.data()), bytes.size());
+    }
+
+    RawImageReader reader(file_name, 2, 5);
+    std::vector<uint8_t> rows(2 * 3 * 2);
+
+    EXPECT_EQ(reader.ReadRows(rows.data(), 2), 2u);
+    EXPECT_EQ(rows[0], 0u);
+    EXPECT_EQ(reader.ReadRows(rows.data(), 2), 2u);
+    EXPECT_EQ(rows[0], 12u);
+    EXPECT_EQ(reader.ReadRows(rows.data(), 2), 1u);
+    EXPECT_EQ(rows[0], 24u);
+    EXPECT_EQ(reader.ReadRows(rows.data(), 2), 0u);
+    EXPECT_EQ(reader.RowsRead(), 5u);
+
+    std::remove(file_name);
+}
+
+// A mapped RAW file exposes exactly width*height*3 bytes of the file;
+// missing and short files are rejected like in LoadRawImage
+TEST(ImageLoaderTest, MapsRawFile) {
+    const char* file_name = "mapped.raw";
+    {
+        std::ofstream f(file_name, std::ios::binary);
+        std::vector<uint8_t> bytes(2 * 3 * 3 + 5);
+        for (size_t i = 0; i < bytes.size(); ++i) {
+            bytes[i] = static_cast<uint8_t>(i + 1);
+        }
+        f.write(reinterpret_cast<char*>(bytes.data()), bytes.size());
+    }
+
+    {
+        MappedRawImage image(file_name, 3, 2);
+        PixelView view = image.View();
+
+        ASSERT_EQ(view.size(), 18u);
+        EXPECT_EQ(view[0], 1u);
+        EXPECT_EQ(view[17], 18u);
+        EXPECT_EQ(image.Width(), 3u);
+        EXPECT_EQ(image.Height(), 2u);
+    }
+
+    EXPECT_THROW(MappedRawImage(file_name, 4, 4), std::runtime_error);
+    EXPECT_THROW(MappedRawImage("definitely_missing.raw", 1, 1), std::runtime_error);
+
+    std::remove(file_name);
+}
+
+// In-memory input keeps the caller's pixels and stride, and rejects strides shorter
+// than a row
+TEST(ImageLoaderTest, WrapsPixelsInMemory) {
+    std::vector<uint8_t> pixels(2 * 10, 0);
+    pixels[10] = 42;
+
+    ImageView image = ImageLoader::FromMemory(pixels.data(), 3, 2, 10);
+    EXPECT_EQ(image.Row(0), pixels.data());
+    EXPECT_EQ(image.Row(1)[0], 42u);
+
+    EXPECT_EQ(ImageLoader::FromMemory(pixels.data(), 3, 2).stride, 9u);
+    EXPECT_THROW(ImageLoader::FromMemory(pixels.data(), 4, 2, 10), std::runtime_error);
+    EXPECT_THROW(ImageLoader::FromMemory(nullptr, 1, 1), std::runtime_error);
+}
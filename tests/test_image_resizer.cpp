@@ -0,0 +1,77 @@
+// test_image_resizer.cpp
+#include <gtest/gtest.h>
+#include "image_resizer.h"
+#include "test_util.h"
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+// Halving with the box filter averages each 2x2 block, rounded
+TEST(ImageResizerTest, BoxHalvesByAveraging) {
+    const std::vector<uint8_t> pixels = {
+        0,  10, 20,  2,  10, 20,  100, 0, 0,  100, 0, 0,
+        1,  10, 21,  1,  11, 21,  100, 0, 0,  101, 1, 255,
+    };
+
+    auto out = ImageResizer::Resize(ImageView(pixels, 4, 2), 2, 1, ResizeFilter::Box);
+
+    EXPECT_EQ(out, (std::vector<uint8_t>{1, 10, 21, 100, 0, 64}));
+}
+
+// A flat image stays flat and an unchanged size is a copy with both filters
+TEST(ImageResizerTest, KeepsFlatImagesAndIdentity) {
+    std::vector<uint8_t> flat(37 * 23 * 3, 77);
+    auto pixels = MakeImage(37, 23);
+
+    for (ResizeFilter filter : {ResizeFilter::Box, ResizeFilter::Bilinear}) {
+        EXPECT_EQ(ImageResizer::Resize(ImageView(flat, 37, 23), 11, 5, filter),
+                  std::vector<uint8_t>(11 * 5 * 3, 77));
+        EXPECT_EQ(ImageResizer::Resize(ImageView(pixels, 37, 23), 37, 23, filter), pixels);
+    }
+}
+
+// Every instruction set gives the same bytes, for widths that leave scalar tails and for
+// rows read through a stride
+TEST(ImageResizerTest, SIMDLevelsMatchScalar) {
+    const uint64_t width = 157;
+    const uint64_t height = 61;
+    const size_t stride = width * 3 + 9;
+    std::vector<uint8_t> pixels = MakeImage(stride / 3 + 3, height);
+    const ImageView image(pixels.data(), width, height, stride);
+
+    for (ResizeFilter filter : {ResizeFilter::Box, ResizeFilter::Bilinear}) {
+        for (auto [w, h] : {std::pair<uint64_t, uint64_t>{78, 30}, {39, 15}, {100, 47}, {200, 90}}) {
+            std::vector<uint8_t> expected;
+            ImageResizer::Resize(image, w, h, filter, expected, SIMDLevel::Scalar);
+
+            for (SIMDLevel level : {SIMDLevel::SSE41, SIMDLevel::AVX2}) {
+                if (!PNGFilterKernels::IsSupported(level)) {
+                    continue;
+                }
+
+                std::vector<uint8_t> out;
+                ImageResizer::Resize(image, w, h, filter, out, level);
+                EXPECT_EQ(out, expected) << w << "x" << h << " level " << static_cast<int>(level);
+            }
+        }
+    }
+}
+
+// Output sizes parse from 1/N and <W>w and keep the aspect ratio
+TEST(ImageResizerTest, ParsesOutputSizes) {
+    auto sizes = OutputSize::ParseList("1/2,1/4,320w");
+    ASSERT_EQ(sizes.size(), 3u);
+
+    uint64_t width = 0;
+    uint64_t height = 0;
+    sizes[1].Dimensions(1280, 720, width, height);
+    EXPECT_EQ(width, 320u);
+    EXPECT_EQ(height, 180u);
+    sizes[2].Dimensions(1000, 333, width, height);
+    EXPECT_EQ(width, 320u);
+    EXPECT_EQ(height, 107u);
+
+    EXPECT_THROW(OutputSize::Parse("half"), std::runtime_error);
+    EXPECT_THROW(OutputSize::Parse("1/0"), std::runtime_error);
+    EXPECT_THROW(ImageResizer::ParseFilter("lanczos"), std::runtime_error);
+}
@@ -0,0 +1,218 @@
+// test_incremental_encoder.cpp
+#include <gtest/gtest.h>
+#include "color_reduction.h"
+#include "incremental_encoder.h"
+#include "sequence_encoder.h"
+#include "test_util.h"
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+namespace {
+
+namespace fs = std::filesystem;
+
+void ScribbleRow(std::vector<uint8_t>& pixels, uint64_t width, uint64_t y, uint8_t seed) {
+    for (size_t i = 0; i < width * 3; ++i) {
+        pixels[y * width * 3 + i] = static_cast<uint8_t>(seed + i * 13);
+    }
+}
+
+// The PNG a full encode with the block layout of the incremental encoder writes
+std::vector<uint8_t> FullEncode(const ImageView& image, const EncodeOptions& options,
+                                size_t block_size) {
+    PixelFormat format;
+    if (options.reduce_colors) {
+        format = ColorReducer::Analyze(image, options.color_filter, options.perlin_strength);
+    }
+
+    PNGFilterStrategy png_filter = options.png_filter;
+    if (format.color_type == PNGColorType::Indexed &&
+        (png_filter == PNGFilterStrategy::MinSum || png_filter == PNGFilterStrategy::Entropy)) {
+        png_filter = PNGFilterStrategy::None;
+    }
+
+    PNGFilterBuffers buffers;
+    PNGFilter::Apply(image, png_filter, options.color_filter, options.perlin_strength, format,
+                     nullptr, buffers);
+    auto compressed = ParallelDeflateCompressor::Compress(
+        buffers.scanlines, format.RowBytes(image.width) + 1, ThreadPool::Shared(),
+        options.compression, block_size);
+
+    MemorySink sink;
+    PNGWriter(options.idat_size).WritePNG(sink, image.width, image.height, compressed, format);
+    return sink.TakeData();
+}
+
+}  // namespace
+
+// Frame after frame the incremental PNG equals a full encode: changed rows in the middle,
+// an unchanged frame, changes at the edges, then a new size; serially and on a pool
+TEST(IncrementalEncoderTest, MatchesFullEncode) {
+    const uint64_t width = 64;
+    const uint64_t height = 96;
+    ThreadPool pool(4);
+
+    for (int window_bits : {9, 15}) {
+        for (ThreadPool* frame_pool : {static_cast<ThreadPool*>(nullptr), &pool}) {
+            EncodeOptions options;
+            options.color_filter = ColorFilterType::Negative;
+            options.compression.window_bits = window_bits;
+            IncrementalEncoder encoder(options, 2048);
+
+            std::vector<std::vector<uint8_t>> frames(4, MakeNoisyGradient(width, height));
+            ScribbleRow(frames[1], width, 40, 1);
+            ScribbleRow(frames[1], width, 41, 2);
+            frames[2] = frames[1];
+            frames[3] = frames[2];
+            ScribbleRow(frames[3], width, 0, 3);
+            ScribbleRow(frames[3], width, height - 1, 4);
+
+            for (size_t i = 0; i < frames.size(); ++i) {
+                const ImageView image(frames[i], width, height);
+                MemorySink sink;
+                encoder.Encode(image, sink, frame_pool);
+                EXPECT_EQ(sink.TakeData(), FullEncode(image, options, 2048))
+                    << "window bits " << window_bits << " frame " << i;
+            }
+
+            auto narrow = MakeNoisyGradient(width / 2, height);
+            const ImageView image(narrow, width / 2, height);
+            MemorySink sink;
+            encoder.Encode(image, sink, frame_pool);
+            EXPECT_EQ(sink.TakeData(), FullEncode(image, options, 2048));
+            EXPECT_EQ(encoder.LastStats().blocks_compressed, encoder.LastStats().blocks);
+        }
+    }
+}
+
+// An unchanged frame costs no filtering or compression, one changed row refilters itself
+// and the row below and recompresses only the blocks that see it
+TEST(IncrementalEncoderTest, RedoesOnlyChangedWork) {
+    const uint64_t width = 64;
+    const uint64_t height = 96;
+    EncodeOptions options;
+    options.compression.window_bits = 9;
+    IncrementalEncoder encoder(options, 2048);
+
+    auto pixels = MakeNoisyGradient(width, height);
+    MemorySink sink;
+    encoder.Encode(ImageView(pixels, width, height), sink);
+    const IncrementalStats first = encoder.LastStats();
+    EXPECT_EQ(first.rows_filtered, height);
+    EXPECT_GT(first.blocks, 3u);
+    EXPECT_EQ(first.blocks_compressed, first.blocks);
+
+    encoder.Encode(ImageView(pixels, width, height), sink);
+    EXPECT_EQ(encoder.LastStats().rows_changed, 0u);
+    EXPECT_EQ(encoder.LastStats().rows_filtered, 0u);
+    EXPECT_EQ(encoder.LastStats().blocks_compressed, 0u);
+
+    ScribbleRow(pixels, width, 50, 9);
+    encoder.Encode(ImageView(pixels, width, height), sink);
+    EXPECT_EQ(encoder.LastStats().rows_changed, 1u);
+    EXPECT_EQ(encoder.LastStats().rows_filtered, 2u);
+    EXPECT_GE(encoder.LastStats().blocks_compressed, 1u);
+    EXPECT_LE(encoder.LastStats().blocks_compressed, 3u);
+
+    encoder.Reset();
+    encoder.Encode(ImageView(pixels, width, height), sink);
+    EXPECT_EQ(encoder.LastStats().blocks_compressed, encoder.LastStats().blocks);
+
+    options.compression.backend = DeflateBackendType::Archival;
+    EXPECT_THROW(IncrementalEncoder{options}, std::runtime_error);
+}
+
+// A palette frame keeps its format while changed rows reuse its colors, even once a color
+// is gone; a new color analyzes the frame again and encodes it in full
+TEST(IncrementalEncoderTest, KeepsFormatWhileColorsFit) {
+    const uint64_t width = 48;
+    const uint64_t height = 40;
+    const uint8_t colors[][3] = {{255, 0, 0}, {0, 255, 0}, {0, 0, 255}, {255, 255, 255}};
+    EncodeOptions options;
+    options.compression.window_bits = 9;
+    IncrementalEncoder encoder(options, 1024);
+
+    std::vector<uint8_t> pixels(width * height * 3);
+    for (size_t i = 0; i < width * height; ++i) {
+        std::copy(colors[i % 7 % 4], colors[i % 7 % 4] + 3, &pixels[i * 3]);
+    }
+
+    auto paint_row = [&](uint64_t y, const uint8_t* color) {
+        for (uint64_t x = 0; x < width; ++x) {
+            std::copy(color, color + 3, &pixels[(y * width + x) * 3]);
+        }
+    };
+
+    MemorySink sink;
+    encoder.Encode(ImageView(pixels, width, height), sink);
+    EXPECT_EQ(sink.TakeData(), FullEncode(ImageView(pixels, width, height), options, 1024));
+
+    paint_row(10, colors[0]);
+    encoder.Encode(ImageView(pixels, width, height), sink);
+    EXPECT_EQ(encoder.LastStats().rows_filtered, 2u);
+    EXPECT_EQ(sink.TakeData(), FullEncode(ImageView(pixels, width, height), options, 1024));
+
+    // Only red left: a full analysis would pick 1 bit, the kept palette stays at 2 and
+    // row 10, already red, is not redone
+    for (uint64_t y = 0; y < height; ++y) {
+        paint_row(y, colors[0]);
+    }
+    encoder.Encode(ImageView(pixels, width, height), sink);
+    EXPECT_EQ(encoder.LastStats().rows_changed, height - 1);
+    const auto kept = sink.TakeData();
+    EXPECT_EQ(kept[24], 2);
+    EXPECT_EQ(kept[25], 3);
+
+    const uint8_t yellow[] = {255, 255, 0};
+    paint_row(5, yellow);
+    encoder.Encode(ImageView(pixels, width, height), sink);
+    EXPECT_EQ(encoder.LastStats().rows_filtered, height);
+    EXPECT_EQ(sink.TakeData(), FullEncode(ImageView(pixels, width, height), options, 1024));
+}
+
+// --incremental sequences write every frame as a full encode would and sum the work
+TEST(IncrementalEncoderTest, SequenceWritesFullFrames) {
+    const uint64_t width = 40;
+    const uint64_t height = 30;
+    const fs::path dir = fs::temp_directory_path() / "png_encoder_incremental_test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    std::vector<std::vector<uint8_t>> frames(3, MakeNoisyGradient(width, height));
+    ScribbleRow(frames[2], width, 7, 5);
+    {
+        std::ofstream out(dir / "frames.raw", std::ios::binary);
+        for (const auto& frame : frames) {
+            out.write(reinterpret_cast<const char*>(frame.data()), frame.size());
+        }
+    }
+
+    EncodeJob job;
+    job.input_path = (dir / "frames.raw").string();
+    job.output_path = (dir / "frame-%d.png").string();
+    job.width = width;
+    job.height = height;
+    job.options.threads = 3;
+
+    SequenceOptions options;
+    options.incremental = true;
+    SequenceReport report = SequenceEncoder::EncodeFile(job, options);
+
+    EXPECT_EQ(report.frames, frames.size());
+    EXPECT_EQ(report.incremental.frames, frames.size());
+    EXPECT_EQ(report.incremental.rows_changed, height + 1);
+
+    for (size_t i = 0; i < frames.size(); ++i) {
+        std::ifstream in(SequenceEncoder::FramePath(job.output_path, i), std::ios::binary);
+        std::vector<uint8_t> written((std::istreambuf_iterator<char>(in)), {});
+        EXPECT_EQ(written, FullEncode(ImageView(frames[i], width, height), job.options,
+                                      ParallelDeflateCompressor::kDefaultBlockSize))
+            << "frame " << i;
+    }
+
+    fs::remove_all(dir);
+}
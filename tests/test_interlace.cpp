@@ -0,0 +1,137 @@
+// test_interlace.cpp
+#include <gtest/gtest.h>
+#include "color_reduction.h"
+#include "encoder.h"
+#include "interlace.h"
+#include "test_util.h"
+#include <zlib.h>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+// Scanlines of the seven passes built the slow way: each pass cut out as an image of
+// its own and filtered without interlacing
+std::vector<uint8_t> FilterPassImages(const std::vector<uint8_t>& colored, uint64_t width,
+                                      uint64_t height, PNGFilterStrategy strategy,
+                                      PixelFormat format) {
+    format.interlace = PNGInterlace::None;
+    std::vector<uint8_t> scanlines;
+
+    for (size_t pass = 0; pass < Adam7::kPassCount; ++pass) {
+        const Adam7::Pass& p = Adam7::kPasses[pass];
+        const uint64_t pass_width = Adam7::PassWidth(pass, width);
+        const uint64_t pass_height = Adam7::PassHeight(pass, height);
+        if (pass_width == 0 || pass_height == 0) {
+            continue;
+        }
+
+        std::vector<uint8_t> pass_pixels;
+        for (uint64_t y = p.y0; y < height; y += p.dy) {
+            for (uint64_t x = p.x0; x < width; x += p.dx) {
+                const uint8_t* pixel = colored.data() + (y * width + x) * 3;
+                pass_pixels.insert(pass_pixels.end(), pixel, pixel + 3);
+            }
+        }
+
+        auto filtered = PNGFilter::Apply(pass_pixels, pass_width, pass_height, strategy,
+                                         ColorFilterType::None, -1.0f, format);
+        scanlines.insert(scanlines.end(), filtered.begin(), filtered.end());
+    }
+
+    return scanlines;
+}
+
+}  // namespace
+
+// Pass sizes cover every pixel once, small images leave passes empty
+TEST(InterlaceTest, PassGeometry) {
+    for (uint64_t width : {1, 2, 5, 8, 13, 64}) {
+        for (uint64_t height : {1, 3, 8, 9}) {
+            uint64_t pixels = 0;
+            for (size_t pass = 0; pass < Adam7::kPassCount; ++pass) {
+                pixels += Adam7::PassWidth(pass, width) * Adam7::PassHeight(pass, height);
+            }
+            EXPECT_EQ(pixels, width * height) << width << "x" << height;
+        }
+    }
+
+    EXPECT_EQ(Adam7::PassWidth(1, 4), 0u);
+    EXPECT_EQ(Adam7::PassWidth(1, 5), 1u);
+    EXPECT_EQ(Adam7::PassHeight(6, 1), 0u);
+
+    // 1x1: only the first pass, one filter byte and one pixel
+    const auto offsets = Adam7::PassOffsets(1, 1, PixelFormat{});
+    EXPECT_EQ(offsets[1], 4u);
+    EXPECT_EQ(offsets[Adam7::kPassCount], 4u);
+
+    // 3x2 in 1-bit gray: passes 1, 4, 6 and 7 with one byte per pass row
+    PixelFormat gray;
+    gray.color_type = PNGColorType::Grayscale;
+    gray.bit_depth = 1;
+    EXPECT_EQ(Adam7::PassOffsets(3, 2, gray)[Adam7::kPassCount], 2u * 4);
+}
+
+// Interlaced filtering equals filtering the pass images one by one, with color filters
+// applied at full image coordinates, packed formats, and serially or on a pool
+TEST(InterlaceTest, FilterMatchesPassImages) {
+    ThreadPool pool(4);
+
+    for (uint32_t levels : {3u, 200u}) {
+        for (ColorFilterType color_filter :
+             {ColorFilterType::None, ColorFilterType::Grayscale, ColorFilterType::PerlinNoise}) {
+            const uint64_t width = 77;
+            const uint64_t height = 141;
+            const auto pixels = MakeLevelsImage(width, height, levels);
+            const ImageView image(pixels, width, height);
+            const float scale = color_filter == ColorFilterType::PerlinNoise ? 0.3f : -1.0f;
+
+            PixelFormat format = ColorReducer::Analyze(image, color_filter, scale);
+            if (color_filter == ColorFilterType::None) {
+                EXPECT_EQ(format.IsRGB8(), levels == 200u);
+            }
+            format.interlace = PNGInterlace::Adam7;
+
+            const auto colored = ColorFilter::Apply(pixels, width, height, color_filter, scale);
+            const auto expected =
+                FilterPassImages(colored, width, height, PNGFilterStrategy::MinSum, format);
+
+            for (ThreadPool* filter_pool : {static_cast<ThreadPool*>(nullptr), &pool}) {
+                PNGFilterBuffers buffers;
+                PNGFilter::Apply(image, PNGFilterStrategy::MinSum, color_filter, scale, format,
+                                 filter_pool, buffers);
+                EXPECT_EQ(buffers.scanlines, expected)
+                    << levels << " levels, color filter " << static_cast<int>(color_filter);
+            }
+        }
+    }
+}
+
+// --interlace sets the IHDR interlace method and the zlib stream holds every pass;
+// streaming cannot interlace
+TEST(InterlaceTest, EncoderWritesAdam7) {
+    const uint64_t width = 40;
+    const uint64_t height = 30;
+    const auto pixels = MakeLevelsImage(width, height, 200);
+
+    std::vector<std::string> positional;
+    EncodeOptions options = PNGEncoder::ParseOptions({"--interlace", "--threads=3"},
+                                                     positional);
+    EXPECT_EQ(options.interlace, PNGInterlace::Adam7);
+
+    const auto png = PNGEncoder::EncodeToMemory(ImageView(pixels, width, height), options);
+    ASSERT_GT(png.size(), 41u);
+    EXPECT_EQ(png[28], 1);
+
+    // Single IDAT right after IHDR
+    const size_t idat_size = (png[33] << 24) | (png[34] << 16) | (png[35] << 8) | png[36];
+    std::vector<uint8_t> scanlines(Adam7::PassOffsets(width, height, PixelFormat{})[7] + 1);
+    uLongf size = scanlines.size();
+    ASSERT_EQ(uncompress(scanlines.data(), &size, png.data() + 41, idat_size), Z_OK);
+    EXPECT_EQ(size, scanlines.size() - 1);
+
+    EXPECT_THROW(PNGEncoder::ParseOptions({"--stream", "--interlace=adam7"}, positional),
+                 std::runtime_error);
+    EXPECT_THROW(PNGEncoder::ParseOptions({"--interlace=line"}, positional),
+                 std::runtime_error);
+}
@@ -0,0 +1,116 @@
+// test_png_stream_encoder.cpp
+#include <gtest/gtest.h>
+#include "png_stream_encoder.h"
+#include "color_filter.h"
+#include "filter.h"
+#include "test_util.h"
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct ParsedPNG {
+    std::vector<std::string> chunk_types;
+    std::vector<size_t> idat_sizes;
+    std::vector<uint8_t> idat;
+};
+
+ParsedPNG ParsePNG(const std::string& file_name) {
+    std::ifstream in(file_name, std::ios::binary);
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)),
+                               std::istreambuf_iterator<char>());
+
+    ParsedPNG png;
+    size_t pos = 8;
+
+    while (pos + 12 <= bytes.size()) {
+        uint32_t length = ReadBE32(bytes.data() + pos);
+        std::string type(reinterpret_cast<const char*>(bytes.data() + pos + 4), 4);
+        png.chunk_types.push_back(type);
+
+        if (type == "IDAT") {
+            png.idat_sizes.push_back(length);
+            png.idat.insert(png.idat.end(), bytes.begin() + pos + 8,
+                            bytes.begin() + pos + 8 + length);
+        }
+
+        pos += 12 + length;
+    }
+
+    return png;
+}
+
+}  // namespace
+
+// Row-by-row encoding produces the same scanlines as the whole-image path,
+// whatever the batch size passed to WriteRows
+TEST(PNGStreamEncoderTest, MatchesWholeImagePipeline) {
+    const uint64_t width = 37;
+    const uint64_t height = 23;
+    const std::string file_name = "stream.png";
+    auto image = MakeImage(width, height);
+
+    auto colored = ColorFilter::Apply(image, width, height, ColorFilterType::PerlinNoise, 60.0f);
+    auto expected = PNGFilter::Apply(colored, width, height, PNGFilterStrategy::MinSum);
+
+    for (uint64_t batch : {1u, 5u, 23u}) {
+        PNGStreamEncoder encoder(PNGFilterStrategy::MinSum);
+        encoder.BeginImage(file_name, width, height, ColorFilterType::PerlinNoise, 60.0f);
+
+        for (uint64_t y = 0; y < height; y += batch) {
+            encoder.WriteRows(image.data() + y * width * 3, std::min(batch, height - y));
+        }
+        encoder.Finish();
+
+        ParsedPNG png = ParsePNG(file_name);
+        EXPECT_EQ(png.chunk_types.front(), "IHDR");
+        EXPECT_EQ(png.chunk_types.back(), "IEND");
+        EXPECT_EQ(Inflate(png.idat, expected.size()), expected) << "batch " << batch;
+    }
+
+    std::remove(file_name.c_str());
+}
+
+// IDAT chunks are emitted as soon as the output buffer fills
+TEST(PNGStreamEncoderTest, SplitsIDATChunks) {
+    const uint64_t width = 64;
+    const uint64_t height = 64;
+    const std::string file_name = "stream_chunks.png";
+    auto image = MakeImage(width, height);
+
+    PNGStreamEncoder encoder(PNGFilterStrategy::None, {}, 256);
+    encoder.BeginImage(file_name, width, height);
+    encoder.WriteRows(image.data(), height);
+    encoder.Finish();
+
+    ParsedPNG png = ParsePNG(file_name);
+    ASSERT_GT(png.idat_sizes.size(), 1u);
+
+    for (size_t i = 0; i + 1 < png.idat_sizes.size(); ++i) {
+        EXPECT_EQ(png.idat_sizes[i], 256u);
+    }
+
+    std::remove(file_name.c_str());
+}
+
+// Writing too many rows or finishing early is an error
+TEST(PNGStreamEncoderTest, RejectsWrongRowCount) {
+    const std::string file_name = "stream_bad.png";
+    std::vector<uint8_t> row(3 * 4, 0);
+
+    PNGStreamEncoder encoder;
+    encoder.BeginImage(file_name, 4, 2);
+    encoder.WriteRows(row.data(), 1);
+
+    EXPECT_THROW(encoder.Finish(), std::runtime_error);
+
+    encoder.BeginImage(file_name, 4, 1);
+    encoder.WriteRows(row.data(), 1);
+    EXPECT_THROW(encoder.WriteRows(row.data(), 1), std::runtime_error);
+
+    std::remove(file_name.c_str());
+}
@@ -3,8 +3,12 @@
 #include "png_writer.h"
 #include "filter.h"
 #include "deflate.h"
+#include "test_util.h"
 #include <fstream>
 #include <cstdio>
+#include <iterator>
+
+#include <unistd.h>
 
 namespace {
 
@@ -15,11 +19,6 @@ bool ReadBytes(std::ifstream& in, std::vector<uint8_t>& buffer, size_t n) {
     return static_cast<size_t>(in.gcount()) == n;
 }
 
-// Read big-endian 32-bit integer from 4 bytes
-uint32_t ReadBE32(const uint8_t* p) {
-    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
-}
-
 }  // namespace
 
 // Write a minimal 1×1 truecolor PNG and verify its structure:
@@ -84,4 +83,84 @@ TEST(PNGWriterTest, ThrowsOnBadPath) {
     PNGWriter writer;
     EXPECT_THROW(writer.WritePNG("/non/existent/dir/out.png", width, height, {}),
                  std::runtime_error);
-}
\ No newline at end of file
+}
+
+// A small IDAT limit splits the compressed stream into consecutive chunks of at most
+// that size whose payloads concatenate back to the original stream
+TEST(PNGWriterTest, SplitsIDATIntoChunks) {
+    std::vector<uint8_t> compressed(10000);
+    for (size_t i = 0; i < compressed.size(); ++i) {
+        compressed[i] = static_cast<uint8_t>(i * 31 + 7);
+    }
+
+    PNGWriter writer(4096);
+    MemorySink sink;
+    writer.WritePNG(sink, 4, 4, compressed);
+
+    const std::vector<uint8_t>& png = sink.Data();
+    std::vector<uint8_t> joined;
+    std::vector<uint32_t> lengths;
+
+    size_t pos = 8;
+    while (pos + 12 <= png.size()) {
+        uint32_t length = ReadBE32(png.data() + pos);
+        std::string type(reinterpret_cast<const char*>(png.data() + pos + 4), 4);
+
+        if (type == "IDAT") {
+            lengths.push_back(length);
+            joined.insert(joined.end(), png.begin() + pos + 8, png.begin() + pos + 8 + length);
+        }
+        pos += 12 + length;
+    }
+
+    EXPECT_EQ(pos, png.size());
+    EXPECT_EQ(lengths, (std::vector<uint32_t>{4096, 4096, 1808}));
+    EXPECT_EQ(joined, compressed);
+}
+
+// The file, in-memory and descriptor sinks all produce the same bytes
+TEST(PNGWriterTest, SinksProduceIdenticalOutput) {
+    std::vector<uint8_t> raw(16 * 8 * 3);
+    for (size_t i = 0; i < raw.size(); ++i) {
+        raw[i] = static_cast<uint8_t>(i * 13);
+    }
+    auto compressed = DeflateCompressor::Compress(PNGFilter::Apply(raw, 16, 8));
+
+    PNGWriter writer(64);
+    MemorySink memory;
+    writer.WritePNG(memory, 16, 8, compressed);
+
+    const std::string file_name = "sinks.png";
+    writer.WritePNG(file_name, 16, 8, compressed);
+    std::ifstream in(file_name, std::ios::binary);
+    std::vector<uint8_t> from_file((std::istreambuf_iterator<char>(in)),
+                                   std::istreambuf_iterator<char>());
+    in.close();
+    std::remove(file_name.c_str());
+
+    // Small enough to fit in the pipe buffer, so one thread can write and read
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    FileDescriptorSink pipe_sink(fds[1]);
+    writer.WritePNG(pipe_sink, 16, 8, compressed);
+    close(fds[1]);
+
+    std::vector<uint8_t> from_pipe(memory.Data().size() + 1);
+    size_t received = 0;
+    ssize_t n;
+    while ((n = read(fds[0], from_pipe.data() + received, from_pipe.size() - received)) > 0) {
+        received += n;
+    }
+    close(fds[0]);
+    from_pipe.resize(received);
+
+    EXPECT_EQ(from_file, memory.Data());
+    EXPECT_EQ(from_pipe, memory.Data());
+}
+
+// Chunk sizes outside [1, 2^31 - 1] are rejected up front
+TEST(PNGWriterTest, RejectsInvalidIDATSize) {
+    EXPECT_THROW(PNGWriter(0), std::runtime_error);
+    EXPECT_THROW(PNGWriter(PNGWriter::kMaxChunkSize + 1), std::runtime_error);
+    EXPECT_NO_THROW(PNGWriter(PNGWriter::kMaxChunkSize));
+}
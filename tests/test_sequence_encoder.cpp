@@ -0,0 +1,176 @@
+// test_sequence_encoder.cpp
+#include <gtest/gtest.h>
+#include "bounded_queue.h"
+#include "sequence_encoder.h"
+#include "test_util.h"
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+namespace fs = std::filesystem;
+
+// Frame i is gray for even i and colored for odd i, so frames take different PNG formats
+std::vector<uint8_t> MakeFrame(uint64_t width, uint64_t height, uint64_t index) {
+    std::vector<uint8_t> data(width * height * 3);
+    for (size_t p = 0; p < width * height; ++p) {
+        const uint8_t value = static_cast<uint8_t>(p * 7 + index * 31);
+        data[p * 3] = value;
+        data[p * 3 + 1] = index % 2 == 0 ? value : static_cast<uint8_t>(p >> 3);
+        data[p * 3 + 2] = index % 2 == 0 ? value : static_cast<uint8_t>(index);
+    }
+    return data;
+}
+
+}  // namespace
+
+// Every item pushed by several producers reaches exactly one of several consumers
+// through a queue much smaller than the item count
+TEST(SequenceEncoderTest, BoundedQueueDeliversEveryItemOnce) {
+    constexpr size_t kProducers = 3;
+    constexpr size_t kConsumers = 3;
+    constexpr uint32_t kItems = 20000;
+
+    BoundedQueue<uint32_t> queue(8);
+    std::vector<std::vector<uint32_t>> received(kConsumers);
+    std::vector<std::thread> threads;
+
+    for (size_t c = 0; c < kConsumers; ++c) {
+        threads.emplace_back([&, c]() {
+            uint32_t item = 0;
+            while (queue.Pop(item)) {
+                received[c].push_back(item);
+            }
+        });
+    }
+
+    std::vector<std::thread> producers;
+    for (size_t p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&, p]() {
+            for (uint32_t i = static_cast<uint32_t>(p); i < kItems; i += kProducers) {
+                EXPECT_TRUE(queue.Push(i));
+            }
+        });
+    }
+    for (std::thread& producer : producers) {
+        producer.join();
+    }
+    queue.Close();
+    for (std::thread& consumer : threads) {
+        consumer.join();
+    }
+
+    std::vector<int> seen(kItems, 0);
+    for (const auto& items : received) {
+        for (uint32_t item : items) {
+            ++seen[item];
+        }
+    }
+    EXPECT_EQ(std::count(seen.begin(), seen.end(), 1), static_cast<long>(kItems));
+
+    QueueStats stats = queue.Stats();
+    EXPECT_EQ(stats.pushes, kItems);
+    EXPECT_LE(stats.max_depth, queue.Capacity());
+}
+
+// The pipeline writes every frame of every pass with the same bytes as encoding the
+// frame on its own, and reports the frames through every stage
+TEST(SequenceEncoderTest, PipelineMatchesSingleFrameEncoding) {
+    const uint64_t width = 37;
+    const uint64_t height = 29;
+    const uint64_t frame_count = 5;
+    const fs::path dir = fs::temp_directory_path() / "png_encoder_sequence_test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    std::vector<std::vector<uint8_t>> frames;
+    {
+        std::ofstream out(dir / "frames.raw", std::ios::binary);
+        for (uint64_t i = 0; i < frame_count; ++i) {
+            frames.push_back(MakeFrame(width, height, i));
+            out.write(reinterpret_cast<const char*>(frames.back().data()), frames.back().size());
+        }
+    }
+
+    EncodeJob job;
+    job.input_path = (dir / "frames.raw").string();
+    job.output_path = (dir / "frame-%03d.png").string();
+    job.width = width;
+    job.height = height;
+    job.options.threads = 4;
+
+    SequenceOptions options;
+    options.queue_depth = 2;
+    options.repeat = 2;
+    SequenceReport report = SequenceEncoder::EncodeFile(job, options);
+
+    EXPECT_EQ(report.frames, frame_count * 2);
+    ASSERT_EQ(report.stages.size(), 4u);
+    for (const StageStats& stage : report.stages) {
+        EXPECT_EQ(stage.frames, frame_count * 2) << stage.name;
+    }
+
+    EncodeOptions single = job.options;
+    single.threads = 1;
+    for (uint64_t i = 0; i < frame_count * 2; ++i) {
+        const auto& pixels = frames[i % frame_count];
+        EXPECT_EQ(ReadFile(SequenceEncoder::FramePath(job.output_path, i)),
+                  PNGEncoder::EncodeToMemory(ImageView(pixels, width, height), single))
+            << "frame " << i;
+    }
+
+    fs::remove_all(dir);
+}
+
+// Frame numbers fill the pattern; patterns without one and truncated inputs are rejected
+TEST(SequenceEncoderTest, RejectsBadPatternAndInput) {
+    EXPECT_EQ(SequenceEncoder::FramePath("out/f-%05d.png", 42), "out/f-00042.png");
+    EXPECT_EQ(SequenceEncoder::FramePath("%d.png", 1234), "1234.png");
+    EXPECT_THROW(SequenceEncoder::FramePath("out.png", 1), std::runtime_error);
+    EXPECT_THROW(SequenceEncoder::FramePath("%s-%d.png", 1), std::runtime_error);
+
+    const fs::path raw = fs::temp_directory_path() / "png_encoder_sequence_short.raw";
+    {
+        std::ofstream out(raw, std::ios::binary);
+        out << std::string(4 * 4 * 3 + 5, 'x');
+    }
+
+    EncodeJob job;
+    job.input_path = raw.string();
+    job.output_path = (fs::temp_directory_path() / "short-%d.png").string();
+    job.width = 4;
+    job.height = 4;
+    EXPECT_THROW(SequenceEncoder::EncodeFile(job), std::runtime_error);
+
+    fs::remove(raw);
+}
+
+// Options a sequence would silently ignore are rejected before any frame is read
+TEST(SequenceEncoderTest, RejectsSingleImageOptions) {
+    EncodeJob job;
+    job.input_path = (fs::temp_directory_path() / "png_encoder_sequence_missing.raw").string();
+    job.output_path = (fs::temp_directory_path() / "rejected-%d.png").string();
+    job.width = 4;
+    job.height = 4;
+
+    EncodeJob sized = job;
+    sized.options.sizes = {OutputSize::Parse("1/2")};
+    EncodeJob searched = job;
+    searched.options.search = true;
+    EncodeJob streamed = job;
+    streamed.options.streaming = true;
+
+    for (const EncodeJob& rejected : {sized, searched, streamed}) {
+        try {
+            SequenceEncoder::EncodeFile(rejected);
+            ADD_FAILURE() << "expected a rejection";
+        } catch (const std::runtime_error& ex) {
+            EXPECT_NE(std::string(ex.what()).find("--sequence"), std::string::npos) << ex.what();
+        }
+    }
+}
@@ -0,0 +1,42 @@
+// test_thread_pool.cpp
+#include <gtest/gtest.h>
+#include "thread_pool.h"
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+// Submit returns the task's result through a future
+TEST(ThreadPoolTest, SubmitReturnsResult) {
+    ThreadPool pool(2);
+
+    auto answer = pool.Submit([]() { return 6 * 7; });
+
+    EXPECT_EQ(answer.get(), 42);
+}
+
+// Every index is visited exactly once, also when ParallelFor is nested in a worker
+TEST(ThreadPoolTest, ParallelForVisitsEveryIndexOnce) {
+    ThreadPool pool(3);
+    std::vector<std::atomic<int>> visits(1000);
+
+    pool.ParallelFor(10, [&](size_t outer) {
+        pool.ParallelFor(100, [&](size_t inner) { ++visits[outer * 100 + inner]; });
+    });
+
+    for (const auto& v : visits) {
+        EXPECT_EQ(v.load(), 1);
+    }
+}
+
+// Exceptions thrown by the body are propagated to the caller
+TEST(ThreadPoolTest, ParallelForRethrows) {
+    ThreadPool pool(2);
+
+    EXPECT_THROW(pool.ParallelFor(16,
+                                  [](size_t i) {
+                                      if (i == 5) {
+                                          throw std::runtime_error("boom");
+                                      }
+                                  }),
+                 std::runtime_error);
+}
@@ -0,0 +1,94 @@
+// test_util.h
+#pragma once
+
+#include <gtest/gtest.h>
+#include <zlib.h>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+// Helpers shared by the test files
+
+// RGB bytes of a fixed arithmetic pattern with few repeats
+inline std::vector<uint8_t> MakeImage(uint64_t width, uint64_t height) {
+    std::vector<uint8_t> data(width * height * 3);
+
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<uint8_t>((i * 7) ^ (i / 97));
+    }
+
+    return data;
+}
+
+// Gradient with a little pseudo-random noise on every sample
+inline std::vector<uint8_t> MakeNoisyGradient(uint64_t width, uint64_t height) {
+    std::vector<uint8_t> data(width * height * 3);
+    uint32_t state = 12345;
+
+    for (size_t i = 0; i < data.size(); ++i) {
+        state = state * 1103515245u + 12345u;
+        data[i] = static_cast<uint8_t>(i / 7 + ((state >> 16) & 0x0F));
+    }
+
+    return data;
+}
+
+// levels values per channel: 3 fit a palette, 200 need RGB
+inline std::vector<uint8_t> MakeLevelsImage(uint64_t width, uint64_t height, uint32_t levels) {
+    std::mt19937 gen(3);
+    std::vector<uint8_t> pixels(width * height * 3);
+    for (uint8_t& value : pixels) {
+        value = static_cast<uint8_t>(gen() % levels * 255 / (levels - 1));
+    }
+    return pixels;
+}
+
+// Writes a RAW file of a fixed pattern; seed shifts every sample
+inline void WriteRaw(const std::filesystem::path& path, uint64_t width, uint64_t height,
+                     uint8_t seed = 0) {
+    std::vector<uint8_t> data(width * height * 3);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<uint8_t>(i * 13 + seed);
+    }
+
+    std::ofstream f(path, std::ios::binary);
+    f.write(reinterpret_cast<const char*>(data.data()), data.size());
+}
+
+inline std::vector<uint8_t> ReadFile(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<uint8_t>((std::istreambuf_iterator<char>(in)), {});
+}
+
+// Read big-endian 32-bit integer from 4 bytes
+inline uint32_t ReadBE32(const uint8_t* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+// Decompresses a zlib stream expected to hold original_size bytes
+inline std::vector<uint8_t> Inflate(const std::vector<uint8_t>& compressed,
+                                    size_t original_size) {
+    std::vector<uint8_t> out(original_size + 1);
+    uLongf out_size = out.size();
+
+    EXPECT_EQ(::uncompress(out.data(), &out_size, compressed.data(), compressed.size()), Z_OK);
+
+    out.resize(out_size);
+    return out;
+}
+
+inline std::vector<uint8_t> RandomBytes(size_t size, uint32_t seed = 2024) {
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<int> dist(0, 255);
+    std::vector<uint8_t> bytes(size);
+
+    for (auto& b : bytes) {
+        b = static_cast<uint8_t>(dist(gen));
+    }
+
+    return bytes;
+}
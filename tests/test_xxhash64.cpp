@@ -0,0 +1,47 @@
+// test_xxhash64.cpp
+#include <gtest/gtest.h>
+#include "xxhash64.h"
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+uint64_t Hash(const std::string& text, uint64_t seed = 0) {
+    return XXHash64::Compute(reinterpret_cast<const uint8_t*>(text.data()), text.size(), seed);
+}
+
+}  // namespace
+
+// Published XXH64 values for short inputs, a multi-stripe input and a seed
+TEST(XXHash64Test, KnownValues) {
+    EXPECT_EQ(Hash(""), 0xEF46DB3751D8E999ull);
+    EXPECT_EQ(Hash("a"), 0xD24EC4F1A98C6E5Bull);
+    EXPECT_EQ(Hash("abc"), 0x44BC2CF5AD770999ull);
+    EXPECT_EQ(Hash("Nobody inspects the spammish repetition"), 0xFBCEA83C8A378BF1ull);
+    EXPECT_EQ(Hash("xxhash", 20141025), 0xB559B98D844E0635ull);
+}
+
+// Hashing in pieces of every size gives the value of hashing everything at once
+TEST(XXHash64Test, IncrementalUpdate) {
+    std::vector<uint8_t> data(1000);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<uint8_t>(i * 31 + i / 7);
+    }
+    const uint64_t expected = XXHash64::Compute(data.data(), data.size(), 7);
+
+    for (size_t piece : {1, 3, 8, 31, 32, 33, 100, 999}) {
+        XXHash64 hasher(7);
+        for (size_t offset = 0; offset < data.size(); offset += piece) {
+            hasher.Update(data.data() + offset, std::min(piece, data.size() - offset));
+        }
+        EXPECT_EQ(hasher.Digest(), expected) << "piece " << piece;
+    }
+
+    XXHash64 hasher(7);
+    hasher.Update(data.data(), 10);
+    hasher.Reset(7);
+    hasher.Update(data.data(), data.size());
+    EXPECT_EQ(hasher.Digest(), expected);
+}